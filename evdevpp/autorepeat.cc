@@ -0,0 +1,344 @@
+#include "evdevpp/autorepeat.h"
+
+#include <sys/timerfd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <utility>
+
+namespace evdevpp {
+
+absl::StatusOr<AutorepeatScheduler> AutorepeatScheduler::Create(
+    const Options& options) {
+  if (options.tick < absl::Microseconds(1)) {
+    return absl::InvalidArgumentError("Autorepeat tick is too short");
+  }
+  AutorepeatScheduler result;
+  result.options_ = options;
+  result.tick_ns_ = absl::ToInt64Nanoseconds(options.tick);
+  result.start_ns_ = MonotonicNanos();
+  result.heads_.fill(kNil);
+  result.timer_fd_ = toolbelt::FileDescriptor(
+      ::timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK));
+  if (!result.timer_fd_.IsOpen()) {
+    return absl::ErrnoToStatus(errno, "Creating autorepeat timer failed");
+  }
+  return result;
+}
+
+AutorepeatScheduler::DeviceId AutorepeatScheduler::AddDevice(
+    const EventIO* device, const KeyRepeatInfo& repeat) {
+  DeviceId id = 0;
+  if (!free_devices_.empty()) {
+    id = free_devices_.back();
+    free_devices_.pop_back();
+  } else {
+    id = static_cast<DeviceId>(devices_.size());
+    devices_.emplace_back();
+  }
+  devices_[id].io = device;
+  SetRepeat(id, repeat);
+  return id;
+}
+
+void AutorepeatScheduler::RemoveDevice(DeviceId device) {
+  std::vector<std::uint16_t> codes;
+  for (const auto& [key, index] : active_) {
+    if (timers_[index].device == device) {
+      codes.push_back(timers_[index].code);
+    }
+  }
+  for (std::uint16_t code : codes) {
+    Cancel(device, code);
+  }
+  devices_[device] = DeviceState{};
+  free_devices_.push_back(device);
+}
+
+void AutorepeatScheduler::SetRepeat(DeviceId device,
+                                    const KeyRepeatInfo& repeat) {
+  DeviceState& state = devices_[device];
+  state.repeat = repeat;
+  state.delay_ticks = 0;
+  state.period_ticks = 0;
+  if (repeat.repeat_key_per_s == 0 || repeat.delay <= absl::ZeroDuration()) {
+    return;
+  }
+  // Round up, so that repeats never come early.
+  state.delay_ticks = static_cast<std::uint64_t>(
+      (absl::ToInt64Nanoseconds(repeat.delay) + tick_ns_ - 1) / tick_ns_);
+  state.period_ticks = std::max<std::uint64_t>(
+      1, (1'000'000'000 / repeat.repeat_key_per_s + tick_ns_ - 1) / tick_ns_);
+}
+
+absl::Status AutorepeatScheduler::Press(DeviceId device, std::uint16_t code) {
+  DeviceState& state = devices_[device];
+  if (options_.last_key_only && state.repeating >= 0) {
+    Cancel(device, static_cast<std::uint16_t>(state.repeating));
+  } else {
+    Cancel(device, code);
+  }
+  if (state.period_ticks == 0) {
+    return absl::OkStatus();
+  }
+  std::uint32_t index = 0;
+  if (!free_timers_.empty()) {
+    index = free_timers_.back();
+    free_timers_.pop_back();
+  } else {
+    index = static_cast<std::uint32_t>(timers_.size());
+    timers_.emplace_back();
+  }
+  Timer& timer = timers_[index];
+  timer.expiry = TickAt(MonotonicNanos()) + state.delay_ticks;
+  timer.device = device;
+  timer.code = code;
+  Link(index);
+  active_[ActiveKey(device, code)] = index;
+  state.repeating = code;
+  return Rearm();
+}
+
+absl::Status AutorepeatScheduler::Release(DeviceId device,
+                                          std::uint16_t code) {
+  const DeviceState& state = devices_[device];
+  if (options_.last_key_only && state.repeating >= 0) {
+    // Like the kernel, releasing any key stops the repeat, even when it is
+    // not the repeating key.
+    Cancel(device, static_cast<std::uint16_t>(state.repeating));
+  } else {
+    Cancel(device, code);
+  }
+  // The timer is left armed, an early wake-up expires nothing.
+  return absl::OkStatus();
+}
+
+absl::Status AutorepeatScheduler::Observe(DeviceId device,
+                                          const input_event& event) {
+  if (event.type != EV_KEY) {
+    return absl::OkStatus();
+  }
+  if (event.value == 1) {
+    return Press(device, event.code);
+  }
+  if (event.value == 0) {
+    return Release(device, event.code);
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<std::size_t> AutorepeatScheduler::Dispatch() {
+  ClearTimerFd(timer_fd_.Fd());
+  const std::int64_t now = MonotonicNanos();
+  const std::size_t repeats = Advance(TickAt(now), now);
+  absl::Status flush_status = Flush();
+  if (auto st = Rearm(); !st.ok()) {
+    return st;
+  }
+  if (!flush_status.ok()) {
+    return flush_status;
+  }
+  return repeats;
+}
+
+std::uint64_t AutorepeatScheduler::TickAt(std::int64_t monotonic_ns) const {
+  return static_cast<std::uint64_t>(
+      std::max<std::int64_t>(0, monotonic_ns - start_ns_) / tick_ns_);
+}
+
+void AutorepeatScheduler::Cancel(DeviceId device, std::uint16_t code) {
+  auto it = active_.find(ActiveKey(device, code));
+  if (it == active_.end()) {
+    return;
+  }
+  Unlink(it->second);
+  free_timers_.push_back(it->second);
+  active_.erase(it);
+  if (devices_[device].repeating == code) {
+    devices_[device].repeating = -1;
+  }
+}
+
+void AutorepeatScheduler::Link(std::uint32_t index) {
+  Timer& timer = timers_[index];
+  // Past due timers expire on the next tick.
+  std::uint64_t when = std::max(timer.expiry, current_tick_ + 1);
+  const std::uint64_t delta = when - current_tick_;
+  int level = 0;
+  while (level < kLevels - 1 &&
+         delta >= (std::uint64_t{1} << (kSlotBits * (level + 1)))) {
+    ++level;
+  }
+  const std::uint64_t horizon = std::uint64_t{1} << (kSlotBits * kLevels);
+  if (delta >= horizon) {
+    // Beyond the wheel, park the timer in the last slot of the last level,
+    // it is placed again when that slot is cascaded.
+    when = current_tick_ + horizon - 1;
+  }
+  const std::size_t slot_in_level =
+      (when >> (kSlotBits * level)) & (kSlots - 1);
+  timer.slot = static_cast<std::uint16_t>(level * kSlots + slot_in_level);
+  timer.prev = kNil;
+  timer.next = heads_[timer.slot];
+  if (timer.next != kNil) {
+    timers_[timer.next].prev = index;
+  }
+  heads_[timer.slot] = index;
+  ++level_counts_[level];
+  if (level == 0) {
+    occupied_[slot_in_level / 64] |= std::uint64_t{1} << (slot_in_level % 64);
+  }
+}
+
+void AutorepeatScheduler::Unlink(std::uint32_t index) {
+  Timer& timer = timers_[index];
+  if (timer.prev != kNil) {
+    timers_[timer.prev].next = timer.next;
+  } else {
+    heads_[timer.slot] = timer.next;
+  }
+  if (timer.next != kNil) {
+    timers_[timer.next].prev = timer.prev;
+  }
+  const std::size_t level = timer.slot / kSlots;
+  --level_counts_[level];
+  if (level == 0 && heads_[timer.slot] == kNil) {
+    occupied_[timer.slot / 64] &= ~(std::uint64_t{1} << (timer.slot % 64));
+  }
+}
+
+void AutorepeatScheduler::Cascade() {
+  // Higher levels first, so that their timers can cascade again into the
+  // slot of the level below that starts at the same tick.
+  for (int level = kLevels - 1; level > 0; --level) {
+    const std::uint64_t span = std::uint64_t{1} << (kSlotBits * level);
+    if ((current_tick_ & (span - 1)) != 0 || level_counts_[level] == 0) {
+      continue;
+    }
+    const std::size_t slot =
+        level * kSlots +
+        ((current_tick_ >> (kSlotBits * level)) & (kSlots - 1));
+    std::uint32_t index = heads_[slot];
+    while (index != kNil) {
+      const std::uint32_t next = timers_[index].next;
+      Unlink(index);
+      Link(index);
+      index = next;
+    }
+  }
+}
+
+std::uint64_t AutorepeatScheduler::NextEventTick() const {
+  std::uint64_t next = kNever;
+  if (level_counts_[0] > 0) {
+    // First occupied slot after the current one, circularly.
+    const std::size_t start = (current_tick_ + 1) & (kSlots - 1);
+    for (std::size_t i = 0; i <= occupied_.size(); ++i) {
+      const std::size_t word = (start / 64 + i) % occupied_.size();
+      std::uint64_t bits = occupied_[word];
+      if (i == 0) {
+        bits &= ~std::uint64_t{0} << (start % 64);
+      } else if (i == occupied_.size()) {
+        bits &= ~(~std::uint64_t{0} << (start % 64));
+      }
+      if (bits != 0) {
+        const std::size_t slot = word * 64 + __builtin_ctzll(bits);
+        next = current_tick_ + 1 + ((slot - start) & (kSlots - 1));
+        break;
+      }
+    }
+  }
+  for (int level = 1; level < kLevels; ++level) {
+    if (level_counts_[level] > 0) {
+      const int shift = kSlotBits * level;
+      next = std::min(next, ((current_tick_ >> shift) + 1) << shift);
+    }
+  }
+  return next;
+}
+
+std::size_t AutorepeatScheduler::Advance(std::uint64_t target,
+                                         std::int64_t now_ns) {
+  std::size_t repeats = 0;
+  while (current_tick_ < target) {
+    const std::uint64_t next = NextEventTick();
+    if (next > target) {
+      current_tick_ = target;
+      break;
+    }
+    current_tick_ = next;
+    Cascade();
+    const std::size_t slot = current_tick_ & (kSlots - 1);
+    while (heads_[slot] != kNil) {
+      const std::uint32_t index = heads_[slot];
+      Unlink(index);
+      Timer& timer = timers_[index];
+      DeviceState& state = devices_[timer.device];
+      if (state.period_ticks == 0) {
+        // Repeat was turned off while the key was held, drop the timer
+        // without repeating.
+        active_.erase(ActiveKey(timer.device, timer.code));
+        free_timers_.push_back(index);
+        state.repeating = -1;
+        continue;
+      }
+      if (state.pending.empty()) {
+        dirty_devices_.push_back(timer.device);
+      }
+      state.pending.push_back({.type = EV_KEY, .code = timer.code, .value = 2});
+      lateness_.RecordNanos(now_ns - start_ns_ -
+                            static_cast<std::int64_t>(timer.expiry) * tick_ns_);
+      ++repeats;
+      // Keep the cadence when on time. When late, the next repeat is a
+      // period after this one (like the kernel), instead of a burst to
+      // catch up.
+      timer.expiry += state.period_ticks;
+      if (timer.expiry <= target) {
+        timer.expiry = target + state.period_ticks;
+      }
+      Link(index);
+    }
+  }
+  return repeats;
+}
+
+absl::Status AutorepeatScheduler::Rearm() {
+  const std::uint64_t next = NextEventTick();
+  if (next == armed_tick_) {
+    return absl::OkStatus();
+  }
+  itimerspec spec{};
+  if (next != kNever) {
+    const std::int64_t at =
+        start_ns_ + static_cast<std::int64_t>(next) * tick_ns_;
+    spec.it_value.tv_sec = at / 1'000'000'000;
+    spec.it_value.tv_nsec = at % 1'000'000'000;
+  }
+  if (::timerfd_settime(timer_fd_.Fd(), TFD_TIMER_ABSTIME, &spec, nullptr) <
+      0) {
+    return absl::ErrnoToStatus(errno, "Arming autorepeat timer failed");
+  }
+  armed_tick_ = next;
+  return absl::OkStatus();
+}
+
+absl::Status AutorepeatScheduler::Flush() {
+  absl::Status result;
+  for (DeviceId device : dirty_devices_) {
+    DeviceState& state = devices_[device];
+    if (state.io == nullptr || state.pending.empty()) {
+      state.pending.clear();
+      continue;
+    }
+    state.pending.push_back({.type = EV_SYN, .code = SYN_REPORT, .value = 0});
+    if (auto st = state.io->WriteRaw(state.pending); !st.ok() && result.ok()) {
+      // Keep writing to the other devices.
+      result = st;
+    }
+    state.pending.clear();
+  }
+  dirty_devices_.clear();
+  return result;
+}
+
+}  // namespace evdevpp
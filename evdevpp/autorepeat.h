@@ -0,0 +1,167 @@
+#ifndef EVDEVPP_EVDEVPP_AUTOREPEAT_H_
+#define EVDEVPP_EVDEVPP_AUTOREPEAT_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/time/time.h"
+#include "evdevpp/eventio.h"
+#include "evdevpp/info.h"
+#include "evdevpp/latency_stats.h"
+#include "linux/input.h"
+#include "toolbelt/fd.h"
+
+namespace evdevpp {
+
+// Software key repeat for many devices (typically `UserInputDevice`s, for
+// which the kernel does not generate repeats), driven by a single timer.
+//
+// Held keys are kept in a hierarchical timer wheel (4 levels of 256 slots
+// of `tick`), so pressing, releasing and repeating a key are constant time
+// regardless of how many keys are held. A single `timerfd` is armed on the
+// next non-empty slot, and all the repeats due at once are written with one
+// batched write per device, each followed by a `SYN_REPORT`.
+//
+// The repeat follows the kernel semantics of `KeyRepeatInfo`: the first
+// repeat (an `EV_KEY` event with value 2) comes `delay` after the press,
+// then `repeat_key_per_s` times per second, and a zero delay or rate turns
+// repeat off. By default, only the last key pressed on a device repeats.
+//
+//   auto sched_or = AutorepeatScheduler::Create();
+//   auto id = sched_or->AddDevice(&kbd, {.repeat_key_per_s = 25,
+//                                        .delay = absl::Milliseconds(250)});
+//   (void)kbd.Write(EventType::kKey, Key::kA, 1);
+//   (void)sched_or->Press(id, Key::kA);
+//   ... when sched_or->Fd() is readable:
+//   (void)sched_or->Dispatch();
+//
+// Not thread-safe.
+class AutorepeatScheduler {
+ public:
+  struct Options {
+    // Resolution of the timer wheel. Repeats fire within one tick after
+    // they are due.
+    absl::Duration tick = absl::Milliseconds(1);
+    // Only repeat the last key pressed on each device, and stop when any key
+    // is released, like the kernel. Otherwise, all the held keys repeat
+    // until they are released.
+    bool last_key_only = true;
+  };
+  // Work-around for GCC/Clang bug.
+  static Options Defaults() { return Options{}; }
+
+  using DeviceId = std::uint32_t;
+
+  static absl::StatusOr<AutorepeatScheduler> Create(
+      const Options& options = Defaults());
+
+  // A file descriptor (timerfd) that is readable when repeats are due, at
+  // which point `Dispatch` must be called.
+  [[nodiscard]] const toolbelt::FileDescriptor& Fd() const { return timer_fd_; }
+
+  // Add a device to write the repeats of its keys to. `device` must outlive
+  // the scheduler, or be removed first.
+  DeviceId AddDevice(const EventIO* device, const KeyRepeatInfo& repeat);
+  // Stop all repeats of `device` and forget it.
+  void RemoveDevice(DeviceId device);
+  // Change the repeat of `device`. Keys already repeating switch to the new
+  // rate on their next repeat.
+  void SetRepeat(DeviceId device, const KeyRepeatInfo& repeat);
+  [[nodiscard]] const KeyRepeatInfo& GetRepeat(DeviceId device) const {
+    return devices_[device].repeat;
+  }
+
+  // Start or stop repeating a key, when it is pressed or released on the
+  // device (the press and release events are written by the caller).
+  absl::Status Press(DeviceId device, std::uint16_t code);
+  absl::Status Release(DeviceId device, std::uint16_t code);
+  // `Press` or `Release` for the key events (other events are ignored), to
+  // follow a stream of events written to the device.
+  absl::Status Observe(DeviceId device, const input_event& event);
+
+  // Write the repeats that are due. Returns the number of repeats written.
+  absl::StatusOr<std::size_t> Dispatch();
+
+  // Number of keys repeating (or waiting for their first repeat).
+  [[nodiscard]] std::size_t ActiveCount() const { return active_.size(); }
+  // How late each repeat was written, relative to when it was due.
+  [[nodiscard]] const LatencyHistogram& Lateness() const { return lateness_; }
+
+ private:
+  static constexpr int kLevels = 4;
+  static constexpr int kSlotBits = 8;
+  static constexpr std::size_t kSlots = std::size_t{1} << kSlotBits;
+  static constexpr std::uint32_t kNil = 0xFFFFFFFF;
+  static constexpr std::uint64_t kNever = ~std::uint64_t{0};
+
+  struct Timer {
+    std::uint64_t expiry = 0;
+    std::uint32_t prev = kNil;
+    std::uint32_t next = kNil;
+    std::uint32_t device = 0;
+    std::uint16_t code = 0;
+    // Index in `heads_` of the list the timer is in.
+    std::uint16_t slot = 0;
+  };
+  struct DeviceState {
+    const EventIO* io = nullptr;
+    KeyRepeatInfo repeat;
+    // Zero when repeat is off.
+    std::uint64_t delay_ticks = 0;
+    std::uint64_t period_ticks = 0;
+    // The repeating key, with `last_key_only`.
+    std::int32_t repeating = -1;
+    // Repeats to write at the end of the dispatch.
+    std::vector<input_event> pending;
+  };
+
+  static std::uint64_t ActiveKey(DeviceId device, std::uint16_t code) {
+    return (std::uint64_t{device} << 16) | code;
+  }
+
+  [[nodiscard]] std::uint64_t TickAt(std::int64_t monotonic_ns) const;
+  void Cancel(DeviceId device, std::uint16_t code);
+  // Insert timer `index` in the wheel, according to its expiry.
+  void Link(std::uint32_t index);
+  void Unlink(std::uint32_t index);
+  // Move the timers of the higher level slots that start at `current_tick_`
+  // down the wheel.
+  void Cascade();
+  // The next tick at which a slot must be expired or cascaded.
+  [[nodiscard]] std::uint64_t NextEventTick() const;
+  // Advance the wheel up to `target`, expiring the due timers.
+  std::size_t Advance(std::uint64_t target, std::int64_t now_ns);
+  absl::Status Rearm();
+  absl::Status Flush();
+
+  Options options_;
+  std::int64_t tick_ns_ = 0;
+  // Monotonic time of tick 0.
+  std::int64_t start_ns_ = 0;
+  std::uint64_t current_tick_ = 0;
+  std::uint64_t armed_tick_ = kNever;
+  toolbelt::FileDescriptor timer_fd_;
+
+  std::vector<Timer> timers_;
+  std::vector<std::uint32_t> free_timers_;
+  std::array<std::uint32_t, kLevels * kSlots> heads_{};
+  std::array<std::size_t, kLevels> level_counts_{};
+  // Non-empty slots of the first level.
+  std::array<std::uint64_t, kSlots / 64> occupied_{};
+  // Timer of each active (device, code).
+  absl::flat_hash_map<std::uint64_t, std::uint32_t> active_;
+
+  std::vector<DeviceState> devices_;
+  std::vector<DeviceId> free_devices_;
+  std::vector<DeviceId> dirty_devices_;
+  LatencyHistogram lateness_;
+};
+
+}  // namespace evdevpp
+
+#endif  // EVDEVPP_EVDEVPP_AUTOREPEAT_H_
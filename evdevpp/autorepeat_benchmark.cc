@@ -0,0 +1,96 @@
+// Cost of AutorepeatScheduler operations with many keys held: press and
+// release, and dispatching the repeats that are due. Repeats are written to
+// /dev/null.
+//
+//   bazel run -c opt //evdevpp:autorepeat_benchmark
+
+#include <fcntl.h>
+#include <poll.h>
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "absl/time/time.h"
+#include "benchmark/benchmark.h"
+#include "evdevpp/autorepeat.h"
+#include "evdevpp/eventio.h"
+#include "toolbelt/fd.h"
+
+namespace evdevpp {
+namespace {
+
+constexpr int kDevices = 200;
+
+class NullDevice : public EventIO {
+ public:
+  NullDevice() {
+    fd_ = toolbelt::FileDescriptor(::open("/dev/null", O_WRONLY | O_CLOEXEC));
+  }
+};
+
+// `keys` distinct keys held, spread over `kDevices` devices.
+struct HeldKeys {
+  explicit HeldKeys(int keys, const KeyRepeatInfo& repeat)
+      : scheduler(*AutorepeatScheduler::Create({.last_key_only = false})),
+        devices(kDevices) {
+    for (const auto& device : devices) {
+      ids.push_back(scheduler.AddDevice(&device, repeat));
+    }
+    for (int key = 0; key < keys; ++key) {
+      (void)scheduler.Press(ids[key % kDevices], Code(key));
+    }
+  }
+
+  static std::uint16_t Code(int key) {
+    return static_cast<std::uint16_t>(1 + key / kDevices);
+  }
+
+  AutorepeatScheduler scheduler;
+  std::deque<NullDevice> devices;
+  std::vector<AutorepeatScheduler::DeviceId> ids;
+};
+
+// Press and release one more key, with `range(0)` keys already held.
+void BM_PressRelease(benchmark::State& state) {
+  HeldKeys held(static_cast<int>(state.range(0)),
+                {.repeat_key_per_s = 30, .delay = absl::Milliseconds(250)});
+  const AutorepeatScheduler::DeviceId device = held.ids.front();
+  for (auto _ : state) {
+    (void)held.scheduler.Press(device, KEY_MAX);
+    (void)held.scheduler.Release(device, KEY_MAX);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PressRelease)->Arg(0)->Arg(1000)->Arg(10000);
+
+// Dispatch the repeats of `range(0)` held keys, all repeating every
+// millisecond. Only the `Dispatch` calls are timed, not the waits for the
+// timer; items are repeats written.
+void BM_DispatchRepeats(benchmark::State& state) {
+  HeldKeys held(static_cast<int>(state.range(0)),
+                {.repeat_key_per_s = 1000, .delay = absl::Milliseconds(1)});
+  AutorepeatScheduler& scheduler = held.scheduler;
+  std::int64_t repeats = 0;
+  for (auto _ : state) {
+    pollfd ready = {.fd = scheduler.Fd().Fd(), .events = POLLIN};
+    (void)::poll(&ready, 1, 100);
+    const auto start = std::chrono::steady_clock::now();
+    auto count_or = scheduler.Dispatch();
+    const auto stop = std::chrono::steady_clock::now();
+    if (!count_or.ok()) {
+      state.SkipWithError(count_or.status().ToString().c_str());
+      break;
+    }
+    repeats += static_cast<std::int64_t>(*count_or);
+    state.SetIterationTime(std::chrono::duration<double>(stop - start).count());
+  }
+  state.SetItemsProcessed(repeats);
+  state.counters["lateness_p50_us"] =
+      absl::ToDoubleMicroseconds(scheduler.Lateness().Percentile(50.0));
+}
+BENCHMARK(BM_DispatchRepeats)->Arg(100)->Arg(10000)->UseManualTime();
+
+}  // namespace
+}  // namespace evdevpp
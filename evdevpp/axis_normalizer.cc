@@ -0,0 +1,217 @@
+#include "evdevpp/axis_normalizer.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include "absl/status/status.h"
+
+namespace evdevpp {
+
+namespace {
+
+// The kernels below avoid comparisons on floats, GCC does not vectorize
+// selects on them under the default -ftrapping-math.
+
+// max(value, 0).
+inline float MaxZero(float value) {
+  return 0.5F * (value + std::fabs(value));
+}
+
+// min(value, 1).
+inline float MinOne(float value) {
+  return 0.5F * (value + 1.0F - std::fabs(value - 1.0F));
+}
+
+// Axes normalized at a time. The tables are padded to a multiple of it, so
+// that the loops have a fixed trip count, which -O2 vectorizes.
+constexpr std::size_t kLanes = 8;
+
+bool CenteredByDefault(std::uint16_t code, const AbsInfo& info) {
+  if (info.minimum < 0) {
+    return true;
+  }
+  switch (code) {
+    case ABS_X:
+    case ABS_Y:
+    case ABS_RX:
+    case ABS_RY:
+      return true;
+    default:
+      return code >= ABS_HAT0X && code <= ABS_HAT3Y;
+  }
+}
+
+}  // namespace
+
+absl::StatusOr<AxisNormalizer> AxisNormalizer::Create(
+    const CapabilitiesInfo& capabilities, const Options& options) {
+  AxisNormalizer result;
+  result.index_.fill(-1);
+  for (const auto& [code, info] : capabilities.absolute_axes) {
+    if (code < ABS_CNT) {
+      result.axes_.push_back(code);
+    }
+  }
+  std::sort(result.axes_.begin(), result.axes_.end());
+
+  const std::size_t count = result.axes_.size();
+  const std::size_t padded = (count + kLanes - 1) / kLanes * kLanes;
+  result.scale_.resize(padded);
+  result.offset_.resize(padded);
+  result.lower_.resize(padded);
+  result.deadzone_.resize(padded);
+  result.stretch_.resize(padded);
+  result.curve_begin_.resize(count);
+  result.curve_end_.resize(count);
+  const AxisConfig no_config;
+  for (std::size_t i = 0; i < count; ++i) {
+    const std::uint16_t code = result.axes_[i];
+    result.index_[code] = static_cast<std::int8_t>(i);
+    auto config_it = options.axes.find(code);
+    const AxisConfig& config =
+        config_it != options.axes.end() ? config_it->second : no_config;
+    const AbsInfo& info =
+        config.info.value_or(capabilities.absolute_axes.at(code));
+    if (info.maximum < info.minimum) {
+      return absl::InvalidArgumentError(
+          "Axis maximum must not be less than its minimum");
+    }
+    const bool centered =
+        config.centered.value_or(CenteredByDefault(code, info));
+    // In double, the range of an int32 axis may not fit in an int32.
+    const auto minimum = static_cast<double>(info.minimum);
+    const auto maximum = static_cast<double>(info.maximum);
+    const double range = maximum - minimum;
+    // Half of the range, for a centered axis.
+    const double span = centered ? range / 2.0 : range;
+    const double origin = centered ? (minimum + maximum) / 2.0 : minimum;
+    const float deadzone = config.deadzone.value_or(
+        span > 0.0 ? static_cast<float>(info.flat / span) : 0.0F);
+    if (!(deadzone >= 0.0F && deadzone < 1.0F)) {
+      return absl::InvalidArgumentError("Axis deadzone must be in [0, 1)");
+    }
+    // A degenerate axis is always 0.
+    result.scale_[i] = span > 0.0 ? static_cast<float>(1.0 / span) : 0.0F;
+    result.offset_[i] =
+        span > 0.0 ? static_cast<float>(-origin / span) : 0.0F;
+    result.lower_[i] = centered ? -1.0F : 0.0F;
+    result.deadzone_[i] = deadzone;
+    result.stretch_[i] = 1.0F / (1.0F - deadzone);
+
+    const auto begin = static_cast<std::uint32_t>(result.curves_.size());
+    if (!config.curve.empty()) {
+      if (config.curve.size() < 2) {
+        return absl::InvalidArgumentError(
+            "Axis response curve needs at least two samples");
+      }
+      result.curves_.insert(result.curves_.end(), config.curve.begin(),
+                            config.curve.end());
+      result.curved_.push_back(static_cast<int>(i));
+    }
+    result.curve_begin_[i] = begin;
+    result.curve_end_[i] = static_cast<std::uint32_t>(result.curves_.size());
+  }
+  return result;
+}
+
+std::vector<float> AxisNormalizer::PowerCurve(float exponent,
+                                              std::size_t samples) {
+  std::vector<float> result(std::max<std::size_t>(samples, 2));
+  const float step = 1.0F / static_cast<float>(result.size() - 1);
+  for (std::size_t i = 0; i < result.size(); ++i) {
+    result[i] = std::pow(static_cast<float>(i) * step, exponent);
+  }
+  return result;
+}
+
+float AxisNormalizer::Normalize(std::uint16_t code, std::int32_t value) const {
+  const int index = Index(code);
+  return index < 0 ? 0.0F : NormalizeAt(index, value);
+}
+
+void AxisNormalizer::NormalizeState(absl::Span<const std::int32_t> values,
+                                    absl::Span<float> out) const {
+  const std::size_t count = std::min({values.size(), out.size(), axes_.size()});
+  for (std::size_t base = 0; base < count; base += kLanes) {
+    // Blocks that go past the end of `values` or `out` (shorter than
+    // `StateSize()`) are copied, which stalls the vectorized loads and
+    // stores. The output goes through a local block, which -O2 knows does
+    // not overlap the inputs (it does not check for overlaps at run time).
+    const std::int32_t* in = values.data() + base;
+    std::array<std::int32_t, kLanes> padded{};
+    if (values.size() - base < kLanes) {
+      std::copy_n(in, std::min(kLanes, count - base), padded.begin());
+      in = padded.data();
+    }
+    std::array<float, kLanes> block;
+    const float* scale = scale_.data() + base;
+    const float* offset = offset_.data() + base;
+    const float* lower = lower_.data() + base;
+    const float* deadzone = deadzone_.data() + base;
+    const float* stretch = stretch_.data() + base;
+    for (std::size_t i = 0; i < kLanes; ++i) {
+      // Clamped to [lower, 1].
+      const float x = MinOne(
+          lower[i] + MaxZero(static_cast<float>(in[i]) * scale[i] +
+                             offset[i] - lower[i]));
+      const float magnitude =
+          MinOne(MaxZero(std::fabs(x) - deadzone[i]) * stretch[i]);
+      block[i] = std::copysign(magnitude, x);
+    }
+    if (out.size() - base >= kLanes) {
+      std::copy(block.begin(), block.end(), out.begin() + base);
+    } else {
+      std::copy_n(block.begin(), std::min(kLanes, count - base),
+                  out.begin() + base);
+    }
+  }
+  for (const int i : curved_) {
+    if (static_cast<std::size_t>(i) < count) {
+      out[i] = ApplyCurve(i, out[i]);
+    }
+  }
+}
+
+std::size_t AxisNormalizer::NormalizeEvents(
+    absl::Span<const input_event> events, AxisValue* out) const {
+  std::size_t written = 0;
+  for (const input_event& event : events) {
+    if (event.type != EV_ABS) {
+      continue;
+    }
+    const int index = Index(event.code);
+    if (index < 0) {
+      continue;
+    }
+    out[written++] = {.code = event.code,
+                      .value = NormalizeAt(index, event.value)};
+  }
+  return written;
+}
+
+float AxisNormalizer::NormalizeAt(int index, std::int32_t value) const {
+  const float x = std::clamp(
+      static_cast<float>(value) * scale_[index] + offset_[index],
+      lower_[index], 1.0F);
+  const float magnitude = std::min(
+      std::max(std::fabs(x) - deadzone_[index], 0.0F) * stretch_[index], 1.0F);
+  return ApplyCurve(index, std::copysign(magnitude, x));
+}
+
+float AxisNormalizer::ApplyCurve(int index, float value) const {
+  const std::uint32_t begin = curve_begin_[index];
+  const std::uint32_t end = curve_end_[index];
+  if (begin == end) {
+    return value;
+  }
+  const std::uint32_t last = end - begin - 1;
+  const float position = std::fabs(value) * static_cast<float>(last);
+  const auto below =
+      std::min(static_cast<std::uint32_t>(position), last - 1);
+  const float fraction = position - static_cast<float>(below);
+  const float* curve = curves_.data() + begin + below;
+  return std::copysign(curve[0] + (curve[1] - curve[0]) * fraction, value);
+}
+
+}  // namespace evdevpp
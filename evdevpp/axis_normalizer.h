@@ -0,0 +1,129 @@
+#ifndef EVDEVPP_EVDEVPP_AXIS_NORMALIZER_H_
+#define EVDEVPP_EVDEVPP_AXIS_NORMALIZER_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/statusor.h"
+#include "absl/types/span.h"
+#include "evdevpp/info.h"
+#include "linux/input.h"
+
+namespace evdevpp {
+
+// Converts absolute axis values to floats, with a deadzone and an optional
+// response curve per axis.
+//
+// Centered axes (sticks, hats) are mapped to [-1, 1] and one-sided axes
+// (triggers, throttles) to [0, 1], from their minimum and maximum. Values
+// within the deadzone (by default, the `flat` of the axis) around the
+// center (or above the minimum) are 0, and the rest of the range is
+// stretched to reach 1 at the ends. The response curve, if any, then maps
+// the magnitude.
+//
+// The per-axis parameters are computed once, into dense tables indexed by
+// the position of the axis in `Axes()`. State arrays (the values of all
+// the axes, in that order) are normalized with vectorized loops, and
+// events with a table lookup per event.
+//
+//   auto norm_or = AxisNormalizer::Create(pad.Capabilities());
+//   std::vector<std::int32_t> state(norm_or->StateSize());
+//   ... state[norm_or->Index(code)] = value, for each ABS_* event ...
+//   std::vector<float> sticks(state.size());
+//   norm_or->NormalizeState(state, absl::MakeSpan(sticks));
+class AxisNormalizer {
+ public:
+  struct AxisConfig {
+    // Replaces the axis information of the device (e.g., a calibration).
+    std::optional<AbsInfo> info;
+    // Deadzone, as a fraction (in [0, 1)) of the range from the center (or
+    // the minimum). Defaults to the `flat` of the axis.
+    std::optional<float> deadzone;
+    // Whether the axis is centered. Defaults to centered if the minimum is
+    // negative, or for the X, Y, RX, RY and hat axes.
+    std::optional<bool> centered;
+    // Output magnitudes for input magnitudes evenly spaced from 0 to 1 (at
+    // least two), linearly interpolated. Empty for a linear response.
+    std::vector<float> curve;
+  };
+
+  struct Options {
+    // By `ABS_*` code.
+    absl::flat_hash_map<std::uint16_t, AxisConfig> axes;
+  };
+  // Work-around for GCC/Clang bug.
+  static Options Defaults() { return Options{}; }
+
+  struct AxisValue {
+    std::uint16_t code = 0;
+    float value = 0.0F;
+  };
+
+  // Normalize the absolute axes of `capabilities` (e.g., of
+  // `InputDevice::Capabilities()`).
+  static absl::StatusOr<AxisNormalizer> Create(
+      const CapabilitiesInfo& capabilities,
+      const Options& options = Defaults());
+
+  // A response curve `x^exponent`, for `AxisConfig::curve`.
+  static std::vector<float> PowerCurve(float exponent,
+                                       std::size_t samples = 65);
+
+  // The axes, in the order of state arrays.
+  [[nodiscard]] absl::Span<const std::uint16_t> Axes() const { return axes_; }
+  // Size of state arrays: the number of axes, rounded up for the vectorized
+  // loops. Shorter arrays work, with extra copies.
+  [[nodiscard]] std::size_t StateSize() const { return scale_.size(); }
+  // Index of axis `code` in state arrays, -1 if the device has no such axis.
+  [[nodiscard]] int Index(std::uint16_t code) const {
+    return code < ABS_CNT ? index_[code] : -1;
+  }
+
+  // Normalize `value` of axis `code`, 0 for an unknown axis.
+  [[nodiscard]] float Normalize(std::uint16_t code, std::int32_t value) const;
+
+  // Normalize the values of all the axes (in the order of `Axes()`) into
+  // `out`, both of `StateSize()` (or at least of the number of axes). The
+  // values past the axes are ignored, and their output is 0.
+  void NormalizeState(absl::Span<const std::int32_t> values,
+                      absl::Span<float> out) const;
+
+  // Normalize the `EV_ABS` events of known axes in `events`, writing them
+  // in order to `out` (which has room for `events.size()` values). Returns
+  // the number of values written.
+  std::size_t NormalizeEvents(absl::Span<const input_event> events,
+                              AxisValue* out) const;
+
+ private:
+  // Normalize `value` of the axis at `index`.
+  [[nodiscard]] float NormalizeAt(int index, std::int32_t value) const;
+  // Apply the response curve of the axis at `index` to `value`.
+  [[nodiscard]] float ApplyCurve(int index, float value) const;
+
+  std::vector<std::uint16_t> axes_;
+  std::array<std::int8_t, ABS_CNT> index_{};
+
+  // Per axis, by index, padded to `StateSize()` with zeros: `x = value *
+  // scale + offset` maps the range to [-1, 1] or [0, 1], `lower` is -1 or
+  // 0, and the magnitude out of the deadzone is `(|x| - deadzone) *
+  // stretch`.
+  std::vector<float> scale_;
+  std::vector<float> offset_;
+  std::vector<float> lower_;
+  std::vector<float> deadzone_;
+  std::vector<float> stretch_;
+  // Response curves, as [begin, end) ranges of `curves_`, empty for none.
+  std::vector<std::uint32_t> curve_begin_;
+  std::vector<std::uint32_t> curve_end_;
+  std::vector<float> curves_;
+  // Indices of the axes with a response curve.
+  std::vector<int> curved_;
+};
+
+}  // namespace evdevpp
+
+#endif  // EVDEVPP_EVDEVPP_AXIS_NORMALIZER_H_
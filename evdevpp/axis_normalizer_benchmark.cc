@@ -0,0 +1,87 @@
+// Cost of AxisNormalizer per frame (one value of each axis), for state
+// arrays and for events, on devices with `range(0)` axes. Items are axis
+// values.
+//
+//   bazel run -c opt //evdevpp:axis_normalizer_benchmark
+
+#include <cstdint>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "benchmark/benchmark.h"
+#include "evdevpp/axis_normalizer.h"
+#include "evdevpp/info.h"
+#include "linux/input.h"
+
+namespace evdevpp {
+namespace {
+
+CapabilitiesInfo Axes(int count) {
+  CapabilitiesInfo capabilities;
+  for (int code = 0; code < count; ++code) {
+    capabilities.absolute_axes[static_cast<std::uint16_t>(code)] =
+        AbsInfo{.minimum = -32768, .maximum = 32767, .flat = 128};
+  }
+  return capabilities;
+}
+
+// A response curve on every other axis.
+AxisNormalizer::Options Curves(int count) {
+  AxisNormalizer::Options options;
+  for (int code = 0; code < count; code += 2) {
+    options.axes[static_cast<std::uint16_t>(code)].curve =
+        AxisNormalizer::PowerCurve(2.0F);
+  }
+  return options;
+}
+
+void BM_NormalizeState(benchmark::State& state) {
+  const auto axes = static_cast<int>(state.range(0));
+  const AxisNormalizer normalizer = *AxisNormalizer::Create(Axes(axes));
+  std::vector<std::int32_t> values(normalizer.StateSize());
+  std::vector<float> out(normalizer.StateSize());
+  std::int32_t value = 0;
+  for (auto _ : state) {
+    values[value % axes] = value & 0xffff;
+    ++value;
+    normalizer.NormalizeState(values, absl::MakeSpan(out));
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetItemsProcessed(state.iterations() * axes);
+}
+BENCHMARK(BM_NormalizeState)->Arg(6)->Arg(16);
+
+void NormalizeEventsLoop(benchmark::State& state,
+                         const AxisNormalizer& normalizer, int axes) {
+  std::vector<input_event> events(axes);
+  for (int code = 0; code < axes; ++code) {
+    events[code] = {.type = EV_ABS,
+                    .code = static_cast<std::uint16_t>(code),
+                    .value = code * 1000};
+  }
+  std::vector<AxisNormalizer::AxisValue> out(axes);
+  std::int32_t value = 0;
+  for (auto _ : state) {
+    events[value % axes].value = value & 0xffff;
+    ++value;
+    benchmark::DoNotOptimize(normalizer.NormalizeEvents(events, out.data()));
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetItemsProcessed(state.iterations() * axes);
+}
+
+void BM_NormalizeEvents(benchmark::State& state) {
+  const auto axes = static_cast<int>(state.range(0));
+  NormalizeEventsLoop(state, *AxisNormalizer::Create(Axes(axes)), axes);
+}
+BENCHMARK(BM_NormalizeEvents)->Arg(6)->Arg(16);
+
+void BM_NormalizeEventsWithCurves(benchmark::State& state) {
+  const auto axes = static_cast<int>(state.range(0));
+  NormalizeEventsLoop(
+      state, *AxisNormalizer::Create(Axes(axes), Curves(axes)), axes);
+}
+BENCHMARK(BM_NormalizeEventsWithCurves)->Arg(6)->Arg(16);
+
+}  // namespace
+}  // namespace evdevpp
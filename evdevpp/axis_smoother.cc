@@ -0,0 +1,242 @@
+#include "evdevpp/axis_smoother.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "absl/status/status.h"
+#include "evdevpp/eventio.h"
+
+namespace evdevpp {
+
+namespace {
+
+// Shortest time between updates, for frames with the same (or an earlier)
+// timestamp.
+constexpr double kMinDt = 1.0e-4;
+
+bool IsMultiTouch(std::uint16_t code) {
+  return code >= ABS_MT_TOUCH_MAJOR && code <= ABS_MT_TOOL_Y;
+}
+
+// Smoothing factor of a first-order low-pass filter with `cutoff_hz`, for a
+// step of `dt` seconds.
+double Alpha(double cutoff_hz, double dt) {
+  const double tau = 1.0 / (2.0 * M_PI * cutoff_hz);
+  return dt / (dt + tau);
+}
+
+}  // namespace
+
+absl::StatusOr<AxisSmoother> AxisSmoother::Create(
+    const CapabilitiesInfo& capabilities, const Options& options) {
+  AxisSmoother result;
+  result.options_ = options;
+  result.first_channel_.fill(-1);
+  if (auto slot_it = capabilities.absolute_axes.find(ABS_MT_SLOT);
+      slot_it != capabilities.absolute_axes.end()) {
+    result.slot_count_ = std::clamp<std::size_t>(
+        std::max(slot_it->second.maximum + 1, 1), 1, kMaxSlots);
+  }
+
+  std::vector<std::uint16_t> codes;
+  codes.reserve(options.axes.size());
+  for (const auto& [code, config] : options.axes) {
+    codes.push_back(code);
+  }
+  // In code order, for a layout that does not depend on the hash map.
+  std::sort(codes.begin(), codes.end());
+  for (const std::uint16_t code : codes) {
+    const AxisConfig& config = options.axes.at(code);
+    auto info_it = capabilities.absolute_axes.find(code);
+    if (code >= ABS_CNT || info_it == capabilities.absolute_axes.end() ||
+        code == ABS_MT_SLOT || code == ABS_MT_TRACKING_ID) {
+      return absl::InvalidArgumentError(
+          "Smoothed axes must be value axes of the device");
+    }
+    const double fuzz = std::max(info_it->second.fuzz, 1);
+    const Params params = {
+        .kind = config.kind,
+        .min_cutoff_hz = config.min_cutoff_hz,
+        .beta = config.beta,
+        .derivative_cutoff_hz = config.derivative_cutoff_hz,
+        .time_constant = absl::ToDoubleSeconds(config.time_constant),
+        .process_noise = config.process_noise,
+        .measurement_noise = config.measurement_noise.value_or(fuzz * fuzz),
+    };
+    if (!(params.min_cutoff_hz > 0.0 && params.derivative_cutoff_hz > 0.0 &&
+          params.beta >= 0.0 && params.time_constant > 0.0 &&
+          params.process_noise > 0.0 && params.measurement_noise > 0.0)) {
+      return absl::InvalidArgumentError(
+          "Smoothing cutoffs, time constants and noises must be positive");
+    }
+    result.first_channel_[code] =
+        static_cast<std::int32_t>(result.params_.size());
+    const std::size_t channels = IsMultiTouch(code) ? result.slot_count_ : 1;
+    result.params_.insert(result.params_.end(), channels, params);
+  }
+
+  const std::size_t count = result.params_.size();
+  result.value_.resize(count);
+  result.velocity_.resize(count);
+  result.p00_.resize(count);
+  result.p01_.resize(count);
+  result.p11_.resize(count);
+  result.time_ns_.resize(count);
+  result.primed_.resize(count);
+  result.measurement_.resize(count);
+  result.measured_.resize(count);
+  return result;
+}
+
+std::size_t AxisSmoother::Process(absl::Span<const input_event> events,
+                                  std::vector<input_event>* out) {
+  const std::size_t before = out->size();
+  for (const input_event& event : events) {
+    if (event.type == EV_SYN && event.code == SYN_REPORT) {
+      frame_.push_back(event);
+      EndFrame(EventNanos(event));
+      out->insert(out->end(), frame_.begin(), frame_.end());
+      frame_.clear();
+      continue;
+    }
+    if (event.type == EV_SYN && event.code == SYN_DROPPED) {
+      // Events were lost, the next frames may jump.
+      Reset();
+    } else if (event.type == EV_ABS) {
+      if (event.code == ABS_MT_SLOT) {
+        slot_ = event.value;
+      } else if (event.code == ABS_MT_TRACKING_ID) {
+        // A new contact (or none), unrelated to the last one in the slot.
+        for (std::uint16_t code = ABS_MT_TOUCH_MAJOR; code <= ABS_MT_TOOL_Y;
+             ++code) {
+          if (const int channel = Channel(code, slot_); channel >= 0) {
+            primed_[channel] = 0;
+          }
+        }
+      } else if (const int channel = Channel(event.code, slot_);
+                 channel >= 0) {
+        measurement_[channel] = event.value;
+        if (measured_[channel] == 0) {
+          measured_[channel] = 1;
+          dirty_.push_back(channel);
+        }
+        patches_.emplace_back(frame_.size(), channel);
+      }
+    }
+    frame_.push_back(event);
+  }
+  return out->size() - before;
+}
+
+std::optional<double> AxisSmoother::Value(std::uint16_t code,
+                                          int slot) const {
+  const int channel = Channel(code, slot);
+  if (channel < 0 || primed_[channel] == 0) {
+    return std::nullopt;
+  }
+  return value_[channel];
+}
+
+std::optional<double> AxisSmoother::Predict(std::uint16_t code, int slot,
+                                            absl::Time at) const {
+  const int channel = Channel(code, slot);
+  if (channel < 0 || primed_[channel] == 0) {
+    return std::nullopt;
+  }
+  const absl::Duration ahead =
+      std::clamp(at - absl::FromUnixNanos(time_ns_[channel]),
+                 absl::ZeroDuration(), options_.max_prediction);
+  return value_[channel] +
+         velocity_[channel] * absl::ToDoubleSeconds(ahead);
+}
+
+void AxisSmoother::Reset() { std::fill(primed_.begin(), primed_.end(), 0); }
+
+int AxisSmoother::Channel(std::uint16_t code, int slot) const {
+  if (code >= ABS_CNT || first_channel_[code] < 0) {
+    return -1;
+  }
+  if (!IsMultiTouch(code)) {
+    return first_channel_[code];
+  }
+  if (slot < 0 || static_cast<std::size_t>(slot) >= slot_count_) {
+    return -1;
+  }
+  return first_channel_[code] + slot;
+}
+
+void AxisSmoother::EndFrame(std::int64_t time_ns) {
+  for (const int channel : dirty_) {
+    Update(channel, measurement_[channel], time_ns);
+    measured_[channel] = 0;
+  }
+  dirty_.clear();
+  for (const auto& [index, channel] : patches_) {
+    frame_[index].value =
+        static_cast<std::int32_t>(std::lround(value_[channel]));
+  }
+  patches_.clear();
+}
+
+void AxisSmoother::Update(int channel, double measurement,
+                          std::int64_t time_ns) {
+  const Params& params = params_[channel];
+  double& value = value_[channel];
+  double& velocity = velocity_[channel];
+  if (primed_[channel] == 0) {
+    value = measurement;
+    velocity = 0.0;
+    p00_[channel] = params.measurement_noise;
+    p01_[channel] = 0.0;
+    // The velocity variance after a second of acceleration noise.
+    p11_[channel] = params.process_noise;
+    time_ns_[channel] = time_ns;
+    primed_[channel] = 1;
+    return;
+  }
+  const double dt = std::max(
+      static_cast<double>(time_ns - time_ns_[channel]) * 1.0e-9, kMinDt);
+  time_ns_[channel] = std::max(time_ns, time_ns_[channel]);
+
+  switch (params.kind) {
+    case Kind::kOneEuro: {
+      const double speed = (measurement - value) / dt;
+      velocity += Alpha(params.derivative_cutoff_hz, dt) * (speed - velocity);
+      const double cutoff =
+          params.min_cutoff_hz + params.beta * std::fabs(velocity);
+      value += Alpha(cutoff, dt) * (measurement - value);
+      break;
+    }
+    case Kind::kEma: {
+      const double alpha = 1.0 - std::exp(-dt / params.time_constant);
+      const double step = alpha * (measurement - value);
+      velocity += alpha * (step / dt - velocity);
+      value += step;
+      break;
+    }
+    case Kind::kKalman: {
+      double& p00 = p00_[channel];
+      double& p01 = p01_[channel];
+      double& p11 = p11_[channel];
+      // Predict, with white noise acceleration.
+      const double q = params.process_noise;
+      value += velocity * dt;
+      p00 += dt * (2.0 * p01 + dt * p11) + q * dt * dt * dt / 3.0;
+      p01 += dt * p11 + q * dt * dt / 2.0;
+      p11 += q * dt;
+      // Correct with the measurement.
+      const double s = p00 + params.measurement_noise;
+      const double k0 = p00 / s;
+      const double k1 = p01 / s;
+      const double innovation = measurement - value;
+      value += k0 * innovation;
+      velocity += k1 * innovation;
+      p11 -= k1 * p01;
+      p00 *= 1.0 - k0;
+      p01 *= 1.0 - k0;
+      break;
+    }
+  }
+}
+
+}  // namespace evdevpp
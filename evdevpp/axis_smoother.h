@@ -0,0 +1,153 @@
+#ifndef EVDEVPP_EVDEVPP_AXIS_SMOOTHER_H_
+#define EVDEVPP_EVDEVPP_AXIS_SMOOTHER_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/statusor.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "evdevpp/info.h"
+#include "linux/input.h"
+
+namespace evdevpp {
+
+// Smooths jittery absolute axes (e.g., of a stylus or head tracker), per
+// axis and, for multi-touch axes, per slot.
+//
+// Events are buffered until their `SYN_REPORT`, then the filter of each
+// axis measured in the frame is updated once, with the time of the frame,
+// and the frame is output with the filtered values. Other events pass
+// through unchanged. The state of the filters is kept in flat arrays, one
+// entry per channel (an axis, or a slot of a multi-touch axis).
+//
+// The filters are:
+//  - One-Euro: a low-pass filter whose cutoff rises with the speed, so that
+//    slow motions are smooth and fast ones have little lag.
+//  - EMA: an exponential moving average, with a fixed time constant.
+//  - Kalman: a constant-velocity Kalman filter.
+//
+// Each filter also estimates the velocity of its axis, which `Predict` uses
+// to extrapolate the value to a later time, e.g., the next vsync of a
+// display, to hide some of the latency of the pipeline.
+//
+//   AxisSmoother::Options options;
+//   options.axes[ABS_X] = {.kind = AxisSmoother::Kind::kOneEuro,
+//                          .beta = 0.01};
+//   options.axes[ABS_Y] = options.axes[ABS_X];
+//   auto smoother_or = AxisSmoother::Create(pen.Capabilities(), options);
+//   ... for each batch of events:
+//   smoother_or->Process(events, &smoothed);
+//   ... at each frame of the display:
+//   auto x = smoother_or->Predict(ABS_X, 0, next_vsync);
+//
+// A new contact in a slot (an `ABS_MT_TRACKING_ID` event) and
+// `SYN_DROPPED` reset the filters. Not thread-safe.
+class AxisSmoother {
+ public:
+  enum class Kind : std::uint8_t { kOneEuro, kEma, kKalman };
+
+  struct AxisConfig {
+    Kind kind = Kind::kOneEuro;
+    // One-Euro: the cutoff frequency at rest, its increase per unit/s of
+    // speed, and the cutoff frequency of the speed estimate.
+    double min_cutoff_hz = 1.0;
+    double beta = 0.0;
+    double derivative_cutoff_hz = 1.0;
+    // EMA: the time constant of the average (and of the velocity estimate).
+    absl::Duration time_constant = absl::Milliseconds(8);
+    // Kalman: the spectral density of the acceleration noise (units^2/s^3),
+    // and the variance of the measurements (units^2), by default the square
+    // of the `fuzz` of the axis (at least 1).
+    double process_noise = 1.0e6;
+    std::optional<double> measurement_noise;
+  };
+
+  struct Options {
+    // The axes to smooth, by `ABS_*` code. The other axes pass through.
+    absl::flat_hash_map<std::uint16_t, AxisConfig> axes;
+    // How far `Predict` may extrapolate past the last frame of an axis.
+    absl::Duration max_prediction = absl::Milliseconds(50);
+  };
+  // Work-around for GCC/Clang bug.
+  static Options Defaults() { return Options{}; }
+
+  // Smooth the axes of `options` among the absolute axes of `capabilities`.
+  static absl::StatusOr<AxisSmoother> Create(
+      const CapabilitiesInfo& capabilities,
+      const Options& options = Defaults());
+
+  // Process `events`, and append each completed frame (up to and including
+  // its `SYN_REPORT`), with smoothed values, to `out`. Returns the number
+  // of events appended.
+  std::size_t Process(absl::Span<const input_event> events,
+                      std::vector<input_event>* out);
+
+  // The smoothed value of axis `code` (at `slot`, for multi-touch axes), if
+  // it is smoothed and was measured since the last reset.
+  [[nodiscard]] std::optional<double> Value(std::uint16_t code,
+                                            int slot = 0) const;
+  // The smoothed value extrapolated to `at` with the estimated velocity.
+  [[nodiscard]] std::optional<double> Predict(std::uint16_t code, int slot,
+                                              absl::Time at) const;
+
+  // Forget the state of all the filters.
+  void Reset();
+
+ private:
+  static constexpr std::size_t kMaxSlots = 64;
+
+  // An `AxisConfig`, with the durations in seconds.
+  struct Params {
+    Kind kind = Kind::kOneEuro;
+    double min_cutoff_hz = 0.0;
+    double beta = 0.0;
+    double derivative_cutoff_hz = 0.0;
+    double time_constant = 0.0;
+    double process_noise = 0.0;
+    double measurement_noise = 0.0;
+  };
+
+  // Index of the channel of `code` at `slot`, -1 if not smoothed.
+  [[nodiscard]] int Channel(std::uint16_t code, int slot) const;
+  // Update the filter of `channel` with `measurement` at `time_ns`.
+  void Update(int channel, double measurement, std::int64_t time_ns);
+  // Update the filters measured in the pending frame, at `time_ns`.
+  void EndFrame(std::int64_t time_ns);
+
+  Options options_;
+  std::size_t slot_count_ = 1;
+  // For each `ABS_*` code: the first channel, -1 if not smoothed.
+  std::array<std::int32_t, ABS_CNT> first_channel_{};
+  // Per channel.
+  std::vector<Params> params_;
+  std::vector<double> value_;
+  std::vector<double> velocity_;
+  // Kalman covariance.
+  std::vector<double> p00_;
+  std::vector<double> p01_;
+  std::vector<double> p11_;
+  // Time of the last update, and whether there was one since the last
+  // reset.
+  std::vector<std::int64_t> time_ns_;
+  std::vector<std::uint8_t> primed_;
+  // Last measurement of the pending frame, and whether there is one.
+  std::vector<double> measurement_;
+  std::vector<std::uint8_t> measured_;
+
+  // The pending frame, its measured channels, and the events to patch with
+  // the smoothed value of a channel.
+  std::vector<input_event> frame_;
+  std::vector<int> dirty_;
+  std::vector<std::pair<std::size_t, int>> patches_;
+  int slot_ = 0;
+};
+
+}  // namespace evdevpp
+
+#endif  // EVDEVPP_EVDEVPP_AXIS_SMOOTHER_H_
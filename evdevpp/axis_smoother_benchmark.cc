@@ -0,0 +1,100 @@
+// Cost of AxisSmoother::Process per frame, for each kind of filter, on a
+// pen frame (X, Y and pressure) and on a multi-touch frame (10 contacts).
+// Items are frames.
+//
+//   bazel run -c opt //evdevpp:axis_smoother_benchmark
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "evdevpp/axis_smoother.h"
+#include "evdevpp/info.h"
+#include "linux/input.h"
+
+namespace evdevpp {
+namespace {
+
+constexpr int kContacts = 10;
+
+input_event Event(std::uint16_t type, std::uint16_t code, std::int32_t value) {
+  input_event event{};
+  event.type = type;
+  event.code = code;
+  event.value = value;
+  return event;
+}
+
+const char* KindName(AxisSmoother::Kind kind) {
+  switch (kind) {
+    case AxisSmoother::Kind::kOneEuro:
+      return "OneEuro";
+    case AxisSmoother::Kind::kEma:
+      return "Ema";
+    case AxisSmoother::Kind::kKalman:
+      return "Kalman";
+  }
+  return "";
+}
+
+AxisSmoother Smoother(AxisSmoother::Kind kind) {
+  CapabilitiesInfo capabilities;
+  capabilities.absolute_axes[ABS_X] = AbsInfo{.maximum = 30000, .fuzz = 4};
+  capabilities.absolute_axes[ABS_Y] = AbsInfo{.maximum = 30000, .fuzz = 4};
+  capabilities.absolute_axes[ABS_PRESSURE] = AbsInfo{.maximum = 4096};
+  capabilities.absolute_axes[ABS_MT_SLOT] =
+      AbsInfo{.maximum = kContacts - 1};
+  capabilities.absolute_axes[ABS_MT_POSITION_X] = AbsInfo{.maximum = 30000};
+  capabilities.absolute_axes[ABS_MT_POSITION_Y] = AbsInfo{.maximum = 30000};
+  AxisSmoother::Options options;
+  for (std::uint16_t code : {ABS_X, ABS_Y, ABS_PRESSURE, ABS_MT_POSITION_X,
+                             ABS_MT_POSITION_Y}) {
+    options.axes[code] = {.kind = kind, .beta = 0.05};
+  }
+  return *AxisSmoother::Create(capabilities, options);
+}
+
+// Process `frame` at 1 kHz, moving the axes at each frame.
+void ProcessLoop(benchmark::State& state, std::vector<input_event> frame) {
+  const auto kind = static_cast<AxisSmoother::Kind>(state.range(0));
+  AxisSmoother smoother = Smoother(kind);
+  std::vector<input_event> out;
+  std::int64_t time_us = 1000000;
+  for (auto _ : state) {
+    time_us += 1000;
+    for (input_event& event : frame) {
+      event.input_event_sec = time_us / 1000000;
+      event.input_event_usec = time_us % 1000000;
+      if (event.type == EV_ABS && event.code != ABS_MT_SLOT) {
+        event.value += (time_us / 1000) % 2 == 0 ? 3 : -2;
+      }
+    }
+    out.clear();
+    benchmark::DoNotOptimize(smoother.Process(frame, &out));
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetLabel(KindName(kind));
+}
+
+void BM_SmoothPen(benchmark::State& state) {
+  ProcessLoop(state, {Event(EV_ABS, ABS_X, 10000), Event(EV_ABS, ABS_Y, 5000),
+                      Event(EV_ABS, ABS_PRESSURE, 1000),
+                      Event(EV_SYN, SYN_REPORT, 0)});
+}
+BENCHMARK(BM_SmoothPen)->DenseRange(0, 2);
+
+void BM_SmoothTouch(benchmark::State& state) {
+  std::vector<input_event> frame;
+  for (int slot = 0; slot < kContacts; ++slot) {
+    frame.push_back(Event(EV_ABS, ABS_MT_SLOT, slot));
+    frame.push_back(Event(EV_ABS, ABS_MT_POSITION_X, 1000 * slot));
+    frame.push_back(Event(EV_ABS, ABS_MT_POSITION_Y, 2000 * slot));
+  }
+  frame.push_back(Event(EV_SYN, SYN_REPORT, 0));
+  ProcessLoop(state, std::move(frame));
+}
+BENCHMARK(BM_SmoothTouch)->DenseRange(0, 2);
+
+}  // namespace
+}  // namespace evdevpp
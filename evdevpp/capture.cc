@@ -0,0 +1,744 @@
+#include "evdevpp/capture.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "evdevpp/capture_codec.h"
+#include "fmt/format.h"
+#include "toolbelt/fd.h"
+
+namespace evdevpp {
+
+namespace {
+
+// On-disk layout. See capture.h for the overall structure.
+constexpr std::array<char, 8> kFileMagic = {'E', 'V', 'D', 'P',
+                                            'C', 'A', 'P', '\0'};
+// Version 2 added the input properties of the devices.
+constexpr std::uint32_t kFileVersion = 2;
+constexpr std::uint32_t kOldestFileVersion = 1;
+constexpr std::uint32_t kChunkMagic = 0x4B4E4843;  // "CHNK"
+constexpr auto kRawEncoding =
+    static_cast<std::uint32_t>(CaptureEncoding::kRaw);
+
+struct FileHeader {
+  std::array<char, 8> magic = kFileMagic;
+  std::uint32_t version = kFileVersion;
+  // Size of this header plus the device table, i.e., offset of first chunk.
+  std::uint32_t header_size = 0;
+  std::uint32_t device_count = 0;
+  std::uint32_t reserved = 0;
+  // Offset of the chunk index, zero if the file was not closed properly.
+  std::uint64_t index_offset = 0;
+  std::uint64_t chunk_count = 0;
+  std::uint64_t record_count = 0;
+};
+static_assert(sizeof(FileHeader) == 48);
+
+struct ChunkHeader {
+  std::uint32_t magic = kChunkMagic;
+  std::uint32_t record_count = 0;
+  std::uint32_t encoding = kRawEncoding;
+  std::uint32_t reserved = 0;
+  std::uint64_t payload_size = 0;
+  // Time range of the records, which are in the order they were appended
+  // (not necessarily by time, e.g., for several devices).
+  std::int64_t min_time_us = 0;
+  std::int64_t max_time_us = 0;
+};
+static_assert(sizeof(ChunkHeader) == 40);
+
+struct IndexEntry {
+  std::uint64_t offset = 0;
+  std::uint64_t payload_size = 0;
+  std::uint32_t record_count = 0;
+  std::uint32_t encoding = kRawEncoding;
+  std::int64_t min_time_us = 0;
+  std::int64_t max_time_us = 0;
+};
+static_assert(sizeof(IndexEntry) == 40);
+
+// Everything in the file is 8-byte aligned, so that records can be used in
+// place from the memory mapping.
+constexpr std::uint64_t kAlignment = 8;
+constexpr std::uint64_t AlignUp(std::uint64_t n) {
+  return (n + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+class ByteWriter {
+ public:
+  template <typename T>
+  void Put(const T& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    out_.append(reinterpret_cast<const char*>(&value),  // NOLINT
+                sizeof(T));
+  }
+  void PutString(const std::string& str) {
+    Put(static_cast<std::uint32_t>(str.size()));
+    out_.append(str);
+  }
+  template <typename CodeSet>
+  void PutCodes(const CodeSet& codes) {
+    std::vector<std::uint16_t> sorted(codes.begin(), codes.end());
+    std::sort(sorted.begin(), sorted.end());
+    Put(static_cast<std::uint32_t>(sorted.size()));
+    for (auto code : sorted) {
+      Put(code);
+    }
+  }
+  void Pad() { out_.resize(AlignUp(out_.size()), '\0'); }
+  std::string& Bytes() { return out_; }
+
+ private:
+  std::string out_;
+};
+
+class ByteReader {
+ public:
+  ByteReader(const std::uint8_t* data, std::size_t size)
+      : data_(data), size_(size) {}
+
+  template <typename T>
+  bool Get(T& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    if (size_ - pos_ < sizeof(T)) {
+      return false;
+    }
+    std::memcpy(&value, data_ + pos_, sizeof(T));
+    pos_ += sizeof(T);
+    return true;
+  }
+  bool GetString(std::string& str) {
+    std::uint32_t len = 0;
+    if (!Get(len) || size_ - pos_ < len) {
+      return false;
+    }
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    str.assign(reinterpret_cast<const char*>(data_ + pos_), len);
+    pos_ += len;
+    return true;
+  }
+  bool GetCodes(absl::flat_hash_set<std::uint16_t>& codes) {
+    std::uint32_t count = 0;
+    if (!Get(count) || (size_ - pos_) / sizeof(std::uint16_t) < count) {
+      return false;
+    }
+    codes.reserve(count);
+    for (std::uint32_t i = 0; i < count; ++i) {
+      std::uint16_t code = 0;
+      (void)Get(code);
+      codes.insert(code);
+    }
+    return true;
+  }
+
+ private:
+  const std::uint8_t* data_;
+  std::size_t size_;
+  std::size_t pos_ = 0;
+};
+
+void PutDevice(ByteWriter& out, const CaptureDeviceInfo& dev) {
+  out.Put(dev.info.bustype);
+  out.Put(dev.info.vendor);
+  out.Put(dev.info.product);
+  out.Put(dev.info.version);
+  out.PutString(dev.name);
+  out.PutString(dev.phys);
+  out.PutString(dev.uniq);
+  const CapabilitiesInfo& caps = dev.capabilities;
+  out.PutCodes(caps.keys);
+  out.PutCodes(caps.synchs);
+  out.PutCodes(caps.relative_axes);
+  std::vector<std::pair<std::uint16_t, AbsInfo>> abs_axes(
+      caps.absolute_axes.begin(), caps.absolute_axes.end());
+  std::sort(abs_axes.begin(), abs_axes.end(),
+            [](const auto& lhs, const auto& rhs) {
+              return lhs.first < rhs.first;
+            });
+  out.Put(static_cast<std::uint32_t>(abs_axes.size()));
+  for (const auto& [code, absinfo] : abs_axes) {
+    out.Put(code);
+    out.Put(absinfo);
+  }
+  out.PutCodes(caps.miscs);
+  out.PutCodes(caps.switches);
+  out.PutCodes(caps.leds);
+  out.PutCodes(caps.sounds);
+  out.PutCodes(caps.autorepeats);
+  out.PutCodes(caps.force_feedbacks);
+  out.PutCodes(caps.uinputs);
+  out.PutCodes(dev.input_props);
+}
+
+bool GetDevice(ByteReader& in, std::uint32_t version, CaptureDeviceInfo& dev) {
+  CapabilitiesInfo& caps = dev.capabilities;
+  if (!in.Get(dev.info.bustype) || !in.Get(dev.info.vendor) ||
+      !in.Get(dev.info.product) || !in.Get(dev.info.version) ||
+      !in.GetString(dev.name) || !in.GetString(dev.phys) ||
+      !in.GetString(dev.uniq) || !in.GetCodes(caps.keys) ||
+      !in.GetCodes(caps.synchs) || !in.GetCodes(caps.relative_axes)) {
+    return false;
+  }
+  std::uint32_t abs_count = 0;
+  if (!in.Get(abs_count)) {
+    return false;
+  }
+  for (std::uint32_t i = 0; i < abs_count; ++i) {
+    std::uint16_t code = 0;
+    AbsInfo absinfo{};
+    if (!in.Get(code) || !in.Get(absinfo)) {
+      return false;
+    }
+    caps.absolute_axes.emplace(code, absinfo);
+  }
+  if (!in.GetCodes(caps.miscs) || !in.GetCodes(caps.switches) ||
+      !in.GetCodes(caps.leds) || !in.GetCodes(caps.sounds) ||
+      !in.GetCodes(caps.autorepeats) || !in.GetCodes(caps.force_feedbacks) ||
+      !in.GetCodes(caps.uinputs)) {
+    return false;
+  }
+  if (version < 2) {
+    return true;
+  }
+  absl::flat_hash_set<std::uint16_t> props;
+  if (!in.GetCodes(props)) {
+    return false;
+  }
+  dev.input_props.assign(props.begin(), props.end());
+  std::sort(dev.input_props.begin(), dev.input_props.end());
+  return true;
+}
+
+absl::Status WriteFully(int fd, const void* data, std::size_t size) {
+  const auto* bytes = static_cast<const char*>(data);
+  while (size > 0) {
+    auto written = ::write(fd, bytes, size);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return absl::ErrnoToStatus(errno, "Writing capture file failed");
+    }
+    bytes += written;
+    size -= static_cast<std::size_t>(written);
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+absl::StatusOr<CaptureDeviceInfo> CaptureDeviceInfo::FromDevice(
+    const InputDevice& device) {
+  auto props_or = device.Properties();
+  if (!props_or.ok()) {
+    return props_or.status();
+  }
+  CaptureDeviceInfo result{.info = device.Info(),
+                           .name = device.Name(),
+                           .phys = device.Phys(),
+                           .uniq = device.Uniq(),
+                           .capabilities = device.Capabilities(),
+                           .input_props = {props_or->begin(),
+                                           props_or->end()}};
+  std::sort(result.input_props.begin(), result.input_props.end());
+  return result;
+}
+
+struct CaptureWriter::Shared {
+  toolbelt::FileDescriptor fd;
+  FileHeader header;
+  CaptureEncoding encoding = CaptureEncoding::kDelta;
+  absl::Mutex mu;
+  std::deque<std::vector<CaptureRecord>> pending ABSL_GUARDED_BY(mu);
+  std::vector<std::vector<CaptureRecord>> free_buffers ABSL_GUARDED_BY(mu);
+  bool closing ABSL_GUARDED_BY(mu) = false;
+  std::atomic<std::uint64_t> bytes_written{0};
+  // Only used by the writer thread, then by `Close` after joining it.
+  std::uint64_t offset = 0;
+  std::vector<IndexEntry> index;
+  std::string encoded;
+  absl::Status status;
+};
+
+absl::StatusOr<CaptureWriter> CaptureWriter::Create(
+    const std::string& path, const std::vector<CaptureDeviceInfo>& devices,
+    const Options& options) {
+  if (devices.size() > std::numeric_limits<std::uint16_t>::max()) {
+    return absl::InvalidArgumentError("Too many devices for a capture file");
+  }
+  int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                  0644);
+  if (fd < 0) {
+    return absl::ErrnoToStatus(
+        errno, fmt::format("Creating capture file '{}' failed", path));
+  }
+
+  ByteWriter header;
+  header.Put(FileHeader{});
+  for (const auto& dev : devices) {
+    PutDevice(header, dev);
+  }
+  header.Pad();
+  FileHeader file_header{};
+  file_header.header_size = static_cast<std::uint32_t>(header.Bytes().size());
+  file_header.device_count = static_cast<std::uint32_t>(devices.size());
+  std::memcpy(header.Bytes().data(), &file_header, sizeof(file_header));
+
+  CaptureWriter result;
+  result.options_ = options;
+  result.options_.records_per_chunk =
+      std::max<std::size_t>(result.options_.records_per_chunk, 1);
+  result.shared_ = std::make_unique<Shared>();
+  result.shared_->fd = toolbelt::FileDescriptor(fd);
+  result.shared_->header = file_header;
+  result.shared_->encoding = options.encoding;
+  if (auto st = WriteFully(fd, header.Bytes().data(), header.Bytes().size());
+      !st.ok()) {
+    return st;
+  }
+  result.shared_->offset = header.Bytes().size();
+  result.shared_->bytes_written = header.Bytes().size();
+  result.current_.reserve(result.options_.records_per_chunk);
+  result.thread_ =
+      std::thread(&CaptureWriter::WriterLoop, result.shared_.get());
+  return result;
+}
+
+CaptureWriter::CaptureWriter(CaptureWriter&& rhs) noexcept
+    : options_(rhs.options_),
+      current_(std::move(rhs.current_)),
+      record_count_(rhs.record_count_),
+      shared_(std::move(rhs.shared_)),
+      thread_(std::move(rhs.thread_)) {}
+
+CaptureWriter& CaptureWriter::operator=(CaptureWriter&& rhs) noexcept {
+  if (this != &rhs) {
+    (void)Close();
+    options_ = rhs.options_;
+    current_ = std::move(rhs.current_);
+    record_count_ = rhs.record_count_;
+    shared_ = std::move(rhs.shared_);
+    thread_ = std::move(rhs.thread_);
+  }
+  return *this;
+}
+
+CaptureWriter::~CaptureWriter() { (void)Close(); }
+
+void CaptureWriter::Append(const CaptureRecord& record) {
+  if (!thread_.joinable()) {
+    return;
+  }
+  if (!current_.empty() &&
+      absl::Microseconds(record.time_us - current_.front().time_us) >
+          options_.max_chunk_duration) {
+    Flush();
+  }
+  current_.push_back(record);
+  ++record_count_;
+  if (current_.size() >= options_.records_per_chunk) {
+    Flush();
+  }
+}
+
+void CaptureWriter::Flush() {
+  if (!thread_.joinable() || current_.empty()) {
+    return;
+  }
+  absl::MutexLock lock(&shared_->mu);
+  shared_->pending.push_back(std::move(current_));
+  if (!shared_->free_buffers.empty()) {
+    current_ = std::move(shared_->free_buffers.back());
+    shared_->free_buffers.pop_back();
+  } else {
+    current_ = {};
+    current_.reserve(options_.records_per_chunk);
+  }
+}
+
+void CaptureWriter::WriterLoop(Shared* shared) {
+  while (true) {
+    std::vector<CaptureRecord> chunk;
+    {
+      absl::MutexLock lock(&shared->mu);
+      shared->mu.Await(absl::Condition(
+          +[](Shared* s) ABSL_EXCLUSIVE_LOCKS_REQUIRED(s->mu) {
+            return !s->pending.empty() || s->closing;
+          },
+          shared));
+      if (shared->pending.empty()) {
+        return;
+      }
+      chunk = std::move(shared->pending.front());
+      shared->pending.pop_front();
+    }
+
+    if (shared->status.ok()) {
+      shared->status = WriteChunk(shared, chunk);
+    }
+
+    chunk.clear();
+    absl::MutexLock lock(&shared->mu);
+    shared->free_buffers.push_back(std::move(chunk));
+  }
+}
+
+absl::Status CaptureWriter::WriteChunk(
+    Shared* shared, const std::vector<CaptureRecord>& chunk) {
+  ChunkHeader chunk_header{};
+  chunk_header.record_count = static_cast<std::uint32_t>(chunk.size());
+  chunk_header.encoding = static_cast<std::uint32_t>(shared->encoding);
+  const auto [min_it, max_it] = std::minmax_element(
+      chunk.begin(), chunk.end(),
+      [](const CaptureRecord& lhs, const CaptureRecord& rhs) {
+        return lhs.time_us < rhs.time_us;
+      });
+  chunk_header.min_time_us = min_it->time_us;
+  chunk_header.max_time_us = max_it->time_us;
+  const void* payload = chunk.data();
+  if (shared->encoding == CaptureEncoding::kDelta) {
+    shared->encoded.clear();
+    EncodeCaptureBlock(chunk, &shared->encoded);
+    chunk_header.payload_size = shared->encoded.size();
+    // Keep the next chunk aligned.
+    shared->encoded.resize(AlignUp(shared->encoded.size()), '\0');
+    payload = shared->encoded.data();
+  } else {
+    chunk_header.payload_size = chunk.size() * sizeof(CaptureRecord);
+  }
+  const std::uint64_t padded_size = AlignUp(chunk_header.payload_size);
+
+  if (auto st = WriteFully(shared->fd.Fd(), &chunk_header,
+                           sizeof(chunk_header));
+      !st.ok()) {
+    return st;
+  }
+  if (auto st = WriteFully(shared->fd.Fd(), payload, padded_size); !st.ok()) {
+    return st;
+  }
+  shared->index.push_back({.offset = shared->offset,
+                           .payload_size = chunk_header.payload_size,
+                           .record_count = chunk_header.record_count,
+                           .encoding = chunk_header.encoding,
+                           .min_time_us = chunk_header.min_time_us,
+                           .max_time_us = chunk_header.max_time_us});
+  shared->offset += sizeof(chunk_header) + padded_size;
+  shared->bytes_written += sizeof(chunk_header) + padded_size;
+  return absl::OkStatus();
+}
+
+absl::Status CaptureWriter::Close() {
+  if (!thread_.joinable()) {
+    return absl::OkStatus();
+  }
+  Flush();
+  {
+    absl::MutexLock lock(&shared_->mu);
+    shared_->closing = true;
+  }
+  thread_.join();
+
+  // Keep the shared state around, for `BytesWritten`.
+  Shared* shared = shared_.get();
+  absl::Status status = shared->status;
+  if (status.ok()) {
+    std::size_t index_size = shared->index.size() * sizeof(IndexEntry);
+    status = WriteFully(shared->fd.Fd(), shared->index.data(), index_size);
+    shared->bytes_written += index_size;
+  }
+  if (status.ok()) {
+    FileHeader& file_header = shared->header;
+    file_header.index_offset = shared->offset;
+    file_header.chunk_count = shared->index.size();
+    file_header.record_count = record_count_;
+    if (::pwrite(shared->fd.Fd(), &file_header, sizeof(file_header), 0) !=
+        sizeof(file_header)) {
+      status = absl::ErrnoToStatus(errno, "Writing capture header failed");
+    }
+  }
+  shared->fd.Close();
+  return status;
+}
+
+std::uint64_t CaptureWriter::BytesWritten() const {
+  return (shared_ == nullptr ? 0 : shared_->bytes_written.load());
+}
+
+absl::StatusOr<CaptureReader> CaptureReader::Open(const std::string& path) {
+  toolbelt::FileDescriptor fd(::open(path.c_str(), O_RDONLY | O_CLOEXEC));
+  if (!fd.IsOpen()) {
+    return absl::ErrnoToStatus(
+        errno, fmt::format("Opening capture file '{}' failed", path));
+  }
+  struct stat file_stat {};
+  if (::fstat(fd.Fd(), &file_stat) < 0) {
+    return absl::ErrnoToStatus(errno, "Querying capture file size failed");
+  }
+
+  CaptureReader result;
+  result.size_ = static_cast<std::size_t>(file_stat.st_size);
+  if (result.size_ < sizeof(FileHeader)) {
+    return absl::DataLossError(
+        fmt::format("Capture file '{}' is too short", path));
+  }
+  void* mapping =
+      ::mmap(nullptr, result.size_, PROT_READ, MAP_SHARED, fd.Fd(), 0);
+  if (mapping == MAP_FAILED) {
+    result.size_ = 0;
+    return absl::ErrnoToStatus(errno, "Mapping capture file failed");
+  }
+  result.data_ = static_cast<const std::uint8_t*>(mapping);
+  // Records are read front to back, tell the kernel to read ahead.
+  (void)::madvise(mapping, result.size_, MADV_SEQUENTIAL);
+
+  if (auto st = result.ParseHeader(); !st.ok()) {
+    return st;
+  }
+  return result;
+}
+
+CaptureReader::CaptureReader(CaptureReader&& rhs) noexcept
+    : data_(std::exchange(rhs.data_, nullptr)),
+      size_(std::exchange(rhs.size_, 0)),
+      devices_(std::move(rhs.devices_)),
+      chunks_(std::move(rhs.chunks_)),
+      reach_time_us_(std::move(rhs.reach_time_us_)),
+      start_time_us_(rhs.start_time_us_),
+      record_count_(rhs.record_count_) {}
+
+CaptureReader& CaptureReader::operator=(CaptureReader&& rhs) noexcept {
+  if (this != &rhs) {
+    CaptureReader tmp{std::move(*this)};
+    data_ = std::exchange(rhs.data_, nullptr);
+    size_ = std::exchange(rhs.size_, 0);
+    devices_ = std::move(rhs.devices_);
+    chunks_ = std::move(rhs.chunks_);
+    reach_time_us_ = std::move(rhs.reach_time_us_);
+    start_time_us_ = rhs.start_time_us_;
+    record_count_ = rhs.record_count_;
+  }
+  return *this;
+}
+
+CaptureReader::~CaptureReader() {
+  if (data_ != nullptr) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast) POSIX API
+    ::munmap(const_cast<std::uint8_t*>(data_), size_);
+  }
+}
+
+absl::Status CaptureReader::ParseHeader() {
+  FileHeader file_header{};
+  std::memcpy(&file_header, data_, sizeof(file_header));
+  if (file_header.magic != kFileMagic) {
+    return absl::DataLossError("Not a capture file");
+  }
+  if (file_header.version < kOldestFileVersion ||
+      file_header.version > kFileVersion) {
+    return absl::UnimplementedError(fmt::format(
+        "Unsupported capture file version {}", file_header.version));
+  }
+  if (file_header.header_size < sizeof(FileHeader) ||
+      file_header.header_size > size_ ||
+      file_header.header_size % kAlignment != 0) {
+    return absl::DataLossError("Corrupted capture file header");
+  }
+
+  ByteReader in(data_ + sizeof(FileHeader),
+                file_header.header_size - sizeof(FileHeader));
+  devices_.resize(file_header.device_count);
+  for (auto& dev : devices_) {
+    if (!GetDevice(in, file_header.version, dev)) {
+      return absl::DataLossError("Corrupted capture file device table");
+    }
+  }
+
+  if (file_header.index_offset != 0) {
+    return LoadIndex(file_header.index_offset, file_header.chunk_count);
+  }
+  // The writer did not finish, recover what was written.
+  return ScanChunks(file_header.header_size);
+}
+
+absl::Status CaptureReader::LoadIndex(std::uint64_t index_offset,
+                                      std::uint64_t count) {
+  if (index_offset > size_ ||
+      (size_ - index_offset) / sizeof(IndexEntry) < count) {
+    return absl::DataLossError("Corrupted capture file index");
+  }
+  chunks_.reserve(count);
+  reach_time_us_.reserve(count);
+  for (std::uint64_t i = 0; i < count; ++i) {
+    IndexEntry entry{};
+    std::memcpy(&entry, data_ + index_offset + i * sizeof(IndexEntry),
+                sizeof(entry));
+    if (entry.offset % kAlignment != 0 || entry.offset > index_offset ||
+        index_offset - entry.offset < sizeof(ChunkHeader) ||
+        index_offset - entry.offset - sizeof(ChunkHeader) <
+            entry.payload_size) {
+      return absl::DataLossError("Corrupted capture file index entry");
+    }
+    AddChunk({.offset = entry.offset,
+              .payload_size = entry.payload_size,
+              .record_count = entry.record_count,
+              .encoding = entry.encoding,
+              .min_time_us = entry.min_time_us,
+              .max_time_us = entry.max_time_us});
+  }
+  return absl::OkStatus();
+}
+
+absl::Status CaptureReader::ScanChunks(std::uint64_t first_chunk_offset) {
+  std::uint64_t offset = first_chunk_offset;
+  while (offset <= size_ && size_ - offset >= sizeof(ChunkHeader)) {
+    ChunkHeader chunk_header{};
+    std::memcpy(&chunk_header, data_ + offset, sizeof(chunk_header));
+    if (chunk_header.magic != kChunkMagic ||
+        size_ - offset - sizeof(ChunkHeader) < chunk_header.payload_size) {
+      // A torn write at the end of the file, keep what is complete.
+      break;
+    }
+    AddChunk({.offset = offset,
+              .payload_size = chunk_header.payload_size,
+              .record_count = chunk_header.record_count,
+              .encoding = chunk_header.encoding,
+              .min_time_us = chunk_header.min_time_us,
+              .max_time_us = chunk_header.max_time_us});
+    const std::uint64_t next =
+        offset + AlignUp(sizeof(ChunkHeader) + chunk_header.payload_size);
+    if (next > size_) {
+      // The file ends in the padding of the last chunk.
+      break;
+    }
+    offset = next;
+  }
+  return absl::OkStatus();
+}
+
+void CaptureReader::AddChunk(const ChunkInfo& chunk) {
+  if (chunks_.empty()) {
+    start_time_us_ = chunk.min_time_us;
+    reach_time_us_.push_back(chunk.max_time_us);
+  } else {
+    start_time_us_ = std::min(start_time_us_, chunk.min_time_us);
+    reach_time_us_.push_back(
+        std::max(reach_time_us_.back(), chunk.max_time_us));
+  }
+  chunks_.push_back(chunk);
+  record_count_ += chunk.record_count;
+}
+
+absl::Time CaptureReader::StartTime() const {
+  if (chunks_.empty()) {
+    return absl::InfinitePast();
+  }
+  return absl::FromUnixMicros(start_time_us_);
+}
+
+absl::Time CaptureReader::EndTime() const {
+  if (chunks_.empty()) {
+    return absl::InfinitePast();
+  }
+  return absl::FromUnixMicros(reach_time_us_.back());
+}
+
+absl::StatusOr<absl::Span<const CaptureRecord>> CaptureReader::ChunkRecords(
+    std::size_t index, std::vector<CaptureRecord>* scratch) const {
+  if (index >= chunks_.size()) {
+    return absl::OutOfRangeError("No such capture chunk");
+  }
+  const ChunkInfo& chunk = chunks_[index];
+  const std::uint8_t* payload = data_ + chunk.offset + sizeof(ChunkHeader);
+  switch (static_cast<CaptureEncoding>(chunk.encoding)) {
+    case CaptureEncoding::kRaw:
+      if (chunk.payload_size != chunk.record_count * sizeof(CaptureRecord)) {
+        return absl::DataLossError("Corrupted capture chunk");
+      }
+      return absl::Span<const CaptureRecord>(
+          // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+          reinterpret_cast<const CaptureRecord*>(payload), chunk.record_count);
+    case CaptureEncoding::kDelta:
+      if (auto st = DecodeCaptureBlock({payload, chunk.payload_size},
+                                       chunk.record_count, scratch);
+          !st.ok()) {
+        return st;
+      }
+      return absl::Span<const CaptureRecord>(*scratch);
+  }
+  return absl::UnimplementedError(
+      fmt::format("Unsupported capture chunk encoding {}", chunk.encoding));
+}
+
+CaptureReader::Cursor::Cursor(const CaptureReader* reader, std::size_t chunk,
+                              std::size_t record)
+    : reader_(reader), chunk_(chunk), record_(record) {
+  LoadChunk();
+}
+
+void CaptureReader::Cursor::LoadChunk() {
+  records_ = {};
+  if (chunk_ >= reader_->ChunkCount()) {
+    return;
+  }
+  auto records_or = reader_->ChunkRecords(chunk_, &scratch_);
+  if (!records_or.ok()) {
+    status_ = records_or.status();
+    chunk_ = reader_->ChunkCount();
+    return;
+  }
+  records_ = *records_or;
+}
+
+const CaptureRecord* CaptureReader::Cursor::Next() {
+  while (record_ >= records_.size()) {
+    if (chunk_ + 1 >= reader_->ChunkCount()) {
+      chunk_ = reader_->ChunkCount();
+      records_ = {};
+      record_ = 0;
+      return nullptr;
+    }
+    ++chunk_;
+    record_ = 0;
+    LoadChunk();
+  }
+  return &records_[record_++];
+}
+
+CaptureReader::Cursor CaptureReader::Seek(absl::Time time) const {
+  const std::int64_t time_us = absl::ToUnixMicros(time);
+  // Records of several devices interleave, so neither the chunks nor their
+  // records are sorted by time. The first chunk that reaches `time` holds
+  // the first record that does, and it is where the running maximum of the
+  // chunk end times first reaches `time`.
+  auto reach_it = std::partition_point(
+      reach_time_us_.begin(), reach_time_us_.end(),
+      [time_us](std::int64_t reach_us) { return reach_us < time_us; });
+  Cursor cursor(this,
+                static_cast<std::size_t>(reach_it - reach_time_us_.begin()),
+                0);
+  auto record_it = std::find_if(cursor.records_.begin(),
+                                cursor.records_.end(),
+                                [time_us](const CaptureRecord& record) {
+                                  return record.time_us >= time_us;
+                                });
+  cursor.record_ =
+      static_cast<std::size_t>(record_it - cursor.records_.begin());
+  return cursor;
+}
+
+}  // namespace evdevpp
@@ -0,0 +1,251 @@
+#ifndef EVDEVPP_EVDEVPP_CAPTURE_H_
+#define EVDEVPP_EVDEVPP_CAPTURE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "evdevpp/device.h"
+#include "evdevpp/events.h"
+#include "evdevpp/info.h"
+
+namespace evdevpp {
+
+// Binary capture files of input events.
+//
+// A capture file holds:
+//
+//  - A header with the identity, capabilities and input properties of every
+//    captured device (`CaptureDeviceInfo`), so that matching devices can be
+//    recreated.
+//  - A sequence of chunks of `CaptureRecord`s, each with a small header
+//    holding the time range it covers. Records are in the order they were
+//    appended, which need not be by time when several devices are captured.
+//  - A chunk index at the end, written when the capture is closed. If the
+//    writer did not get to close the file, the reader rebuilds the index by
+//    walking the chunk headers.
+//
+// All integers are stored in native byte order (little-endian on every
+// platform evdev exists on).
+
+// One recorded event. This is the equivalent of `input_event`, with the
+// timestamp in microseconds since the Unix epoch and the index of the
+// device (in the capture header) that produced it.
+struct CaptureRecord {
+  std::int64_t time_us = 0;
+  std::uint16_t device = 0;
+  std::uint16_t type = 0;
+  std::uint16_t code = 0;
+  std::uint16_t reserved0 = 0;
+  std::int32_t value = 0;
+  std::uint32_t reserved1 = 0;
+
+  static CaptureRecord FromInputEvent(std::uint16_t device,
+                                      const InputEvent& event) {
+    return {.time_us = absl::ToUnixMicros(event.timestamp),
+            .device = device,
+            .type = event.type,
+            .code = event.code,
+            .value = event.value};
+  }
+  [[nodiscard]] absl::Time Timestamp() const {
+    return absl::FromUnixMicros(time_us);
+  }
+  [[nodiscard]] InputEvent ToInputEvent() const {
+    return {Timestamp(), type, code, value};
+  }
+};
+static_assert(sizeof(CaptureRecord) == 24);
+
+// The encoding of the records of a chunk.
+enum class CaptureEncoding : std::uint32_t {
+  // Array of `CaptureRecord`s.
+  kRaw = 0,
+  // Delta and varint compression, see `capture_codec.h`.
+  kDelta = 1,
+};
+
+// The identity and capabilities of a captured device.
+struct CaptureDeviceInfo {
+  DeviceInfo info{};
+  std::string name;
+  std::string phys;
+  std::string uniq;
+  CapabilitiesInfo capabilities;
+  // Input properties and quirks, sorted. Empty in captures written before
+  // they were recorded.
+  std::vector<Property> input_props;
+
+  // Fails only if the input properties cannot be read.
+  static absl::StatusOr<CaptureDeviceInfo> FromDevice(
+      const InputDevice& device);
+};
+
+// Streaming writer of capture files.
+//
+// `Append` only copies the record into the current chunk, chunks are
+// written to the file by a background thread. Thus, appending never waits
+// on disk I/O and can be called from the loop that reads the devices.
+//
+// `Append` and `Flush` must be called from a single thread at a time.
+class CaptureWriter {
+ public:
+  struct Options {
+    // Number of records per chunk.
+    std::size_t records_per_chunk = 4096;
+    // A chunk is also sealed once it spans more than this duration, so that
+    // a file cut short (crash, power loss) loses at most that much.
+    absl::Duration max_chunk_duration = absl::Seconds(1);
+    // Encoding of the chunks. Compression runs on the background thread.
+    CaptureEncoding encoding = CaptureEncoding::kDelta;
+  };
+  // Work-around for GCC/Clang bug.
+  static Options Defaults() { return Options{}; }
+
+  static absl::StatusOr<CaptureWriter> Create(
+      const std::string& path, const std::vector<CaptureDeviceInfo>& devices,
+      const Options& options = Defaults());
+
+  CaptureWriter() = default;
+  CaptureWriter(const CaptureWriter&) = delete;
+  CaptureWriter& operator=(const CaptureWriter&) = delete;
+  CaptureWriter(CaptureWriter&& rhs) noexcept;
+  CaptureWriter& operator=(CaptureWriter&& rhs) noexcept;
+  ~CaptureWriter();
+
+  // Record an event from the device at index `device` in the header.
+  void Append(std::uint16_t device, const InputEvent& event) {
+    Append(CaptureRecord::FromInputEvent(device, event));
+  }
+  void Append(const CaptureRecord& record);
+
+  // Hand the current, partial chunk over to the background thread.
+  void Flush();
+
+  // Flush, wait for all chunks to be written, then write the chunk index
+  // and close the file. Returns the first error encountered while writing.
+  absl::Status Close();
+
+  // Number of records appended so far.
+  [[nodiscard]] std::uint64_t RecordCount() const { return record_count_; }
+  // Number of bytes written to the file so far.
+  [[nodiscard]] std::uint64_t BytesWritten() const;
+
+ private:
+  struct Shared;
+
+  static void WriterLoop(Shared* shared);
+  static absl::Status WriteChunk(Shared* shared,
+                                 const std::vector<CaptureRecord>& chunk);
+
+  Options options_;
+  std::vector<CaptureRecord> current_;
+  std::uint64_t record_count_ = 0;
+  // State shared with the background thread. Heap allocated so that the
+  // writer can be moved while the thread runs.
+  std::unique_ptr<Shared> shared_;
+  std::thread thread_;
+};
+
+// Reader of capture files, backed by a read-only memory mapping.
+//
+// Records of raw chunks are returned as pointers into the mapping, without
+// copying. Compressed chunks are decoded one at a time.
+class CaptureReader {
+ public:
+  static absl::StatusOr<CaptureReader> Open(const std::string& path);
+
+  CaptureReader() = default;
+  CaptureReader(const CaptureReader&) = delete;
+  CaptureReader& operator=(const CaptureReader&) = delete;
+  CaptureReader(CaptureReader&& rhs) noexcept;
+  CaptureReader& operator=(CaptureReader&& rhs) noexcept;
+  ~CaptureReader();
+
+  [[nodiscard]] const std::vector<CaptureDeviceInfo>& Devices() const {
+    return devices_;
+  }
+  [[nodiscard]] std::uint64_t RecordCount() const { return record_count_; }
+  [[nodiscard]] std::size_t ChunkCount() const { return chunks_.size(); }
+  // Earliest and latest record times (`InfinitePast` if empty).
+  [[nodiscard]] absl::Time StartTime() const;
+  [[nodiscard]] absl::Time EndTime() const;
+
+  // The records of chunk `index`. Compressed chunks are decoded into
+  // `scratch`, and the result is only valid as long as `scratch` is.
+  [[nodiscard]] absl::StatusOr<absl::Span<const CaptureRecord>> ChunkRecords(
+      std::size_t index, std::vector<CaptureRecord>* scratch) const;
+
+  // Forward iterator over the records of the capture.
+  class Cursor {
+   public:
+    // Records may point into the cursor's decoding buffer, so cursors can
+    // only be moved.
+    Cursor(const Cursor&) = delete;
+    Cursor& operator=(const Cursor&) = delete;
+    Cursor(Cursor&&) noexcept = default;
+    Cursor& operator=(Cursor&&) noexcept = default;
+
+    // Return the next record, or nullptr at the end of the capture (or on
+    // a corrupted chunk, see `DecodeStatus`).
+    const CaptureRecord* Next();
+
+    // Error encountered while decoding chunks, if any.
+    [[nodiscard]] const absl::Status& DecodeStatus() const { return status_; }
+
+   private:
+    friend class CaptureReader;
+    Cursor(const CaptureReader* reader, std::size_t chunk, std::size_t record);
+    void LoadChunk();
+
+    const CaptureReader* reader_ = nullptr;
+    std::size_t chunk_ = 0;
+    std::size_t record_ = 0;
+    absl::Span<const CaptureRecord> records_;
+    std::vector<CaptureRecord> scratch_;
+    absl::Status status_;
+  };
+
+  // A cursor on the first record.
+  [[nodiscard]] Cursor Begin() const { return Cursor(this, 0, 0); }
+  // A cursor on the first record (in file order) at or after `time`. This
+  // is a binary search over the running maximum of the chunk end times,
+  // then a scan of the chunk.
+  [[nodiscard]] Cursor Seek(absl::Time time) const;
+
+ private:
+  struct ChunkInfo {
+    std::uint64_t offset = 0;
+    std::uint64_t payload_size = 0;
+    std::uint32_t record_count = 0;
+    std::uint32_t encoding = 0;
+    std::int64_t min_time_us = 0;
+    std::int64_t max_time_us = 0;
+  };
+
+  absl::Status ParseHeader();
+  absl::Status LoadIndex(std::uint64_t index_offset, std::uint64_t count);
+  absl::Status ScanChunks(std::uint64_t first_chunk_offset);
+  void AddChunk(const ChunkInfo& chunk);
+
+  const std::uint8_t* data_ = nullptr;
+  std::size_t size_ = 0;
+  std::vector<CaptureDeviceInfo> devices_;
+  std::vector<ChunkInfo> chunks_;
+  // Running maximum of `max_time_us` over `chunks_`, sorted even when the
+  // chunks are not.
+  std::vector<std::int64_t> reach_time_us_;
+  std::int64_t start_time_us_ = 0;
+  std::uint64_t record_count_ = 0;
+};
+
+}  // namespace evdevpp
+
+#endif  // EVDEVPP_EVDEVPP_CAPTURE_H_
@@ -0,0 +1,168 @@
+#include "evdevpp/capture_codec.h"
+
+#include "absl/container/flat_hash_map.h"
+#include "linux/input.h"
+
+namespace evdevpp {
+
+namespace {
+
+constexpr std::uint64_t ZigZag(std::int64_t value) {
+  return (static_cast<std::uint64_t>(value) << 1) ^
+         static_cast<std::uint64_t>(value >> 63);
+}
+
+constexpr std::int64_t UnZigZag(std::uint64_t value) {
+  return static_cast<std::int64_t>(value >> 1) ^
+         -static_cast<std::int64_t>(value & 1);
+}
+
+void PutVarint(std::string* out, std::uint64_t value) {
+  char buf[10];
+  int len = 0;
+  while (value >= 0x80) {
+    buf[len++] = static_cast<char>(value | 0x80);
+    value >>= 7;
+  }
+  buf[len++] = static_cast<char>(value);
+  out->append(buf, len);
+}
+
+// Read a varint at `pos`, advancing it. Returns false if the varint is
+// truncated or too long.
+inline bool GetVarint(const std::uint8_t*& pos, const std::uint8_t* end,
+                      std::uint64_t& value) {
+  // Most varints in a block are a single byte.
+  if (pos < end && *pos < 0x80) {
+    value = *pos++;
+    return true;
+  }
+  std::uint64_t result = 0;
+  for (int shift = 0; shift < 64 && pos < end; shift += 7) {
+    std::uint64_t byte = *pos++;
+    result |= (byte & 0x7f) << shift;
+    if (byte < 0x80) {
+      value = result;
+      return true;
+    }
+  }
+  return false;
+}
+
+constexpr std::uint64_t TripleKey(const CaptureRecord& record) {
+  return (std::uint64_t{record.device} << 32) |
+         (std::uint64_t{record.type} << 16) | record.code;
+}
+
+}  // namespace
+
+void EncodeCaptureBlock(absl::Span<const CaptureRecord> records,
+                        std::string* out) {
+  absl::flat_hash_map<std::uint64_t, std::uint32_t> dict;
+  std::vector<const CaptureRecord*> entries;
+  std::vector<std::uint32_t> indices;
+  indices.reserve(records.size());
+  for (const auto& record : records) {
+    auto [it, inserted] = dict.try_emplace(
+        TripleKey(record), static_cast<std::uint32_t>(entries.size()));
+    if (inserted) {
+      entries.push_back(&record);
+    }
+    indices.push_back(it->second);
+  }
+
+  out->reserve(out->size() + entries.size() * 4 + records.size() * 4);
+  PutVarint(out, entries.size());
+  for (const auto* entry : entries) {
+    PutVarint(out, entry->device);
+    PutVarint(out, entry->type);
+    PutVarint(out, entry->code);
+  }
+
+  std::vector<std::int32_t> last_values(entries.size(), 0);
+  std::int64_t last_time_us = 0;
+  std::int64_t last_delta_us = 0;
+  for (std::size_t i = 0; i < records.size(); ++i) {
+    const CaptureRecord& record = records[i];
+    std::uint32_t index = indices[i];
+    std::int64_t delta_us = record.time_us - last_time_us;
+    PutVarint(out, index);
+    PutVarint(out, ZigZag(delta_us - last_delta_us));
+    if (record.type == EV_REL) {
+      PutVarint(out, ZigZag(record.value));
+    } else {
+      PutVarint(out, ZigZag(std::int64_t{record.value} - last_values[index]));
+      last_values[index] = record.value;
+    }
+    last_time_us = record.time_us;
+    last_delta_us = delta_us;
+  }
+}
+
+absl::Status DecodeCaptureBlock(absl::Span<const std::uint8_t> block,
+                                std::size_t record_count,
+                                std::vector<CaptureRecord>* out) {
+  const std::uint8_t* pos = block.data();
+  const std::uint8_t* end = block.data() + block.size();
+  auto corrupted = [] {
+    return absl::DataLossError("Corrupted capture block");
+  };
+
+  std::uint64_t dict_size = 0;
+  // Every dictionary entry and every record takes at least 3 bytes.
+  if (record_count > block.size() / 3 || !GetVarint(pos, end, dict_size) ||
+      dict_size > record_count) {
+    return corrupted();
+  }
+  struct Entry {
+    CaptureRecord prototype;
+    bool is_relative = false;
+  };
+  std::vector<Entry> entries(dict_size);
+  for (auto& entry : entries) {
+    std::uint64_t device = 0;
+    std::uint64_t type = 0;
+    std::uint64_t code = 0;
+    if (!GetVarint(pos, end, device) || !GetVarint(pos, end, type) ||
+        !GetVarint(pos, end, code) || device > 0xffff || type > 0xffff ||
+        code > 0xffff) {
+      return corrupted();
+    }
+    entry.prototype.device = static_cast<std::uint16_t>(device);
+    entry.prototype.type = static_cast<std::uint16_t>(type);
+    entry.prototype.code = static_cast<std::uint16_t>(code);
+    entry.is_relative = (type == EV_REL);
+  }
+
+  out->resize(record_count);
+  // Arithmetic is done on unsigned integers, so that corrupted input wraps
+  // around instead of overflowing.
+  std::uint64_t time_us = 0;
+  std::uint64_t delta_us = 0;
+  for (auto& record : *out) {
+    std::uint64_t index = 0;
+    std::uint64_t dod = 0;
+    std::uint64_t value = 0;
+    if (!GetVarint(pos, end, index) || !GetVarint(pos, end, dod) ||
+        !GetVarint(pos, end, value) || index >= entries.size()) {
+      return corrupted();
+    }
+    Entry& entry = entries[index];
+    delta_us += static_cast<std::uint64_t>(UnZigZag(dod));
+    time_us += delta_us;
+    auto decoded = static_cast<std::uint32_t>(UnZigZag(value));
+    if (!entry.is_relative) {
+      decoded += static_cast<std::uint32_t>(entry.prototype.value);
+      entry.prototype.value = static_cast<std::int32_t>(decoded);
+    }
+    record = entry.prototype;
+    record.time_us = static_cast<std::int64_t>(time_us);
+    record.value = static_cast<std::int32_t>(decoded);
+  }
+  if (pos != end) {
+    return corrupted();
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace evdevpp
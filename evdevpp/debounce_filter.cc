@@ -0,0 +1,186 @@
+#include "evdevpp/debounce_filter.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace evdevpp {
+
+absl::StatusOr<DebounceFilter> DebounceFilter::Create(const EventIO* output,
+                                                      const Options& options) {
+  if (output == nullptr) {
+    return absl::InvalidArgumentError("DebounceFilter needs an output");
+  }
+  return Create(
+      [output](absl::Span<const input_event> frame) {
+        return output->WriteRaw(frame);
+      },
+      options);
+}
+
+absl::StatusOr<DebounceFilter> DebounceFilter::Create(Sink sink,
+                                                      const Options& options) {
+  if (!sink) {
+    return absl::InvalidArgumentError("DebounceFilter needs an output");
+  }
+  DebounceFilter result;
+  result.sink_ = std::move(sink);
+  result.keys_.resize(kKeyCount);
+  const auto configure = [](KeyState& key, Mode mode,
+                            absl::Duration threshold) {
+    if (threshold < absl::ZeroDuration()) {
+      return false;
+    }
+    key.mode = mode;
+    key.threshold_ns = absl::ToInt64Nanoseconds(threshold);
+    return true;
+  };
+  for (KeyState& key : result.keys_) {
+    if (!configure(key, options.mode, options.threshold)) {
+      return absl::InvalidArgumentError("Debounce threshold is negative");
+    }
+  }
+  for (const auto& [code, config] : options.keys) {
+    if (code >= kKeyCount) {
+      return absl::InvalidArgumentError("Debounced key code is out of range");
+    }
+    if (!configure(result.keys_[code], config.mode, config.threshold)) {
+      return absl::InvalidArgumentError("Debounce threshold is negative");
+    }
+  }
+  // Enough that processing does not allocate.
+  result.pending_.reserve(kKeyCount);
+  result.frame_.reserve(kKeyCount);
+  return result;
+}
+
+absl::Status DebounceFilter::Process(absl::Span<const input_event> events) {
+  for (const input_event& event : events) {
+    if (event.type == EV_KEY && event.code < kKeyCount) {
+      const std::int64_t time_ns = EventNanos(event);
+      Expire(time_ns);
+      OnKey(event, time_ns);
+    } else if (event.type == EV_SYN && event.code == SYN_REPORT) {
+      Expire(EventNanos(event));
+      if (auto st = WriteFrame(event); !st.ok()) {
+        return st;
+      }
+    } else {
+      frame_.push_back(event);
+    }
+  }
+  return absl::OkStatus();
+}
+
+absl::Time DebounceFilter::NextDeadline() const {
+  if (pending_.empty()) {
+    return absl::InfiniteFuture();
+  }
+  std::int64_t deadline_ns = keys_[pending_.front()].deadline_ns;
+  for (const std::uint16_t code : pending_) {
+    deadline_ns = std::min(deadline_ns, keys_[code].deadline_ns);
+  }
+  return absl::FromUnixNanos(deadline_ns);
+}
+
+absl::Status DebounceFilter::Tick(absl::Time now) {
+  const std::int64_t now_ns = absl::ToUnixNanos(now);
+  // Only write the changes, the events of a partial input frame stay in
+  // `frame_` until its `SYN_REPORT`.
+  const std::size_t start = frame_.size();
+  Expire(now_ns);
+  if (frame_.size() == start) {
+    return absl::OkStatus();
+  }
+  input_event& syn = frame_.emplace_back(EventAt(now_ns));
+  syn.type = EV_SYN;
+  syn.code = SYN_REPORT;
+  auto st = sink_(absl::MakeConstSpan(frame_).subspan(start));
+  frame_.resize(start);
+  return st;
+}
+
+void DebounceFilter::OnKey(const input_event& event, std::int64_t time_ns) {
+  KeyState& key = keys_[event.code];
+  if (event.value == 2) {
+    // Repeats only pass while the key is down, both ways.
+    if (key.physical != 0 && key.reported != 0) {
+      frame_.push_back(event);
+    }
+    return;
+  }
+  const std::uint8_t value = event.value != 0 ? 1 : 0;
+  if (value == key.physical) {
+    // Not a change.
+    return;
+  }
+  key.physical = value;
+  ++changes_in_;
+  if (key.mode == Mode::kEager) {
+    if (!key.pending && value != key.reported) {
+      // Pass the change at once, then ignore the key for the threshold.
+      Report(event.code, value, time_ns);
+      key.deadline_ns = time_ns + key.threshold_ns;
+      AddPending(event.code);
+    }
+    return;
+  }
+  // Deferred: (re)start the threshold.
+  key.deadline_ns = time_ns + key.threshold_ns;
+  AddPending(event.code);
+}
+
+void DebounceFilter::Expire(std::int64_t now_ns) {
+  for (std::size_t i = 0; i < pending_.size();) {
+    const std::uint16_t code = pending_[i];
+    KeyState& key = keys_[code];
+    if (key.deadline_ns > now_ns) {
+      ++i;
+      continue;
+    }
+    if (key.physical != key.reported) {
+      Report(code, key.physical, key.deadline_ns);
+      if (key.mode == Mode::kEager) {
+        // Ignore the key for another threshold, checked again right away in
+        // case it is already over.
+        key.deadline_ns += key.threshold_ns;
+        continue;
+      }
+    }
+    key.pending = false;
+    pending_[i] = pending_.back();
+    pending_.pop_back();
+  }
+}
+
+void DebounceFilter::Report(std::uint16_t code, std::uint8_t value,
+                            std::int64_t time_ns) {
+  input_event& event = frame_.emplace_back(EventAt(time_ns));
+  event.type = EV_KEY;
+  event.code = code;
+  event.value = value;
+  keys_[code].reported = value;
+  ++changes_out_;
+}
+
+void DebounceFilter::AddPending(std::uint16_t code) {
+  if (!keys_[code].pending) {
+    keys_[code].pending = true;
+    pending_.push_back(code);
+  }
+}
+
+absl::Status DebounceFilter::WriteFrame(const input_event& syn) {
+  if (std::all_of(frame_.begin(), frame_.end(), [](const input_event& event) {
+        return event.type == EV_MSC && event.code == MSC_SCAN;
+      })) {
+    // Only suppressed (or delayed) key events, and their scan codes.
+    frame_.clear();
+    return absl::OkStatus();
+  }
+  frame_.push_back(syn);
+  auto st = sink_(frame_);
+  frame_.clear();
+  return st;
+}
+
+}  // namespace evdevpp
@@ -0,0 +1,132 @@
+#ifndef EVDEVPP_EVDEVPP_DEBOUNCE_FILTER_H_
+#define EVDEVPP_EVDEVPP_DEBOUNCE_FILTER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "evdevpp/eventio.h"
+#include "linux/input.h"
+
+namespace evdevpp {
+
+// Suppresses the chatter of worn key switches: presses and releases that
+// bounce a few milliseconds apart.
+//
+// Each key is debounced in one of two modes:
+//  - Eager: a change of the key is passed at once (without added latency),
+//    then the key is ignored for `threshold`. If the key ended up in the
+//    other state, that change is passed at the end of the threshold.
+//  - Deferred: a change of the key is passed once the key has been stable
+//    for `threshold`, which delays every change by the threshold.
+//
+// Times are those of the event timestamps, so that the debounce does not
+// depend on when the events are read. The state of the keys is kept in
+// dense arrays indexed by key code, and processing does not allocate.
+// Other events pass through, and frames left without events (but scan
+// codes) are dropped.
+//
+// Frames are written to `output` (typically a `UserInputDevice` forwarding
+// an `InputDevice`) or passed to a callback. When changes are pending,
+// `Tick` must be called at (or after) `NextDeadline`, e.g., by using it as
+// the timeout of the wait for input.
+//
+//   auto debounce_or = DebounceFilter::Create(
+//       &virtual_kbd, {.threshold = absl::Milliseconds(8)});
+//   ... for each batch of events of the keyboard:
+//   (void)debounce_or->Process(events);
+//   ... when waiting for events times out:
+//   (void)debounce_or->Tick(absl::Now());
+//
+// Not thread-safe.
+class DebounceFilter {
+ public:
+  enum class Mode : std::uint8_t { kEager, kDeferred };
+
+  struct KeyConfig {
+    Mode mode = Mode::kEager;
+    absl::Duration threshold = absl::Milliseconds(5);
+  };
+
+  struct Options {
+    // For the keys without a config of their own.
+    Mode mode = Mode::kEager;
+    absl::Duration threshold = absl::Milliseconds(5);
+    // By key code.
+    absl::flat_hash_map<std::uint16_t, KeyConfig> keys;
+  };
+  // Work-around for GCC/Clang bug.
+  static Options Defaults() { return Options{}; }
+
+  // Receives each frame, ending with its `SYN_REPORT`.
+  using Sink = std::function<absl::Status(absl::Span<const input_event>)>;
+
+  // `output` must outlive the filter.
+  static absl::StatusOr<DebounceFilter> Create(
+      const EventIO* output, const Options& options = Defaults());
+  static absl::StatusOr<DebounceFilter> Create(
+      Sink sink, const Options& options = Defaults());
+
+  // Process input events.
+  absl::Status Process(absl::Span<const input_event> events);
+
+  // The time at which `Tick` must be called, or `InfiniteFuture` if no
+  // change is pending.
+  [[nodiscard]] absl::Time NextDeadline() const;
+  // Pass the changes that are due at `now`, on the clock of the event
+  // timestamps.
+  absl::Status Tick(absl::Time now);
+
+  // Whether key `code` is down, as passed on.
+  [[nodiscard]] bool IsDown(std::uint16_t code) const {
+    return code < kKeyCount && keys_[code].reported != 0;
+  }
+  // Number of presses and releases dropped (or pending).
+  [[nodiscard]] std::uint64_t SuppressedCount() const {
+    return changes_in_ - changes_out_;
+  }
+
+ private:
+  static constexpr std::size_t kKeyCount = KEY_CNT;
+
+  struct KeyState {
+    // End of the threshold, while pending.
+    std::int64_t deadline_ns = 0;
+    std::int64_t threshold_ns = 0;
+    Mode mode = Mode::kEager;
+    // Last state of the key, and state passed on.
+    std::uint8_t physical = 0;
+    std::uint8_t reported = 0;
+    bool pending = false;
+  };
+
+  void OnKey(const input_event& event, std::int64_t time_ns);
+  // Resolve the pending keys whose threshold ended at or before `now_ns`,
+  // appending their changes to `frame_`.
+  void Expire(std::int64_t now_ns);
+  // Append a change of `code` to `frame_`, at `time_ns`.
+  void Report(std::uint16_t code, std::uint8_t value, std::int64_t time_ns);
+  void AddPending(std::uint16_t code);
+  // Write `frame_` (if it has any event but scan codes) followed by `syn`.
+  absl::Status WriteFrame(const input_event& syn);
+
+  Sink sink_;
+  std::vector<KeyState> keys_;
+  // Codes of the pending keys.
+  std::vector<std::uint16_t> pending_;
+  // Events of the current frame.
+  std::vector<input_event> frame_;
+  // Presses and releases received and passed on.
+  std::uint64_t changes_in_ = 0;
+  std::uint64_t changes_out_ = 0;
+};
+
+}  // namespace evdevpp
+
+#endif  // EVDEVPP_EVDEVPP_DEBOUNCE_FILTER_H_
@@ -1,16 +1,23 @@
 #include "evdevpp/device.h"
 
 #include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
 
+#include <algorithm>
 #include <array>
 #include <cerrno>
 #include <climits>
 #include <cstdint>
+#include <cstring>
 #include <filesystem>
 #include <unordered_map>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "evdevpp/info.h"
+#include "fmt/format.h"
 #include "linux/input.h"
 
 namespace evdevpp {
@@ -36,6 +43,55 @@ bool IsBitSet(const std::array<std::uint8_t, N>& bitmask, int bit) {
   return (bitmask[bit / 8] & (1 << (bit % 8))) != 0;
 }
 
+static_assert(DeviceSnapshot::kKeyCount == KEY_CNT);
+static_assert(DeviceSnapshot::kLEDCount == LED_CNT);
+static_assert(DeviceSnapshot::kSwitchCount == SW_CNT);
+static_assert(DeviceSnapshot::kSoundCount == SND_CNT);
+static_assert(DeviceSnapshot::kAbsCount == ABS_CNT);
+static_assert(DeviceSnapshot::kFirstMtCode == ABS_MT_TOUCH_MAJOR);
+static_assert(DeviceSnapshot::kFirstMtCode + DeviceSnapshot::kMtCodeCount ==
+              ABS_MT_TOOL_Y + 1);
+
+// Query a kernel bitmask with `request(len)` and copy it into `bits`.
+template <std::size_t N, typename Request>
+absl::Status QueryBits(int fd, Request request, std::bitset<N>& bits,
+                       const char* error_message) {
+  std::array<std::uint8_t, (N + 7) / 8> bytes{};
+  if (VarTempIOCTL(fd, request(bytes.size()), bytes.data()) < 0) {
+    return absl::ErrnoToStatus(errno, error_message);
+  }
+  bits.reset();
+  for (std::size_t i = 0; i < bytes.size(); ++i) {
+    // Most bytes are zero, skip them quickly.
+    for (std::uint8_t byte = bytes[i]; byte != 0; byte &= byte - 1) {
+      std::size_t bit = i * 8 + __builtin_ctz(byte);
+      if (bit < N) {
+        bits.set(bit);
+      }
+    }
+  }
+  return absl::OkStatus();
+}
+
+KeymapEntry FromKernelKeymapEntry(const input_keymap_entry& kernel_entry) {
+  KeymapEntry entry{.index = kernel_entry.index,
+                    .keycode = kernel_entry.keycode};
+  std::memcpy(&entry.scancode, kernel_entry.scancode,
+              std::min<std::size_t>(kernel_entry.len, sizeof(entry.scancode)));
+  return entry;
+}
+
+input_keymap_entry ToKernelKeymapEntry(const KeymapEntry& entry,
+                                       bool by_index) {
+  input_keymap_entry kernel_entry{};
+  kernel_entry.flags = (by_index ? INPUT_KEYMAP_BY_INDEX : 0);
+  kernel_entry.index = entry.index;
+  kernel_entry.keycode = entry.keycode;
+  kernel_entry.len = sizeof(entry.scancode);
+  std::memcpy(kernel_entry.scancode, &entry.scancode, sizeof(entry.scancode));
+  return kernel_entry;
+}
+
 }  // namespace
 
 // List readable character devices in `input_device_dir`.
@@ -196,6 +252,70 @@ absl::StatusOr<InputDevice> InputDevice::Open(const std::string& dev_path) {
   return result;
 }
 
+absl::StatusOr<InputDevice> InputDevice::OpenWhenReady(
+    const std::string& dev_path, absl::Time deadline, int cancel_fd) {
+  std::filesystem::path fs_path{dev_path};
+  std::string dev_basename = fs_path.filename().native();
+  std::string dev_dirname = fs_path.parent_path().native();
+
+  // Set up the watch before the first attempt so that a node created in
+  // between cannot be missed.
+  toolbelt::FileDescriptor inotify_fd(
+      ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC));
+  if (!inotify_fd.IsOpen() ||
+      ::inotify_add_watch(inotify_fd.Fd(), dev_dirname.c_str(),
+                          IN_CREATE | IN_ATTRIB | IN_MOVED_TO) < 0) {
+    // Without a watch on the directory, there is nothing to wait for.
+    return Open(dev_path);
+  }
+
+  alignas(inotify_event) std::array<char, 1024> buffer{};
+  while (true) {
+    auto dev_or = Open(dev_path);
+    absl::Duration remaining = deadline - absl::Now();
+    if (dev_or.ok() || remaining <= absl::ZeroDuration()) {
+      return dev_or;
+    }
+
+    // Sleep until something happens to our device node, or the deadline.
+    bool node_changed = false;
+    while (!node_changed) {
+      remaining = deadline - absl::Now();
+      if (remaining <= absl::ZeroDuration()) {
+        break;
+      }
+      std::array<pollfd, 2> pfds = {{{.fd = inotify_fd.Fd(), .events = POLLIN},
+                                      {.fd = cancel_fd, .events = POLLIN}}};
+      int poll_res = ::poll(
+          pfds.data(), pfds.size(),
+          std::max(1, static_cast<int>(absl::ToInt64Milliseconds(
+                          absl::Ceil(remaining, absl::Milliseconds(1))))));
+      if (poll_res < 0 && errno != EINTR) {
+        return absl::ErrnoToStatus(errno, "Waiting for input device failed");
+      }
+      if ((pfds[1].revents & POLLIN) != 0) {
+        return absl::CancelledError("Waiting for input device was cancelled");
+      }
+      ssize_t nread = 0;
+      while ((nread = ::read(inotify_fd.Fd(), buffer.data(), buffer.size())) >
+             0) {
+        for (std::size_t offset = 0;
+             offset < static_cast<std::size_t>(nread);) {
+          const auto* event =
+              // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+              reinterpret_cast<const inotify_event*>(buffer.data() + offset);
+          offset += sizeof(inotify_event) + event->len;
+          if ((event->mask & IN_Q_OVERFLOW) != 0 ||
+              (event->len != 0 &&
+               dev_basename == static_cast<const char*>(event->name))) {
+            node_changed = true;
+          }
+        }
+      }
+    }
+  }
+}
+
 absl::Status InputDevice::Grab() const {
   if (VarTempIOCTL(fd_.Fd(), EVIOCGRAB, 1) != 0) {
     return absl::ErrnoToStatus(errno, "Input device grabbing failed");
@@ -210,6 +330,13 @@ absl::Status InputDevice::Ungrab() const {
   return absl::OkStatus();
 }
 
+absl::Status InputDevice::SetClockId(int clock_id) const {
+  if (VarTempIOCTL(fd_.Fd(), EVIOCSCLOCKID, &clock_id) != 0) {
+    return absl::ErrnoToStatus(errno, "Input device clock selection failed");
+  }
+  return absl::OkStatus();
+}
+
 absl::StatusOr<absl::flat_hash_set<std::uint16_t>> InputDevice::Properties()
     const {
   std::array<std::uint8_t, (INPUT_PROP_MAX + 7) / 8> bytes{};
@@ -265,6 +392,93 @@ absl::StatusOr<absl::flat_hash_set<std::uint16_t>> InputDevice::GetActiveKeys()
   return result;
 }
 
+absl::Status InputDevice::Snapshot(DeviceSnapshot& snapshot) const {
+  const int fd = fd_.Fd();
+  if (!capabilities_.keys.empty()) {
+    if (auto st = QueryBits(
+            fd, [](std::size_t len) { return EVIOCGKEY(len); }, snapshot.keys,
+            "Input device getting active keys failed");
+        !st.ok()) {
+      return st;
+    }
+  } else {
+    snapshot.keys.reset();
+  }
+  if (!capabilities_.leds.empty()) {
+    if (auto st = QueryBits(
+            fd, [](std::size_t len) { return EVIOCGLED(len); }, snapshot.leds,
+            "Input device getting active LEDs failed");
+        !st.ok()) {
+      return st;
+    }
+  } else {
+    snapshot.leds.reset();
+  }
+  if (!capabilities_.switches.empty()) {
+    if (auto st = QueryBits(
+            fd, [](std::size_t len) { return EVIOCGSW(len); },
+            snapshot.switches, "Input device getting switch states failed");
+        !st.ok()) {
+      return st;
+    }
+  } else {
+    snapshot.switches.reset();
+  }
+  if (!capabilities_.sounds.empty()) {
+    if (auto st = QueryBits(
+            fd, [](std::size_t len) { return EVIOCGSND(len); },
+            snapshot.sounds, "Input device getting sound states failed");
+        !st.ok()) {
+      return st;
+    }
+  } else {
+    snapshot.sounds.reset();
+  }
+
+  snapshot.abs_present.reset();
+  snapshot.mt_present.reset();
+  snapshot.mt_slot_count = 0;
+  if (auto slot_it = capabilities_.absolute_axes.find(ABS_MT_SLOT);
+      slot_it != capabilities_.absolute_axes.end()) {
+    snapshot.mt_slot_count = std::min<std::size_t>(
+        std::max(slot_it->second.maximum + 1, 0), DeviceSnapshot::kMaxMtSlots);
+  }
+  for (const auto& [code, absinfo] : capabilities_.absolute_axes) {
+    if (code >= DeviceSnapshot::kAbsCount) {
+      continue;
+    }
+    input_absinfo abs_state{};
+    if (VarTempIOCTL(fd, EVIOCGABS(code), &abs_state) < 0) {
+      return absl::ErrnoToStatus(errno,
+                                 "Input device getting axis value failed");
+    }
+    snapshot.abs_values[code] = abs_state.value;
+    snapshot.abs_present.set(code);
+
+    if (code < DeviceSnapshot::kFirstMtCode ||
+        code >= DeviceSnapshot::kFirstMtCode + DeviceSnapshot::kMtCodeCount ||
+        snapshot.mt_slot_count == 0) {
+      continue;
+    }
+    // Layout expected by EVIOCGMTSLOTS: the code, followed by one value per
+    // slot.
+    std::array<std::int32_t, DeviceSnapshot::kMaxMtSlots + 1> mt_request{};
+    mt_request[0] = code;
+    if (VarTempIOCTL(fd,
+                     EVIOCGMTSLOTS((snapshot.mt_slot_count + 1) *
+                                   sizeof(std::int32_t)),
+                     mt_request.data()) < 0) {
+      return absl::ErrnoToStatus(
+          errno, "Input device getting multi-touch slot values failed");
+    }
+    auto& mt_values = snapshot.mt_values[code - DeviceSnapshot::kFirstMtCode];
+    std::copy_n(mt_request.begin() + 1, snapshot.mt_slot_count,
+                mt_values.begin());
+    snapshot.mt_present.set(code - DeviceSnapshot::kFirstMtCode);
+  }
+  return absl::OkStatus();
+}
+
 absl::StatusOr<KeyRepeatInfo> InputDevice::GetRepeat() const {
   std::array<unsigned int, 2> rep{};
   // NOLINTNEXTLINE(cppcoreguidelines-avoid-c-arrays,modernize-avoid-c-arrays)
@@ -287,6 +501,82 @@ absl::Status InputDevice::SetRepeat(const KeyRepeatInfo& rep_info) const {
   return absl::OkStatus();
 }
 
+absl::StatusOr<std::vector<KeymapEntry>> InputDevice::GetKeymap() const {
+  std::vector<KeymapEntry> result;
+  for (std::uint32_t index = 0; index <= UINT16_MAX; ++index) {
+    input_keymap_entry kernel_entry{};
+    kernel_entry.flags = INPUT_KEYMAP_BY_INDEX;
+    kernel_entry.index = static_cast<std::uint16_t>(index);
+    if (VarTempIOCTL(fd_.Fd(), EVIOCGKEYCODE_V2, &kernel_entry) < 0) {
+      // The end of the table.
+      if (errno == EINVAL) {
+        break;
+      }
+      return absl::ErrnoToStatus(errno, "Input device keymap query failed");
+    }
+    result.push_back(FromKernelKeymapEntry(kernel_entry));
+  }
+  return result;
+}
+
+absl::StatusOr<KeymapEntry> InputDevice::GetKeymapEntry(
+    std::uint32_t scancode) const {
+  input_keymap_entry kernel_entry =
+      ToKernelKeymapEntry({.scancode = scancode}, /*by_index=*/false);
+  if (VarTempIOCTL(fd_.Fd(), EVIOCGKEYCODE_V2, &kernel_entry) < 0) {
+    return absl::ErrnoToStatus(errno, "Input device keymap query failed");
+  }
+  return FromKernelKeymapEntry(kernel_entry);
+}
+
+absl::StatusOr<KeymapEntry> InputDevice::GetKeymapEntryByIndex(
+    std::uint16_t index) const {
+  input_keymap_entry kernel_entry =
+      ToKernelKeymapEntry({.index = index}, /*by_index=*/true);
+  if (VarTempIOCTL(fd_.Fd(), EVIOCGKEYCODE_V2, &kernel_entry) < 0) {
+    return absl::ErrnoToStatus(errno, "Input device keymap query failed");
+  }
+  return FromKernelKeymapEntry(kernel_entry);
+}
+
+absl::Status InputDevice::SetKeymap(absl::Span<const KeymapEntry> entries,
+                                    bool by_index) const {
+  for (const auto& entry : entries) {
+    input_keymap_entry kernel_entry = ToKernelKeymapEntry(entry, by_index);
+    if (VarTempIOCTL(fd_.Fd(), EVIOCSKEYCODE_V2, &kernel_entry) < 0) {
+      return absl::ErrnoToStatus(
+          errno, fmt::format("Input device setting keymap entry 0x{:X} failed",
+                             by_index ? entry.index : entry.scancode));
+    }
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<std::size_t> InputDevice::ApplyKeymap(
+    absl::Span<const KeymapEntry> entries) const {
+  auto current_or = GetKeymap();
+  if (!current_or.ok()) {
+    return current_or.status();
+  }
+  absl::flat_hash_map<std::uint32_t, std::uint32_t> current;
+  current.reserve(current_or->size());
+  for (const auto& entry : *current_or) {
+    current.emplace(entry.scancode, entry.keycode);
+  }
+
+  std::vector<KeymapEntry> changed;
+  for (const auto& entry : entries) {
+    auto it = current.find(entry.scancode);
+    if (it == current.end() || it->second != entry.keycode) {
+      changed.push_back(entry);
+    }
+  }
+  if (auto st = SetKeymap(changed); !st.ok()) {
+    return st;
+  }
+  return changed.size();
+}
+
 absl::StatusOr<absl::flat_hash_set<std::uint16_t>> InputDevice::LEDs() const {
   std::array<std::uint8_t, (LED_MAX + 7) / 8> bytes{};
   if (VarTempIOCTL(fd_.Fd(), EVIOCGLED(bytes.size()), bytes.data()) == -1) {
@@ -1,11 +1,18 @@
 #ifndef EVDEVPP_EVDEVPP_DEVICE_H_
 #define EVDEVPP_EVDEVPP_DEVICE_H_
 
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
 #include <string>
+#include <vector>
 
 #include "absl/container/flat_hash_set.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
 #include "evdevpp/ecodes.h"
 #include "evdevpp/eventio.h"
 #include "evdevpp/info.h"
@@ -19,11 +26,67 @@ std::vector<std::string> ListDevices(
 // Check if `filename` is a readable and writable character device.
 bool IsDevice(const std::string& filename);
 
+// The complete input state of a device, see `InputDevice::Snapshot`.
+//
+// This structure has a fixed size and holds no heap memory, so it can be
+// allocated once and refilled at will.
+struct DeviceSnapshot {
+  static constexpr std::size_t kKeyCount = 0x300;    // KEY_CNT
+  static constexpr std::size_t kLEDCount = 0x10;     // LED_CNT
+  static constexpr std::size_t kSwitchCount = 0x11;  // SW_CNT
+  static constexpr std::size_t kSoundCount = 0x08;   // SND_CNT
+  static constexpr std::size_t kAbsCount = 0x40;     // ABS_CNT
+  // Multi-touch axes with per-slot values: ABS_MT_TOUCH_MAJOR to ABS_MT_TOOL_Y.
+  static constexpr std::uint16_t kFirstMtCode = 0x30;
+  static constexpr std::size_t kMtCodeCount = 14;
+  static constexpr std::size_t kMaxMtSlots = 64;
+
+  std::bitset<kKeyCount> keys;
+  std::bitset<kLEDCount> leds;
+  std::bitset<kSwitchCount> switches;
+  std::bitset<kSoundCount> sounds;
+  // Current value of each absolute axis, indexed by code. Only the axes in
+  // `abs_present` are filled.
+  std::array<std::int32_t, kAbsCount> abs_values{};
+  std::bitset<kAbsCount> abs_present;
+  // Per-slot multi-touch values, indexed by `code - kFirstMtCode` and slot.
+  // Only the codes in `mt_present` and the first `mt_slot_count` slots are
+  // filled. Devices with more slots than `kMaxMtSlots` are truncated.
+  std::size_t mt_slot_count = 0;
+  std::array<std::array<std::int32_t, kMaxMtSlots>, kMtCodeCount> mt_values{};
+  std::bitset<kMtCodeCount> mt_present;
+
+  [[nodiscard]] std::int32_t MtValue(std::uint16_t code,
+                                     std::size_t slot) const {
+    return mt_values[code - kFirstMtCode][slot];
+  }
+};
+
+// An entry of the scancode-to-keycode table of a device (as in
+// `input_keymap_entry`). Scancodes of up to 4 bytes are supported, which
+// covers the drivers in the kernel tree.
+struct KeymapEntry {
+  // Position in the table, only used for lookups by index.
+  std::uint16_t index = 0;
+  std::uint32_t scancode = 0;
+  std::uint32_t keycode = 0;
+};
+
 // A linux input device from which input events can be read.
 class InputDevice : public EventIO {
  public:
   static absl::StatusOr<InputDevice> Open(const std::string& dev_path);
 
+  // Open the input device at `dev_path`, waiting until `deadline` for the
+  // device node to appear and become accessible (e.g., while udev is still
+  // setting its permissions). Waiting is driven by inotify on the parent
+  // directory, not by polling. If the deadline passes, the status of the
+  // last open attempt is returned. If `cancel_fd` (e.g., an eventfd) becomes
+  // readable, the wait is abandoned with a `CancelledError`.
+  static absl::StatusOr<InputDevice> OpenWhenReady(const std::string& dev_path,
+                                                   absl::Time deadline,
+                                                   int cancel_fd = -1);
+
   // Grab input device using `EVIOCGRAB` - other applications will
   // be unable to receive events until the device is released. Only
   // one process can hold a `EVIOCGRAB` on a device.
@@ -67,6 +130,11 @@ class InputDevice : public EventIO {
     return ScopedGrab(this);
   }
 
+  // Select the clock used for the timestamps of the events read from this
+  // device (`EVIOCSCLOCKID`), e.g., `CLOCK_MONOTONIC` to compare them with
+  // `clock_gettime`. The default is `CLOCK_REALTIME`.
+  absl::Status SetClockId(int clock_id) const;
+
   // Get device properties and quirks.
   [[nodiscard]] absl::StatusOr<absl::flat_hash_set<std::uint16_t>> Properties()
       const;
@@ -87,9 +155,37 @@ class InputDevice : public EventIO {
   [[nodiscard]] absl::StatusOr<absl::flat_hash_set<std::uint16_t>>
   GetActiveKeys() const;
 
+  // Fill `snapshot` with the full state of the device: active keys, LEDs,
+  // switches and sounds (`EVIOCGKEY`, `EVIOCGLED`, `EVIOCGSW`, `EVIOCGSND`),
+  // absolute axis values (`EVIOCGABS`) and multi-touch slot values
+  // (`EVIOCGMTSLOTS`). Only the queries the device has capabilities for are
+  // issued. Does not allocate.
+  absl::Status Snapshot(DeviceSnapshot& snapshot) const;
+
   [[nodiscard]] absl::StatusOr<KeyRepeatInfo> GetRepeat() const;
   absl::Status SetRepeat(const KeyRepeatInfo& rep_info) const;
 
+  // Read the whole keymap of the device, by index (`EVIOCGKEYCODE_V2`).
+  // Devices without a keymap return an empty keymap.
+  [[nodiscard]] absl::StatusOr<std::vector<KeymapEntry>> GetKeymap() const;
+  // Read a single entry, by scancode or by index.
+  [[nodiscard]] absl::StatusOr<KeymapEntry> GetKeymapEntry(
+      std::uint32_t scancode) const;
+  [[nodiscard]] absl::StatusOr<KeymapEntry> GetKeymapEntryByIndex(
+      std::uint16_t index) const;
+
+  // Set keymap entries (`EVIOCSKEYCODE_V2`), by scancode, or by index if
+  // `by_index` is true. Stops at the first failure.
+  absl::Status SetKeymap(absl::Span<const KeymapEntry> entries,
+                         bool by_index = false) const;
+
+  // Set keymap entries by scancode, only for the entries that differ from
+  // the current keymap, which is read once. Returns the number of entries
+  // changed. Use this to apply a full desired keymap without touching the
+  // device more than needed.
+  absl::StatusOr<std::size_t> ApplyKeymap(
+      absl::Span<const KeymapEntry> entries) const;
+
   // Return currently set LED keys.
   [[nodiscard]] absl::StatusOr<absl::flat_hash_set<std::uint16_t>> LEDs() const;
   // Set the state of the selected LED.
@@ -110,6 +206,8 @@ class InputDevice : public EventIO {
   absl::Status EraseEffect(int id) const;
 
   // Erase all force effects on the device. This also stops all effects.
+  // Every id below `FFEffectsCount()` is erased, live or not, see
+  // `EffectCache` to only erase the effects actually uploaded.
   void ClearEffects() const;
 
  private:
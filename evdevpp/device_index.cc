@@ -0,0 +1,208 @@
+#include "evdevpp/device_index.h"
+
+#include <algorithm>
+#include <type_traits>
+
+#include "linux/input.h"
+
+namespace evdevpp {
+
+namespace {
+
+// Posting keys are (event type, event code) pairs for capabilities. The
+// identity fields use pseudo event types outside of the 16 bits of event
+// types (any of which, e.g., `EV_UINPUT`, may be a capability).
+constexpr std::uint32_t kBustypeKey = 0x10000;
+constexpr std::uint32_t kVendorKey = 0x10001;
+constexpr std::uint32_t kProductKey = 0x10002;
+constexpr std::uint32_t kVersionKey = 0x10003;
+
+constexpr std::uint64_t MakeKey(std::uint32_t etype, std::uint16_t code) {
+  return (std::uint64_t{etype} << 16) | code;
+}
+
+template <typename CodeSet, typename Func>
+void ForEachCode(std::uint16_t etype, const CodeSet& codes, Func&& func) {
+  for (const auto& code : codes) {
+    if constexpr (std::is_convertible_v<decltype(code), std::uint16_t>) {
+      func(MakeKey(etype, code));
+    } else {
+      func(MakeKey(etype, code.first));
+    }
+  }
+}
+
+// Calls `func` with the posting key of every capability in `caps`.
+template <typename Func>
+void ForEachCapability(const CapabilitiesInfo& caps, Func&& func) {
+  ForEachCode(EV_KEY, caps.keys, func);
+  ForEachCode(EV_SYN, caps.synchs, func);
+  ForEachCode(EV_REL, caps.relative_axes, func);
+  ForEachCode(EV_ABS, caps.absolute_axes, func);
+  ForEachCode(EV_MSC, caps.miscs, func);
+  ForEachCode(EV_SW, caps.switches, func);
+  ForEachCode(EV_LED, caps.leds, func);
+  ForEachCode(EV_SND, caps.sounds, func);
+  ForEachCode(EV_REP, caps.autorepeats, func);
+  ForEachCode(EV_FF, caps.force_feedbacks, func);
+  ForEachCode(EventType::kUinput, caps.uinputs, func);
+}
+
+template <typename Func>
+void ForEachIdentity(const DeviceInfo& info, Func&& func) {
+  func(MakeKey(kBustypeKey, info.bustype));
+  func(MakeKey(kVendorKey, info.vendor));
+  func(MakeKey(kProductKey, info.product));
+  func(MakeKey(kVersionKey, info.version));
+}
+
+}  // namespace
+
+DeviceIndex::DeviceId DeviceIndex::Add(const InputDevice& device) {
+  (void)Remove(device.DevPath());
+
+  DeviceId id = 0;
+  if (!free_ids_.empty()) {
+    id = free_ids_.back();
+    free_ids_.pop_back();
+    devices_[id] = device;
+  } else {
+    id = static_cast<DeviceId>(devices_.size());
+    devices_.emplace_back(device);
+  }
+  by_path_[device.DevPath()] = id;
+
+  if (live_.size() * 64 < devices_.size()) {
+    live_.resize((devices_.size() + 63) / 64, 0);
+  }
+  live_[id / 64] |= (std::uint64_t{1} << (id % 64));
+  auto set_posting = [this, id](std::uint64_t key) { SetPosting(key, id); };
+  ForEachCapability(device.Capabilities(), set_posting);
+  ForEachIdentity(device.Info(), set_posting);
+  return id;
+}
+
+bool DeviceIndex::Remove(DeviceId id) {
+  if (id >= devices_.size() || !devices_[id].has_value()) {
+    return false;
+  }
+  const InputDevice& device = *devices_[id];
+  auto clear_posting = [this, id](std::uint64_t key) {
+    ClearPosting(key, id);
+  };
+  ForEachCapability(device.Capabilities(), clear_posting);
+  ForEachIdentity(device.Info(), clear_posting);
+  live_[id / 64] &= ~(std::uint64_t{1} << (id % 64));
+  by_path_.erase(device.DevPath());
+  devices_[id].reset();
+  free_ids_.push_back(id);
+  return true;
+}
+
+bool DeviceIndex::Remove(const std::string& dev_path) {
+  auto it = by_path_.find(dev_path);
+  if (it == by_path_.end()) {
+    return false;
+  }
+  return Remove(it->second);
+}
+
+const InputDevice* DeviceIndex::Get(DeviceId id) const {
+  if (id >= devices_.size() || !devices_[id].has_value()) {
+    return nullptr;
+  }
+  return &*devices_[id];
+}
+
+std::optional<DeviceIndex::DeviceId> DeviceIndex::Find(
+    const std::string& dev_path) const {
+  auto it = by_path_.find(dev_path);
+  if (it == by_path_.end()) {
+    return std::nullopt;
+  }
+  return it->second;
+}
+
+std::vector<DeviceIndex::DeviceId> DeviceIndex::Match(
+    const DeviceQuery& query) const {
+  std::vector<DeviceId> result;
+  Match(query, &result);
+  return result;  // NRVO
+}
+
+void DeviceIndex::Match(const DeviceQuery& query,
+                        std::vector<DeviceId>* result) const {
+  result->clear();
+  Bitset acc = live_;
+  bool non_empty = std::any_of(acc.begin(), acc.end(),
+                               [](std::uint64_t word) { return word != 0; });
+  auto intersect = [this, &acc, &non_empty](std::uint64_t key) {
+    non_empty = non_empty && Intersect(key, acc);
+  };
+  if (query.bustype.has_value()) {
+    intersect(MakeKey(kBustypeKey, *query.bustype));
+  }
+  if (query.vendor.has_value()) {
+    intersect(MakeKey(kVendorKey, *query.vendor));
+  }
+  if (query.product.has_value()) {
+    intersect(MakeKey(kProductKey, *query.product));
+  }
+  if (query.version.has_value()) {
+    intersect(MakeKey(kVersionKey, *query.version));
+  }
+  ForEachCapability(query.required, intersect);
+  if (!non_empty) {
+    return;
+  }
+
+  for (std::size_t w = 0; w < acc.size(); ++w) {
+    std::uint64_t word = acc[w];
+    while (word != 0) {
+      result->push_back(
+          static_cast<DeviceId>(w * 64 + __builtin_ctzll(word)));
+      word &= word - 1;
+    }
+  }
+}
+
+void DeviceIndex::SetPosting(std::uint64_t key, DeviceId id) {
+  Bitset& posting = postings_[key];
+  if (posting.size() <= id / 64) {
+    posting.resize(id / 64 + 1, 0);
+  }
+  posting[id / 64] |= (std::uint64_t{1} << (id % 64));
+}
+
+void DeviceIndex::ClearPosting(std::uint64_t key, DeviceId id) {
+  auto it = postings_.find(key);
+  if (it == postings_.end() || it->second.size() <= id / 64) {
+    return;
+  }
+  Bitset& posting = it->second;
+  posting[id / 64] &= ~(std::uint64_t{1} << (id % 64));
+  // Keep the map small when devices come and go.
+  while (!posting.empty() && posting.back() == 0) {
+    posting.pop_back();
+  }
+  if (posting.empty()) {
+    postings_.erase(it);
+  }
+}
+
+bool DeviceIndex::Intersect(std::uint64_t key, Bitset& acc) const {
+  auto it = postings_.find(key);
+  if (it == postings_.end()) {
+    std::fill(acc.begin(), acc.end(), 0);
+    return false;
+  }
+  const Bitset& posting = it->second;
+  std::uint64_t any = 0;
+  for (std::size_t w = 0; w < acc.size(); ++w) {
+    acc[w] &= (w < posting.size() ? posting[w] : 0);
+    any |= acc[w];
+  }
+  return any != 0;
+}
+
+}  // namespace evdevpp
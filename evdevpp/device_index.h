@@ -0,0 +1,91 @@
+#ifndef EVDEVPP_EVDEVPP_DEVICE_INDEX_H_
+#define EVDEVPP_EVDEVPP_DEVICE_INDEX_H_
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "evdevpp/device.h"
+#include "evdevpp/info.h"
+
+namespace evdevpp {
+
+// A rule to select devices, e.g., "has `BTN_SOUTH` and `ABS_X`, vendor
+// 0x045e". A device matches if it has all the `required` capabilities (as
+// in `CapabilitiesInfo::HasCapabilities`) and all the set identity fields
+// are equal.
+struct DeviceQuery {
+  CapabilitiesInfo required;
+  std::optional<std::uint16_t> bustype;
+  std::optional<std::uint16_t> vendor;
+  std::optional<std::uint16_t> product;
+  std::optional<std::uint16_t> version;
+};
+
+// A registry of open input devices indexed by capability.
+//
+// For every (event type, event code) pair and every identity field value,
+// the index keeps a posting list as a bitset over device ids. A query is
+// resolved by AND-ing the postings of its terms, so its cost depends on the
+// number of terms and devices / 64, not on the size of the capability sets.
+//
+// The index is updated incrementally, which makes it a natural companion to
+// `HotplugMonitor`:
+//
+//   DeviceIndex index;
+//   auto monitor_or = HotplugMonitor::Create({
+//       .on_added = [&](const InputDevice& dev) { index.Add(dev); },
+//       .on_removed = [&](const InputDevice& dev) {
+//         index.Remove(dev.DevPath());
+//       }});
+//   DeviceQuery gamepad;
+//   gamepad.required.keys = {Button::kSouth};
+//   gamepad.required.absolute_axes = {{AbsoluteAxis::kX, {}}};
+//   gamepad.vendor = 0x045e;
+//   for (auto id : index.Match(gamepad)) { ... index.Get(id) ... }
+class DeviceIndex {
+ public:
+  using DeviceId = std::uint32_t;
+
+  // Add a device, replacing any device with the same path, and return its
+  // id. Ids of removed devices are reused.
+  DeviceId Add(const InputDevice& device);
+
+  // Remove a device. Returns false if it was not in the index.
+  bool Remove(DeviceId id);
+  bool Remove(const std::string& dev_path);
+
+  // Return the device with the given id, or nullptr.
+  [[nodiscard]] const InputDevice* Get(DeviceId id) const;
+  // Return the id of the device at `dev_path`, if any.
+  [[nodiscard]] std::optional<DeviceId> Find(const std::string& dev_path) const;
+
+  [[nodiscard]] std::size_t Size() const { return by_path_.size(); }
+
+  // Return the ids of all devices matching `query`, in increasing order.
+  [[nodiscard]] std::vector<DeviceId> Match(const DeviceQuery& query) const;
+
+  // Same as `Match`, reusing the storage of `result`.
+  void Match(const DeviceQuery& query, std::vector<DeviceId>* result) const;
+
+ private:
+  using Bitset = std::vector<std::uint64_t>;
+
+  void SetPosting(std::uint64_t key, DeviceId id);
+  void ClearPosting(std::uint64_t key, DeviceId id);
+  // AND the posting for `key` into `acc`. Returns false if `acc` is empty
+  // as a result.
+  bool Intersect(std::uint64_t key, Bitset& acc) const;
+
+  std::vector<std::optional<InputDevice>> devices_;
+  std::vector<DeviceId> free_ids_;
+  Bitset live_;
+  absl::flat_hash_map<std::uint64_t, Bitset> postings_;
+  absl::flat_hash_map<std::string, DeviceId> by_path_;
+};
+
+}  // namespace evdevpp
+
+#endif  // EVDEVPP_EVDEVPP_DEVICE_INDEX_H_
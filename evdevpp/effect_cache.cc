@@ -0,0 +1,269 @@
+#include "evdevpp/effect_cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+#include "linux/input.h"
+
+namespace evdevpp {
+
+namespace {
+
+// Append the bytes of `value`, which must have no padding.
+template <typename T>
+void AppendBytes(std::string& key, const T& value) {
+  static_assert(std::has_unique_object_representations_v<T>);
+  key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+}  // namespace
+
+EffectCache::EffectCache(const InputDevice& device, const Options& options)
+    : device_(&device) {
+  const auto slot_count =
+      static_cast<std::size_t>(std::max(device.FFEffectsCount(), 0));
+  slots_.resize(slot_count);
+  capacity_ = slot_count;
+  if (options.max_slots != 0) {
+    capacity_ = std::min(capacity_, options.max_slots);
+  }
+}
+
+std::string EffectCache::ContentKey(const AnyEffect& effect) {
+  ff_effect data{};
+  effect.ToData(&data);
+  std::string key;
+  key.reserve(64);
+  AppendBytes(key, data.type);
+  AppendBytes(key, data.direction);
+  AppendBytes(key, data.trigger);
+  AppendBytes(key, data.replay);
+  // NOLINTBEGIN(cppcoreguidelines-pro-type-union-access)
+  switch (data.type) {
+    case FF_CONSTANT:
+      AppendBytes(key, data.u.constant);
+      break;
+    case FF_RAMP:
+      AppendBytes(key, data.u.ramp);
+      break;
+    case FF_PERIODIC: {
+      // Field by field, the structure has padding.
+      const ff_periodic_effect& periodic = data.u.periodic;
+      AppendBytes(key, periodic.waveform);
+      AppendBytes(key, periodic.period);
+      AppendBytes(key, periodic.magnitude);
+      AppendBytes(key, periodic.offset);
+      AppendBytes(key, periodic.phase);
+      AppendBytes(key, periodic.envelope);
+      if (periodic.waveform == FF_CUSTOM && periodic.custom_data != nullptr) {
+        AppendBytes(key, periodic.custom_len);
+        key.append(reinterpret_cast<const char*>(periodic.custom_data),
+                   periodic.custom_len * sizeof(std::int16_t));
+      }
+      break;
+    }
+    case FF_RUMBLE:
+      AppendBytes(key, data.u.rumble);
+      break;
+    default:
+      // Condition effects (and `InertiaEffect`, which shares the bytes of
+      // the constant effect).
+      AppendBytes(key, data.u.condition);
+      break;
+  }
+  // NOLINTEND(cppcoreguidelines-pro-type-union-access)
+  return key;
+}
+
+absl::StatusOr<std::int16_t> EffectCache::Acquire(const AnyEffect& effect) {
+  std::string key = ContentKey(effect);
+  if (auto it = by_content_.find(key); it != by_content_.end()) {
+    ++stats_.hits;
+    slots_[it->second].last_used = ++clock_;
+    return it->second;
+  }
+  auto id_or = Upload(effect);
+  if (!id_or.ok()) {
+    return id_or.status();
+  }
+  slots_[*id_or].key = key;
+  by_content_.emplace(std::move(key), *id_or);
+  return *id_or;
+}
+
+absl::StatusOr<std::int16_t> EffectCache::Set(std::uint64_t tag,
+                                              const AnyEffect& effect) {
+  if (auto it = by_tag_.find(tag); it != by_tag_.end()) {
+    const std::int16_t id = it->second;
+    Slot& slot = slots_[id];
+    std::string key = ContentKey(effect);
+    if (key == slot.key) {
+      ++stats_.hits;
+      slot.last_used = ++clock_;
+      return id;
+    }
+    if (slot.type == effect.Base().Type()) {
+      AnyEffect updated = effect;
+      updated.Base().id = id;
+      if (auto st = device_->UpdateEffect(updated); !st.ok()) {
+        return st;
+      }
+      ++stats_.updates;
+      slot.key = std::move(key);
+      slot.last_used = ++clock_;
+      return id;
+    }
+    // The kernel does not change the type of an uploaded effect.
+    if (auto st = Erase(id); !st.ok()) {
+      return st;
+    }
+  }
+  auto id_or = Upload(effect);
+  if (!id_or.ok()) {
+    return id_or.status();
+  }
+  Slot& slot = slots_[*id_or];
+  slot.tagged = true;
+  slot.tag = tag;
+  slot.key = ContentKey(effect);
+  by_tag_[tag] = *id_or;
+  return *id_or;
+}
+
+absl::Status EffectCache::Play(std::int16_t id, std::int32_t count) {
+  if (!IsLive(id)) {
+    return absl::NotFoundError("No effect with this id in the cache");
+  }
+  slots_[id].last_used = ++clock_;
+  return device_->Write(EventType::kFf, static_cast<std::uint16_t>(id),
+                        count);
+}
+
+absl::Status EffectCache::Stop(std::int16_t id) {
+  if (!IsLive(id)) {
+    return absl::NotFoundError("No effect with this id in the cache");
+  }
+  return device_->Write(EventType::kFf, static_cast<std::uint16_t>(id), 0);
+}
+
+absl::Status EffectCache::Pin(std::int16_t id) {
+  if (!IsLive(id)) {
+    return absl::NotFoundError("No effect with this id in the cache");
+  }
+  Slot& slot = slots_[id];
+  ++slot.pins;
+  slot.last_used = ++clock_;
+  return absl::OkStatus();
+}
+
+void EffectCache::Unpin(std::int16_t id) {
+  if (IsLive(id) && slots_[id].pins > 0) {
+    --slots_[id].pins;
+  }
+}
+
+absl::Status EffectCache::Erase(std::int16_t id) {
+  if (!IsLive(id)) {
+    return absl::NotFoundError("No effect with this id in the cache");
+  }
+  // Forget the slot even if the erase fails, the device most likely lost
+  // the effect (or is gone).
+  absl::Status st = device_->EraseEffect(id);
+  Forget(id);
+  return st;
+}
+
+absl::Status EffectCache::EraseTag(std::uint64_t tag) {
+  auto it = by_tag_.find(tag);
+  if (it == by_tag_.end()) {
+    return absl::NotFoundError("No effect with this tag in the cache");
+  }
+  return Erase(it->second);
+}
+
+void EffectCache::Clear() {
+  for (std::size_t id = 0; id < slots_.size(); ++id) {
+    if (slots_[id].live) {
+      (void)Erase(static_cast<std::int16_t>(id));
+    }
+  }
+}
+
+std::vector<std::int16_t> EffectCache::LiveIds() const {
+  std::vector<std::int16_t> result;
+  result.reserve(live_count_);
+  for (std::size_t id = 0; id < slots_.size(); ++id) {
+    if (slots_[id].live) {
+      result.push_back(static_cast<std::int16_t>(id));
+    }
+  }
+  return result;
+}
+
+absl::StatusOr<std::int16_t> EffectCache::Upload(const AnyEffect& effect) {
+  if (capacity_ == 0) {
+    return absl::FailedPreconditionError("Device has no effect slots");
+  }
+  if (live_count_ >= capacity_) {
+    if (auto st = EvictOne(); !st.ok()) {
+      return st;
+    }
+  }
+  auto id_or = device_->NewEffect(effect);
+  if (!id_or.ok() && absl::IsResourceExhausted(id_or.status()) &&
+      live_count_ > 0) {
+    // ENOSPC, the device has fewer free slots than accounted for (e.g.,
+    // effects uploaded outside of the cache). Make room and retry once.
+    if (auto st = EvictOne(); !st.ok()) {
+      return st;
+    }
+    id_or = device_->NewEffect(effect);
+  }
+  if (!id_or.ok()) {
+    return id_or.status();
+  }
+  const std::int16_t id = *id_or;
+  if (id < 0 || static_cast<std::size_t>(id) >= slots_.size()) {
+    (void)device_->EraseEffect(id);
+    return absl::InternalError("Device returned an out of range effect id");
+  }
+  ++stats_.uploads;
+  Slot& slot = slots_[id];
+  slot = Slot{};
+  slot.live = true;
+  slot.type = effect.Base().Type();
+  slot.last_used = ++clock_;
+  ++live_count_;
+  return id;
+}
+
+absl::Status EffectCache::EvictOne() {
+  std::int16_t victim = -1;
+  for (std::size_t id = 0; id < slots_.size(); ++id) {
+    const Slot& slot = slots_[id];
+    if (slot.live && slot.pins == 0 &&
+        (victim < 0 || slot.last_used < slots_[victim].last_used)) {
+      victim = static_cast<std::int16_t>(id);
+    }
+  }
+  if (victim < 0) {
+    return absl::ResourceExhaustedError("No effect to evict");
+  }
+  ++stats_.evictions;
+  return Erase(victim);
+}
+
+void EffectCache::Forget(std::int16_t id) {
+  Slot& slot = slots_[id];
+  if (slot.tagged) {
+    by_tag_.erase(slot.tag);
+  } else {
+    by_content_.erase(slot.key);
+  }
+  slot = Slot{};
+  --live_count_;
+}
+
+}  // namespace evdevpp
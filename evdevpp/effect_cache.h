@@ -0,0 +1,132 @@
+#ifndef EVDEVPP_EVDEVPP_EFFECT_CACHE_H_
+#define EVDEVPP_EVDEVPP_EFFECT_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "evdevpp/device.h"
+#include "evdevpp/info.h"
+
+namespace evdevpp {
+
+// Manages the force feedback effect slots of a device.
+//
+// A device only has `FFEffectsCount()` slots, and `InputDevice::NewEffect`
+// takes a new one on every call. The cache uploads each distinct effect
+// once (effects are compared by content, ignoring their id) and hands out
+// the same id when the same effect is asked for again. When the slots run
+// out, the least recently played effect is erased to make room, except for
+// pinned effects.
+//
+// Effects that change over time (e.g., an engine rumble following the
+// revs) are uploaded under a tag with `Set`, which updates the effect in
+// place (`EVIOCSFF` on the same id) as long as its type does not change.
+//
+//   EffectCache cache(pad);
+//   auto id_or = cache.Acquire(AnyEffect{hit_rumble});
+//   if (id_or.ok()) (void)cache.Play(*id_or);
+//
+// All effects must be uploaded through the cache (not `NewEffect`) for its
+// slot accounting to hold.
+class EffectCache {
+ public:
+  struct Options {
+    // Number of slots the cache may use, 0 for all of the device's.
+    std::size_t max_slots = 0;
+  };
+  // Work-around for GCC/Clang bug.
+  static Options Defaults() { return Options{}; }
+
+  struct Stats {
+    // Effects found already uploaded.
+    std::uint64_t hits = 0;
+    std::uint64_t uploads = 0;
+    // In-place updates of tagged effects.
+    std::uint64_t updates = 0;
+    std::uint64_t evictions = 0;
+  };
+
+  // `device` must outlive the cache.
+  explicit EffectCache(const InputDevice& device,
+                       const Options& options = Defaults());
+
+  // The id of an uploaded effect with the same content as `effect`,
+  // uploading it if needed.
+  absl::StatusOr<std::int16_t> Acquire(const AnyEffect& effect);
+
+  // Upload `effect` as the effect of `tag`, replacing the previous effect of
+  // `tag` (in place if it has the same type). Returns its id, which stays
+  // the same across updates unless the effect was evicted.
+  absl::StatusOr<std::int16_t> Set(std::uint64_t tag, const AnyEffect& effect);
+
+  // Play effect `id` `count` times, or stop it.
+  absl::Status Play(std::int16_t id, std::int32_t count = 1);
+  absl::Status Stop(std::int16_t id);
+
+  // Keep effect `id` from being evicted until `Unpin` is called as many
+  // times, e.g., while it is played by events written outside of the cache.
+  absl::Status Pin(std::int16_t id);
+  void Unpin(std::int16_t id);
+
+  // Erase effect `id` (or the effect of `tag`) from the device.
+  absl::Status Erase(std::int16_t id);
+  absl::Status EraseTag(std::uint64_t tag);
+  // Erase all the effects uploaded through the cache, and only those.
+  void Clear();
+
+  // The ids of the effects uploaded through the cache.
+  [[nodiscard]] std::vector<std::int16_t> LiveIds() const;
+  [[nodiscard]] std::size_t Size() const { return live_count_; }
+  [[nodiscard]] std::size_t Capacity() const { return capacity_; }
+  [[nodiscard]] const Stats& GetStats() const { return stats_; }
+  [[nodiscard]] const InputDevice& Device() const { return *device_; }
+
+  // A byte string identifying the content of `effect` (all the fields that
+  // matter to the device, except the id). Custom waveforms are included
+  // sample by sample.
+  static std::string ContentKey(const AnyEffect& effect);
+
+ private:
+  struct Slot {
+    bool live = false;
+    bool tagged = false;
+    std::uint64_t tag = 0;
+    ForceFeedback type{};
+    // The content key of the effect. Untagged effects are found by it in
+    // `by_content_`.
+    std::string key;
+    // Value of `clock_` when last played or acquired.
+    std::uint64_t last_used = 0;
+    // Not evicted while pinned.
+    std::uint32_t pins = 0;
+  };
+
+  // Upload `effect` in a new slot, evicting as needed.
+  absl::StatusOr<std::int16_t> Upload(const AnyEffect& effect);
+  // Erase the least recently used effect that is not pinned.
+  absl::Status EvictOne();
+  void Forget(std::int16_t id);
+  [[nodiscard]] bool IsLive(std::int16_t id) const {
+    return id >= 0 && static_cast<std::size_t>(id) < slots_.size() &&
+           slots_[id].live;
+  }
+
+  const InputDevice* device_;
+  std::size_t capacity_ = 0;
+  std::size_t live_count_ = 0;
+  std::uint64_t clock_ = 0;
+  // Indexed by effect id.
+  std::vector<Slot> slots_;
+  absl::flat_hash_map<std::string, std::int16_t> by_content_;
+  absl::flat_hash_map<std::uint64_t, std::int16_t> by_tag_;
+  Stats stats_;
+};
+
+}  // namespace evdevpp
+
+#endif  // EVDEVPP_EVDEVPP_EFFECT_CACHE_H_
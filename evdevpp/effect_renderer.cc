@@ -0,0 +1,384 @@
+#include "evdevpp/effect_renderer.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+namespace evdevpp {
+
+namespace {
+
+constexpr float kLevelScale = 1.0F / 0x7fff;
+constexpr float kRumbleScale = 1.0F / 0xffff;
+constexpr std::int64_t kForever = std::numeric_limits<std::int64_t>::max();
+// Samples rendered at a time per effect.
+constexpr std::size_t kChunk = 256;
+
+float EnvelopeLevel(std::uint16_t level) {
+  return std::min<std::uint16_t>(level, 0x7fff) * kLevelScale;
+}
+
+// The kernels below avoid comparisons on floats, GCC does not vectorize
+// selects on them under the default -ftrapping-math.
+
+// min(value, 1).
+inline float MinOne(float value) {
+  return 0.5F * (value + 1.0F - std::fabs(value - 1.0F));
+}
+
+// clamp(value, -1, 1).
+inline float ClampOne(float value) {
+  return 0.5F * (std::fabs(value + 1.0F) - std::fabs(value - 1.0F));
+}
+
+// sin(2 pi u) for u in [0, 1), within 0.001.
+inline float FastSin(float u) {
+  const float x = 0.5F - u;
+  const float y = 8.0F * x - 16.0F * x * std::fabs(x);
+  return 0.225F * (y * std::fabs(y) - y) + y;
+}
+
+// Fractional part of a non-negative value (floor is not vectorized without
+// SSE4.1).
+inline float Fraction(float value) {
+  return value - static_cast<float>(static_cast<std::int32_t>(value));
+}
+
+// Call `body(i)` for `i` in [0, n). Blocks of a fixed number of samples are
+// vectorized at -O2 (which does not vectorize loops that need a remainder
+// loop), the remainder is scalar. Indices are signed 32-bit, which convert
+// to float without branches.
+constexpr std::int32_t kLanes = 8;
+template <typename Body>
+inline void ForEachSample(std::size_t n, Body body) {
+  const auto count = static_cast<std::int32_t>(n);
+  const std::int32_t blocked = count - count % kLanes;
+  for (std::int32_t base = 0; base < blocked; base += kLanes) {
+    for (std::int32_t lane = 0; lane < kLanes; ++lane) {
+      body(base + lane);
+    }
+  }
+  for (std::int32_t i = blocked; i < count; ++i) {
+    body(i);
+  }
+}
+
+}  // namespace
+
+EffectRenderer::EffectRenderer(const Options& options)
+    : options_(options), samples_per_ms_(options.sample_rate_hz / 1000.0) {}
+
+absl::Status EffectRenderer::Upload(const AnyEffect& effect) {
+  const Effect& base = effect.Base();
+  const ForceFeedback type = base.Type();
+  Params params;
+  const auto to_samples = [this](absl::Duration d) {
+    return static_cast<std::int64_t>(
+        std::llround(absl::ToDoubleMilliseconds(d) * samples_per_ms_));
+  };
+  // 0x0000 is down, 0x4000 left.
+  const double angle = base.direction * (2.0 * M_PI / 0x10000);
+  params.dx = static_cast<float>(-std::sin(angle));
+  params.dy = static_cast<float>(std::cos(angle));
+  params.delay = to_samples(base.replay.delay);
+  params.length = to_samples(base.replay.length);
+
+  const Envelope* envelope = nullptr;
+  if (type == ForceFeedback::kConstant) {
+    const auto& constant = effect.As<ConstantEffect>();
+    params.kind = Kind::kConstant;
+    params.level0 = constant.level * kLevelScale;
+    envelope = &constant.envelope;
+  } else if (type == ForceFeedback::kRamp) {
+    const auto& ramp = effect.As<RampEffect>();
+    params.kind = Kind::kRamp;
+    params.level0 = ramp.start_level * kLevelScale;
+    params.level1 = ramp.end_level * kLevelScale;
+    envelope = &ramp.envelope;
+  } else if (type == ForceFeedback::kPeriodic) {
+    const auto& periodic = effect.As<PeriodicEffect>();
+    params.kind = Kind::kPeriodic;
+    params.waveform = periodic.waveform;
+    params.level0 = periodic.magnitude * kLevelScale;
+    params.level1 = periodic.offset * kLevelScale;
+    const double period = absl::ToDoubleMilliseconds(periodic.period);
+    params.frequency = period > 0.0 ? 1.0 / (period * samples_per_ms_) : 0.0;
+    params.phase = periodic.phase / 65536.0;
+    if (periodic.waveform == ForceFeedback::kCustom) {
+      if (periodic.custom.Empty()) {
+        return absl::InvalidArgumentError("Custom effect without samples");
+      }
+      const auto samples = periodic.custom.Samples();
+      params.custom.assign(samples.begin(), samples.end());
+      for (float& sample : params.custom) {
+        sample *= kLevelScale;
+      }
+    }
+    envelope = &periodic.envelope;
+  } else if (type == ForceFeedback::kRumble) {
+    const auto& rumble = effect.As<RumbleEffect>();
+    params.kind = Kind::kRumble;
+    params.level0 = rumble.strong_magnitude * kRumbleScale;
+    params.level1 = rumble.weak_magnitude * kRumbleScale;
+  } else {
+    return absl::UnimplementedError(
+        "Only constant, ramp, periodic and rumble effects are rendered");
+  }
+
+  if (envelope != nullptr) {
+    // The attack ramp is `min(t * attack_scale + attack_bias, 1)`, and the
+    // fade ramp `min((length - t) * fade_scale + fade_bias, 1)`. Without
+    // attack or fade, the bias keeps the ramp at 1.
+    const std::int64_t attack = to_samples(envelope->attack_length);
+    if (attack > 0) {
+      params.attack_level = EnvelopeLevel(envelope->attack_level);
+      params.attack_scale = 1.0F / static_cast<float>(attack);
+      params.attack_bias = 0.0F;
+    }
+    const std::int64_t fade = to_samples(envelope->fade_length);
+    if (fade > 0 && params.length > 0) {
+      params.fade_level = EnvelopeLevel(envelope->fade_level);
+      params.fade_scale = 1.0F / static_cast<float>(fade);
+      params.fade_bias = 0.0F;
+    }
+  }
+  effects_[base.id] = std::move(params);
+  return absl::OkStatus();
+}
+
+void EffectRenderer::Erase(std::int16_t id) {
+  Stop(id);
+  effects_.erase(id);
+}
+
+absl::Status EffectRenderer::Play(std::int16_t id, std::int32_t count) {
+  auto it = effects_.find(id);
+  if (it == effects_.end()) {
+    return absl::NotFoundError("No effect with this id");
+  }
+  if (count <= 0) {
+    Stop(id);
+    return absl::OkStatus();
+  }
+  for (auto& voice : voices_) {
+    if (voice.id == id) {
+      voice.start = position_ + it->second.delay;
+      voice.remaining = count;
+      return absl::OkStatus();
+    }
+  }
+  voices_.push_back(
+      {.id = id, .start = position_ + it->second.delay, .remaining = count});
+  return absl::OkStatus();
+}
+
+void EffectRenderer::Stop(std::int16_t id) {
+  voices_.erase(std::remove_if(voices_.begin(), voices_.end(),
+                               [id](const Voice& v) { return v.id == id; }),
+                voices_.end());
+}
+
+void EffectRenderer::HandleEvent(const input_event& event) {
+  if (event.type != EV_FF) {
+    return;
+  }
+  if (event.code == FF_GAIN) {
+    SetGain(static_cast<std::uint16_t>(event.value));
+  } else if (event.code < FF_MAX_EFFECTS) {
+    // Play or stop effect `code`, unknown ids are ignored as by the kernel.
+    (void)Play(static_cast<std::int16_t>(event.code), event.value);
+  }
+}
+
+void EffectRenderer::RenderLevels(const Params& params, std::int64_t t0,
+                                  std::size_t n, float* out) {
+  const auto t_base = static_cast<float>(t0);
+  const auto length = static_cast<float>(params.length);
+  // The magnitude through the envelope: the attack ramp from its level at
+  // the start, then the fade ramp to its level at the end (applied to the
+  // attack when they overlap). Copied to locals, which `out` cannot alias.
+  const float attack_level = params.attack_level;
+  const float attack_scale = params.attack_scale;
+  const float attack_bias = params.attack_bias;
+  const float fade_level = params.fade_level;
+  const float fade_scale = params.fade_scale;
+  const float fade_bias = params.fade_bias;
+  const auto envelope = [=](float t, float magnitude) {
+    const float ta = MinOne(t * attack_scale + attack_bias);
+    const float tf = MinOne((length - t) * fade_scale + fade_bias);
+    const float attack = attack_level + (magnitude - attack_level) * ta;
+    return fade_level + (attack - fade_level) * tf;
+  };
+
+  switch (params.kind) {
+    case Kind::kConstant: {
+      const float level = params.level0;
+      const float magnitude = std::fabs(level);
+      ForEachSample(n, [=](std::int32_t i) {
+        const float t = t_base + static_cast<float>(i);
+        out[i] = std::copysign(envelope(t, magnitude), level);
+      });
+      break;
+    }
+    case Kind::kRamp: {
+      const float start = params.level0;
+      const float slope =
+          params.length > 0 ? (params.level1 - params.level0) / length : 0.0F;
+      ForEachSample(n, [=](std::int32_t i) {
+        const float t = t_base + static_cast<float>(i);
+        const float level = start + slope * t;
+        out[i] = std::copysign(envelope(t, std::fabs(level)), level);
+      });
+      break;
+    }
+    case Kind::kPeriodic: {
+      // Phase at the first sample in double, so that long effects do not
+      // drift, then in float within the buffer.
+      double start = t0 * params.frequency + params.phase;
+      start -= std::floor(start);
+      const auto turns0 = static_cast<float>(start);
+      const auto frequency = static_cast<float>(params.frequency);
+      const float level = params.level0;
+      const float magnitude = std::fabs(level);
+      const float offset = params.level1;
+      // One loop per waveform, so that each vectorizes.
+      const auto fill = [=](auto wave) {
+        ForEachSample(n, [=](std::int32_t i) {
+          const float t = t_base + static_cast<float>(i);
+          const float u =
+              Fraction(turns0 + frequency * static_cast<float>(i));
+          out[i] =
+              offset + std::copysign(envelope(t, magnitude), level) * wave(u);
+        });
+      };
+      const ForceFeedback waveform = params.waveform;
+      if (waveform == ForceFeedback::kSquare) {
+        fill([](float u) { return std::copysign(1.0F, 0.5F - u); });
+      } else if (waveform == ForceFeedback::kTriangle) {
+        fill([](float u) {
+          return 1.0F - 4.0F * std::fabs(Fraction(u + 0.25F) - 0.5F);
+        });
+      } else if (waveform == ForceFeedback::kSine) {
+        fill([](float u) { return FastSin(u); });
+      } else if (waveform == ForceFeedback::kSawUp) {
+        fill([](float u) { return 2.0F * u - 1.0F; });
+      } else if (waveform == ForceFeedback::kSawDown) {
+        fill([](float u) { return 1.0F - 2.0F * u; });
+      } else if (waveform == ForceFeedback::kCustom) {
+        // Linear interpolation between the samples, wrapping around (a
+        // gather, which is not vectorized).
+        const float* custom = params.custom.data();
+        const std::size_t size = params.custom.size();
+        const auto scale = static_cast<float>(size);
+        fill([=](float u) {
+          const float pos = u * scale;
+          const auto index = static_cast<std::size_t>(pos);
+          const float frac = pos - static_cast<float>(index);
+          const float a = custom[index % size];
+          const float b = custom[(index + 1) % size];
+          return a + (b - a) * frac;
+        });
+      } else {
+        std::fill(out, out + n, offset);
+      }
+      break;
+    }
+    case Kind::kRumble:
+      break;
+  }
+}
+
+absl::Status EffectRenderer::Render(const Channels& channels) {
+  std::size_t n = 0;
+  for (auto channel : {channels.force_x, channels.force_y, channels.strong,
+                       channels.weak}) {
+    if (channel.empty()) {
+      continue;
+    }
+    if (n != 0 && channel.size() != n) {
+      return absl::InvalidArgumentError(
+          "Render channels must have the same length");
+    }
+    n = channel.size();
+  }
+  for (auto channel : {channels.force_x, channels.force_y, channels.strong,
+                       channels.weak}) {
+    std::fill(channel.begin(), channel.end(), 0.0F);
+  }
+
+  const std::int64_t end = position_ + static_cast<std::int64_t>(n);
+  for (auto& voice : voices_) {
+    const Params& params = effects_.at(voice.id);
+    // Render each repetition that overlaps the buffer.
+    while (voice.remaining > 0 && voice.start < end) {
+      const std::int64_t stop =
+          params.length > 0 ? voice.start + params.length : kForever;
+      const std::int64_t from = std::max(voice.start, position_);
+      const std::int64_t to = std::min(stop, end);
+      if (from < to) {
+        const auto offset = static_cast<std::size_t>(from - position_);
+        const auto count = static_cast<std::size_t>(to - from);
+        if (params.kind == Kind::kRumble) {
+          const float strong = gain_ * params.level0;
+          const float weak = gain_ * params.level1;
+          if (!channels.strong.empty()) {
+            float* s = channels.strong.data() + offset;
+            ForEachSample(count, [=](std::int32_t i) { s[i] += strong; });
+          }
+          if (!channels.weak.empty()) {
+            float* w = channels.weak.data() + offset;
+            ForEachSample(count, [=](std::int32_t i) { w[i] += weak; });
+          }
+        } else {
+          // In chunks on the stack, which the channels cannot alias.
+          std::array<float, kChunk> levels;
+          const float gx = gain_ * params.dx;
+          const float gy = gain_ * params.dy;
+          for (std::size_t done = 0; done < count; done += kChunk) {
+            const std::size_t size = std::min(count - done, kChunk);
+            RenderLevels(params,
+                         from - voice.start + static_cast<std::int64_t>(done),
+                         size, levels.data());
+            if (!channels.force_x.empty()) {
+              float* x = channels.force_x.data() + offset + done;
+              ForEachSample(size,
+                            [&](std::int32_t i) { x[i] += gx * levels[i]; });
+            }
+            if (!channels.force_y.empty()) {
+              float* y = channels.force_y.data() + offset + done;
+              ForEachSample(size,
+                            [&](std::int32_t i) { y[i] += gy * levels[i]; });
+            }
+          }
+        }
+      }
+      if (stop > end) {
+        break;
+      }
+      // Next repetition.
+      --voice.remaining;
+      voice.start = stop + params.delay;
+    }
+  }
+  voices_.erase(std::remove_if(voices_.begin(), voices_.end(),
+                               [](const Voice& v) { return v.remaining <= 0; }),
+                voices_.end());
+  position_ = end;
+
+  for (auto channel : {channels.force_x, channels.force_y}) {
+    float* samples = channel.data();
+    ForEachSample(channel.size(), [=](std::int32_t i) {
+      samples[i] = ClampOne(samples[i]);
+    });
+  }
+  for (auto channel : {channels.strong, channels.weak}) {
+    float* samples = channel.data();
+    ForEachSample(channel.size(), [=](std::int32_t i) {
+      samples[i] = MinOne(samples[i]);
+    });
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace evdevpp
@@ -0,0 +1,135 @@
+#ifndef EVDEVPP_EVDEVPP_EFFECT_RENDERER_H_
+#define EVDEVPP_EVDEVPP_EFFECT_RENDERER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/types/span.h"
+#include "evdevpp/ecodes.h"
+#include "evdevpp/info.h"
+#include "linux/input.h"
+
+namespace evdevpp {
+
+// Renders force feedback effects into sampled waveforms, e.g., for virtual
+// devices whose effects are played by something other than a local
+// actuator.
+//
+// Effects are uploaded, played and stopped as on a device (or straight from
+// the `EV_FF` events written to a `UserInputDevice`, see `HandleEvent`), and
+// `Render` produces the mix of all the playing effects, one sample at a
+// time on four channels:
+//  - `force_x` and `force_y`, in [-1, 1]: the constant, ramp and periodic
+//    effects along their direction (0x0000 is down (+y), 0x4000 is left
+//    (-x)).
+//  - `strong` and `weak`, in [0, 1]: the motors of the rumble effects.
+//
+// The timing follows the kernel's memoryless emulation: each repetition of
+// an effect starts `replay.delay` after the previous one ended and lasts
+// `replay.length` (forever if zero), the envelope attacks from its level at
+// the start and fades to its level at the end, and `FF_GAIN` scales
+// everything. Periodic effects start their period at the start of each
+// repetition, shifted by `phase` (a fraction of the period, 0x10000 being a
+// full period), and custom waveforms are played once per period, with
+// samples scaled by the magnitude. Condition effects depend on the position
+// of the device and are not rendered.
+//
+// Each effect is rendered a chunk of samples at a time and mixed in, with
+// branch-free loops that the compiler vectorizes.
+class EffectRenderer {
+ public:
+  struct Options {
+    double sample_rate_hz = 1000.0;
+  };
+  // Work-around for GCC/Clang bug.
+  static Options Defaults() { return Options{}; }
+
+  // Output buffers of `Render`. Empty channels are not rendered.
+  struct Channels {
+    absl::Span<float> force_x;
+    absl::Span<float> force_y;
+    absl::Span<float> strong;
+    absl::Span<float> weak;
+  };
+
+  explicit EffectRenderer(const Options& options = Defaults());
+
+  // Store `effect` under its id, replacing (even while it plays) the effect
+  // with the same id.
+  absl::Status Upload(const AnyEffect& effect);
+  void Erase(std::int16_t id);
+
+  // Play effect `id` `count` times from the next sample rendered, or stop
+  // it.
+  absl::Status Play(std::int16_t id, std::int32_t count = 1);
+  void Stop(std::int16_t id);
+  // Overall gain, as `FF_GAIN` (0xFFFF is full scale).
+  void SetGain(std::uint16_t gain) { gain_ = gain / 65535.0F; }
+
+  // Apply an `EV_FF` event (play, stop or `FF_GAIN`), ignoring other events.
+  void HandleEvent(const input_event& event);
+
+  // Render the next samples, as many as the channels are long (they must
+  // all have the same length).
+  absl::Status Render(const Channels& channels);
+
+  // Number of samples rendered so far.
+  [[nodiscard]] std::int64_t Position() const { return position_; }
+  [[nodiscard]] std::size_t PlayingCount() const { return voices_.size(); }
+
+ private:
+  enum class Kind : std::uint8_t { kConstant, kRamp, kPeriodic, kRumble };
+
+  // An effect converted to samples and unit levels.
+  struct Params {
+    Kind kind = Kind::kConstant;
+    ForceFeedback waveform{};
+    // Unit vector of the direction.
+    float dx = 0.0F;
+    float dy = 0.0F;
+    std::int64_t delay = 0;
+    // 0 for infinite.
+    std::int64_t length = 0;
+    // Levels: constant level, or ramp start and end, or periodic magnitude
+    // and offset, or rumble strong and weak.
+    float level0 = 0.0F;
+    float level1 = 0.0F;
+    // Envelope, as `min(t * scale + bias, 1)` ramps, see `Render`.
+    float attack_level = 0.0F;
+    float attack_scale = 1.0F;
+    float attack_bias = 1.0F;
+    float fade_level = 0.0F;
+    float fade_scale = 0.0F;
+    float fade_bias = 1.0F;
+    // Periodic: periods per sample, and phase in periods.
+    double frequency = 0.0;
+    double phase = 0.0;
+    std::vector<float> custom;
+  };
+
+  struct Voice {
+    std::int16_t id = 0;
+    // Start of the current repetition.
+    std::int64_t start = 0;
+    std::int32_t remaining = 0;
+  };
+
+  // Write the signed level of `params` for `n` samples from `t0` samples
+  // into a repetition, to `out`.
+  static void RenderLevels(const Params& params, std::int64_t t0,
+                           std::size_t n, float* out);
+
+  Options options_;
+  double samples_per_ms_ = 1.0;
+  float gain_ = 1.0F;
+  std::int64_t position_ = 0;
+  absl::flat_hash_map<std::int16_t, Params> effects_;
+  std::vector<Voice> voices_;
+};
+
+}  // namespace evdevpp
+
+#endif  // EVDEVPP_EVDEVPP_EFFECT_RENDERER_H_
@@ -0,0 +1,111 @@
+// Throughput of EffectRenderer, in mixed samples per second (items) and
+// effect-samples per second (effects times samples).
+//
+//   bazel run -c opt //evdevpp:effect_renderer_benchmark
+
+#include <cstdint>
+#include <vector>
+
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "benchmark/benchmark.h"
+#include "evdevpp/effect_renderer.h"
+#include "evdevpp/info.h"
+
+namespace evdevpp {
+namespace {
+
+constexpr std::size_t kBufferSize = 4096;
+
+PeriodicEffect Periodic(std::int16_t id, ForceFeedback waveform) {
+  PeriodicEffect effect;
+  effect.id = id;
+  effect.waveform = waveform;
+  effect.period = absl::Milliseconds(20 + id);
+  effect.magnitude = 0x1000;
+  effect.direction = static_cast<std::uint16_t>(id * 0x800);
+  if (waveform == ForceFeedback::kCustom) {
+    const std::vector<std::int16_t> samples = {0, 0x7fff, 0x1000, -0x7fff,
+                                               -0x1000};
+    effect.custom = CustomWaveform(samples);
+  }
+  return effect;
+}
+
+void RenderLoop(benchmark::State& state, EffectRenderer& renderer,
+                std::int64_t effects) {
+  std::vector<float> x(kBufferSize);
+  std::vector<float> y(kBufferSize);
+  for (auto _ : state) {
+    (void)renderer.Render(
+        {.force_x = absl::MakeSpan(x), .force_y = absl::MakeSpan(y)});
+    benchmark::DoNotOptimize(x.data());
+    benchmark::DoNotOptimize(y.data());
+  }
+  const auto samples =
+      static_cast<std::int64_t>(state.iterations() * kBufferSize);
+  state.SetItemsProcessed(samples);
+  state.counters["effect_samples"] = benchmark::Counter(
+      static_cast<double>(samples * effects), benchmark::Counter::kIsRate);
+}
+
+// A mix of `range(0)` sine and triangle effects.
+void BM_RenderPeriodicMix(benchmark::State& state) {
+  EffectRenderer renderer;
+  const auto effects = static_cast<std::int16_t>(state.range(0));
+  for (std::int16_t id = 0; id < effects; ++id) {
+    (void)renderer.Upload(AnyEffect{Periodic(
+        id, id % 2 != 0 ? ForceFeedback::kSine : ForceFeedback::kTriangle)});
+    (void)renderer.Play(id);
+  }
+  RenderLoop(state, renderer, effects);
+}
+BENCHMARK(BM_RenderPeriodicMix)->Arg(1)->Arg(8)->Arg(32);
+
+// One effect of each waveform, one at a time.
+void BM_RenderWaveform(benchmark::State& state) {
+  const auto waveform = static_cast<ForceFeedback>(state.range(0));
+  EffectRenderer renderer;
+  (void)renderer.Upload(AnyEffect{Periodic(0, waveform)});
+  (void)renderer.Play(0);
+  state.SetLabel(waveform.ToString());
+  RenderLoop(state, renderer, 1);
+}
+BENCHMARK(BM_RenderWaveform)
+    ->Arg(FF_SQUARE)
+    ->Arg(FF_TRIANGLE)
+    ->Arg(FF_SINE)
+    ->Arg(FF_SAW_UP)
+    ->Arg(FF_SAW_DOWN)
+    ->Arg(FF_CUSTOM);
+
+// Constant and ramp effects through long attacks and fades, which keep the
+// envelope ramps active over the whole buffer.
+void BM_RenderEnvelopes(benchmark::State& state) {
+  EffectRenderer renderer;
+  ConstantEffect constant;
+  constant.id = 0;
+  constant.level = 0x2000;
+  constant.replay.length = absl::Seconds(10);
+  constant.envelope = {.attack_length = absl::Seconds(5),
+                       .attack_level = 0x1000,
+                       .fade_length = absl::Seconds(5),
+                       .fade_level = 0};
+  RampEffect ramp;
+  ramp.id = 1;
+  ramp.start_level = -0x4000;
+  ramp.end_level = 0x4000;
+  ramp.direction = 0x4000;
+  ramp.replay.length = absl::Seconds(10);
+  ramp.envelope = constant.envelope;
+  (void)renderer.Upload(AnyEffect{constant});
+  (void)renderer.Upload(AnyEffect{ramp});
+  // Replayed forever, the repetitions restart the envelopes.
+  (void)renderer.Play(0, 0x7fffffff);
+  (void)renderer.Play(1, 0x7fffffff);
+  RenderLoop(state, renderer, 2);
+}
+BENCHMARK(BM_RenderEnvelopes);
+
+}  // namespace
+}  // namespace evdevpp
@@ -0,0 +1,349 @@
+#include "evdevpp/effect_renderer.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "evdevpp/info.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace evdevpp {
+namespace {
+
+using ::testing::FloatNear;
+using ::testing::Pointwise;
+
+// At 1 kHz, one sample per millisecond, so that the golden buffers below
+// read directly as effect times.
+constexpr EffectRenderer::Options kOneSamplePerMs = {.sample_rate_hz = 1000.0};
+// `FastSin` is within 0.001 of `sin`, the other waveforms are exact.
+constexpr float kExact = 1e-5F;
+constexpr float kSine = 2e-3F;
+
+struct Rendered {
+  std::vector<float> force_x;
+  std::vector<float> force_y;
+  std::vector<float> strong;
+  std::vector<float> weak;
+};
+
+Rendered Render(EffectRenderer& renderer, std::size_t n) {
+  Rendered result{.force_x = std::vector<float>(n),
+                  .force_y = std::vector<float>(n),
+                  .strong = std::vector<float>(n),
+                  .weak = std::vector<float>(n)};
+  EXPECT_TRUE(renderer
+                  .Render({.force_x = absl::MakeSpan(result.force_x),
+                           .force_y = absl::MakeSpan(result.force_y),
+                           .strong = absl::MakeSpan(result.strong),
+                           .weak = absl::MakeSpan(result.weak)})
+                  .ok());
+  return result;
+}
+
+// Play `effect` once and render `n` samples of it.
+Rendered RenderOnce(const AnyEffect& effect, std::size_t n) {
+  EffectRenderer renderer(kOneSamplePerMs);
+  EXPECT_TRUE(renderer.Upload(effect).ok());
+  EXPECT_TRUE(renderer.Play(effect.Base().id).ok());
+  return Render(renderer, n);
+}
+
+// A full-scale periodic effect pointing down (+y), with an 8 ms period.
+PeriodicEffect Periodic(ForceFeedback waveform) {
+  PeriodicEffect effect;
+  effect.waveform = waveform;
+  effect.period = absl::Milliseconds(8);
+  effect.magnitude = 0x7fff;
+  return effect;
+}
+
+// A full-scale constant effect pointing down (+y).
+ConstantEffect Constant(absl::Duration length) {
+  ConstantEffect effect;
+  effect.level = 0x7fff;
+  effect.replay.length = length;
+  return effect;
+}
+
+TEST(EffectRendererTest, SquareWave) {
+  const Rendered out =
+      RenderOnce(AnyEffect{Periodic(ForceFeedback::kSquare)}, 16);
+  const std::vector<float> golden = {1, 1, 1, 1, 1, -1, -1, -1,
+                                     1, 1, 1, 1, 1, -1, -1, -1};
+  EXPECT_THAT(out.force_y, Pointwise(FloatNear(kExact), golden));
+  EXPECT_THAT(out.force_x,
+              Pointwise(FloatNear(kExact), std::vector<float>(16)));
+}
+
+TEST(EffectRendererTest, TriangleWave) {
+  const Rendered out =
+      RenderOnce(AnyEffect{Periodic(ForceFeedback::kTriangle)}, 16);
+  const std::vector<float> golden = {0, 0.5, 1, 0.5, 0, -0.5, -1, -0.5,
+                                     0, 0.5, 1, 0.5, 0, -0.5, -1, -0.5};
+  EXPECT_THAT(out.force_y, Pointwise(FloatNear(kExact), golden));
+}
+
+TEST(EffectRendererTest, SineWave) {
+  const Rendered out =
+      RenderOnce(AnyEffect{Periodic(ForceFeedback::kSine)}, 16);
+  const float h = 0.70710678F;
+  const std::vector<float> golden = {0, h, 1, h, 0, -h, -1, -h,
+                                     0, h, 1, h, 0, -h, -1, -h};
+  EXPECT_THAT(out.force_y, Pointwise(FloatNear(kSine), golden));
+}
+
+TEST(EffectRendererTest, SawUpWave) {
+  const Rendered out =
+      RenderOnce(AnyEffect{Periodic(ForceFeedback::kSawUp)}, 8);
+  const std::vector<float> golden = {-1, -0.75, -0.5, -0.25,
+                                     0,  0.25,  0.5,  0.75};
+  EXPECT_THAT(out.force_y, Pointwise(FloatNear(kExact), golden));
+}
+
+TEST(EffectRendererTest, SawDownWave) {
+  const Rendered out =
+      RenderOnce(AnyEffect{Periodic(ForceFeedback::kSawDown)}, 8);
+  const std::vector<float> golden = {1, 0.75, 0.5, 0.25,
+                                     0, -0.25, -0.5, -0.75};
+  EXPECT_THAT(out.force_y, Pointwise(FloatNear(kExact), golden));
+}
+
+TEST(EffectRendererTest, CustomWaveInterpolatesAndWraps) {
+  PeriodicEffect effect = Periodic(ForceFeedback::kCustom);
+  const std::vector<std::int16_t> samples = {0, 0x7fff, 0, -0x7fff};
+  effect.custom = CustomWaveform(samples);
+  const Rendered out = RenderOnce(AnyEffect{effect}, 8);
+  // Two rendered samples per custom sample, the last one interpolates
+  // back to the first custom sample.
+  const std::vector<float> golden = {0, 0.5, 1, 0.5, 0, -0.5, -1, -0.5};
+  EXPECT_THAT(out.force_y, Pointwise(FloatNear(kExact), golden));
+}
+
+TEST(EffectRendererTest, CustomWaveWithoutSamplesIsRejected) {
+  EffectRenderer renderer(kOneSamplePerMs);
+  EXPECT_FALSE(
+      renderer.Upload(AnyEffect{Periodic(ForceFeedback::kCustom)}).ok());
+}
+
+TEST(EffectRendererTest, PeriodicPhaseAndOffset) {
+  PeriodicEffect effect = Periodic(ForceFeedback::kSawUp);
+  // A quarter period, i.e., two samples.
+  effect.phase = 0x4000;
+  effect.magnitude = 0x7fff / 2;
+  effect.offset = 0x7fff / 4;
+  const Rendered out = RenderOnce(AnyEffect{effect}, 8);
+  // 0.25 + 0.5 * (2 * frac(i / 8 + 0.25) - 1).
+  const std::vector<float> golden = {0,   0.125, 0.25,  0.375,
+                                     0.5, 0.625, -0.25, -0.125};
+  EXPECT_THAT(out.force_y, Pointwise(FloatNear(1e-4F), golden));
+}
+
+TEST(EffectRendererTest, PeriodicNegativeMagnitudeInverts) {
+  PeriodicEffect effect = Periodic(ForceFeedback::kSawUp);
+  effect.magnitude = -0x7fff;
+  const Rendered out = RenderOnce(AnyEffect{effect}, 8);
+  const std::vector<float> golden = {1, 0.75, 0.5, 0.25,
+                                     0, -0.25, -0.5, -0.75};
+  EXPECT_THAT(out.force_y, Pointwise(FloatNear(kExact), golden));
+}
+
+TEST(EffectRendererTest, ConstantWithoutEnvelope) {
+  const Rendered out =
+      RenderOnce(AnyEffect{Constant(absl::Milliseconds(4))}, 6);
+  const std::vector<float> golden = {1, 1, 1, 1, 0, 0};
+  EXPECT_THAT(out.force_y, Pointwise(FloatNear(kExact), golden));
+}
+
+TEST(EffectRendererTest, EnvelopeAttack) {
+  ConstantEffect effect = Constant(absl::Milliseconds(8));
+  effect.envelope.attack_length = absl::Milliseconds(4);
+  effect.envelope.attack_level = 0;
+  const Rendered out = RenderOnce(AnyEffect{effect}, 8);
+  const std::vector<float> golden = {0, 0.25, 0.5, 0.75, 1, 1, 1, 1};
+  EXPECT_THAT(out.force_y, Pointwise(FloatNear(kExact), golden));
+}
+
+TEST(EffectRendererTest, EnvelopeAttackFromLevel) {
+  ConstantEffect effect = Constant(absl::Milliseconds(8));
+  effect.envelope.attack_length = absl::Milliseconds(4);
+  effect.envelope.attack_level = 0x7fff / 2;
+  const Rendered out = RenderOnce(AnyEffect{effect}, 6);
+  const std::vector<float> golden = {0.5, 0.625, 0.75, 0.875, 1, 1};
+  EXPECT_THAT(out.force_y, Pointwise(FloatNear(1e-4F), golden));
+}
+
+TEST(EffectRendererTest, EnvelopeFade) {
+  ConstantEffect effect = Constant(absl::Milliseconds(8));
+  effect.envelope.fade_length = absl::Milliseconds(4);
+  effect.envelope.fade_level = 0;
+  const Rendered out = RenderOnce(AnyEffect{effect}, 10);
+  const std::vector<float> golden = {1, 1, 1, 1, 1, 0.75, 0.5, 0.25, 0, 0};
+  EXPECT_THAT(out.force_y, Pointwise(FloatNear(kExact), golden));
+}
+
+TEST(EffectRendererTest, EnvelopeFadeIgnoredWhenInfinite) {
+  ConstantEffect effect = Constant(absl::ZeroDuration());
+  effect.envelope.fade_length = absl::Milliseconds(4);
+  const Rendered out = RenderOnce(AnyEffect{effect}, 6);
+  EXPECT_THAT(out.force_y,
+              Pointwise(FloatNear(kExact), std::vector<float>(6, 1.0F)));
+}
+
+TEST(EffectRendererTest, EnvelopeAttackAndFadeOverlap) {
+  ConstantEffect effect = Constant(absl::Milliseconds(4));
+  effect.envelope.attack_length = absl::Milliseconds(4);
+  effect.envelope.fade_length = absl::Milliseconds(4);
+  const Rendered out = RenderOnce(AnyEffect{effect}, 5);
+  // The fade applies to the attack: ta * tf.
+  const std::vector<float> golden = {0, 0.1875, 0.25, 0.1875, 0};
+  EXPECT_THAT(out.force_y, Pointwise(FloatNear(kExact), golden));
+}
+
+TEST(EffectRendererTest, EnvelopeKeepsNegativeSign) {
+  ConstantEffect effect = Constant(absl::Milliseconds(8));
+  effect.level = -0x7fff;
+  effect.envelope.attack_length = absl::Milliseconds(4);
+  const Rendered out = RenderOnce(AnyEffect{effect}, 6);
+  const std::vector<float> golden = {0, -0.25, -0.5, -0.75, -1, -1};
+  EXPECT_THAT(out.force_y, Pointwise(FloatNear(kExact), golden));
+}
+
+TEST(EffectRendererTest, EnvelopeOnPeriodic) {
+  PeriodicEffect effect = Periodic(ForceFeedback::kSquare);
+  effect.replay.length = absl::Milliseconds(8);
+  effect.envelope.attack_length = absl::Milliseconds(4);
+  effect.envelope.fade_length = absl::Milliseconds(2);
+  const Rendered out = RenderOnce(AnyEffect{effect}, 9);
+  const std::vector<float> golden = {0,  0.25,  0.5,  0.75, 1,
+                                     -1, -1, -0.5, 0};
+  EXPECT_THAT(out.force_y, Pointwise(FloatNear(kExact), golden));
+}
+
+TEST(EffectRendererTest, RampThroughZero) {
+  RampEffect effect;
+  effect.start_level = -0x7fff;
+  effect.end_level = 0x7fff;
+  effect.replay.length = absl::Milliseconds(8);
+  const Rendered out = RenderOnce(AnyEffect{effect}, 10);
+  const std::vector<float> golden = {-1,   -0.75, -0.5, -0.25, 0,
+                                     0.25, 0.5,   0.75, 0,     0};
+  EXPECT_THAT(out.force_y, Pointwise(FloatNear(kExact), golden));
+}
+
+TEST(EffectRendererTest, RampWithEnvelope) {
+  RampEffect effect;
+  effect.start_level = 0x7fff;
+  effect.end_level = 0;
+  effect.replay.length = absl::Milliseconds(4);
+  effect.envelope.attack_length = absl::Milliseconds(2);
+  const Rendered out = RenderOnce(AnyEffect{effect}, 4);
+  // The envelope scales the magnitude of the ramp, 1 - t / 4.
+  const std::vector<float> golden = {0, 0.375, 0.5, 0.25};
+  EXPECT_THAT(out.force_y, Pointwise(FloatNear(kExact), golden));
+}
+
+TEST(EffectRendererTest, RumbleMotors) {
+  RumbleEffect effect;
+  effect.strong_magnitude = 0xffff;
+  effect.weak_magnitude = 0x4000;
+  effect.replay.length = absl::Milliseconds(3);
+  const Rendered out = RenderOnce(AnyEffect{effect}, 5);
+  const float quarter = 0x4000 / 65535.0F;
+  EXPECT_THAT(out.strong,
+              Pointwise(FloatNear(kExact), std::vector<float>{1, 1, 1, 0, 0}));
+  EXPECT_THAT(out.weak, Pointwise(FloatNear(kExact),
+                                  std::vector<float>{quarter, quarter, quarter,
+                                                     0, 0}));
+  EXPECT_THAT(out.force_y, Pointwise(FloatNear(kExact), std::vector<float>(5)));
+}
+
+TEST(EffectRendererTest, DirectionLeft) {
+  ConstantEffect effect = Constant(absl::Milliseconds(2));
+  effect.direction = 0x4000;
+  const Rendered out = RenderOnce(AnyEffect{effect}, 3);
+  EXPECT_THAT(out.force_x,
+              Pointwise(FloatNear(kExact), std::vector<float>{-1, -1, 0}));
+  EXPECT_THAT(out.force_y, Pointwise(FloatNear(kExact), std::vector<float>(3)));
+}
+
+TEST(EffectRendererTest, ReplayDelayAndCount) {
+  ConstantEffect effect = Constant(absl::Milliseconds(3));
+  effect.replay.delay = absl::Milliseconds(2);
+  EffectRenderer renderer(kOneSamplePerMs);
+  ASSERT_TRUE(renderer.Upload(AnyEffect{effect}).ok());
+  ASSERT_TRUE(renderer.Play(effect.id, 2).ok());
+  const Rendered out = Render(renderer, 12);
+  const std::vector<float> golden = {0, 0, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0};
+  EXPECT_THAT(out.force_y, Pointwise(FloatNear(kExact), golden));
+  EXPECT_EQ(renderer.PlayingCount(), 0U);
+}
+
+TEST(EffectRendererTest, GainAndClamping) {
+  EffectRenderer renderer(kOneSamplePerMs);
+  ConstantEffect first = Constant(absl::ZeroDuration());
+  ConstantEffect second = first;
+  second.id = 1;
+  ASSERT_TRUE(renderer.Upload(AnyEffect{first}).ok());
+  ASSERT_TRUE(renderer.Upload(AnyEffect{second}).ok());
+  ASSERT_TRUE(renderer.Play(first.id).ok());
+  ASSERT_TRUE(renderer.Play(second.id).ok());
+  // 1 + 1 is clamped to 1.
+  EXPECT_THAT(Render(renderer, 2).force_y,
+              Pointwise(FloatNear(kExact), std::vector<float>{1, 1}));
+  renderer.SetGain(0x4000);
+  const float gain = 0x4000 / 65535.0F;
+  EXPECT_THAT(Render(renderer, 2).force_y,
+              Pointwise(FloatNear(kExact),
+                        std::vector<float>{2 * gain, 2 * gain}));
+}
+
+TEST(EffectRendererTest, SplitRenderingMatchesOneBuffer) {
+  // Across the 256-sample chunks and the 8-sample blocks.
+  PeriodicEffect effect = Periodic(ForceFeedback::kSine);
+  effect.period = absl::Milliseconds(37);
+  effect.replay.length = absl::Milliseconds(900);
+  effect.envelope.attack_length = absl::Milliseconds(300);
+  effect.envelope.fade_length = absl::Milliseconds(300);
+  const Rendered whole = RenderOnce(AnyEffect{effect}, 1000);
+
+  EffectRenderer renderer(kOneSamplePerMs);
+  ASSERT_TRUE(renderer.Upload(AnyEffect{effect}).ok());
+  ASSERT_TRUE(renderer.Play(effect.id).ok());
+  std::vector<float> pieces;
+  for (std::size_t n : {1, 7, 250, 13, 300, 429}) {
+    const Rendered piece = Render(renderer, n);
+    pieces.insert(pieces.end(), piece.force_y.begin(), piece.force_y.end());
+  }
+  EXPECT_EQ(renderer.Position(), 1000);
+  EXPECT_THAT(pieces, Pointwise(FloatNear(1e-4F), whole.force_y));
+}
+
+TEST(EffectRendererTest, HandleEvent) {
+  EffectRenderer renderer(kOneSamplePerMs);
+  ConstantEffect effect = Constant(absl::ZeroDuration());
+  effect.id = 3;
+  ASSERT_TRUE(renderer.Upload(AnyEffect{effect}).ok());
+  renderer.HandleEvent({.type = EV_FF, .code = 3, .value = 1});
+  renderer.HandleEvent({.type = EV_FF, .code = FF_GAIN, .value = 0x8000});
+  EXPECT_THAT(Render(renderer, 1).force_y,
+              Pointwise(FloatNear(kExact),
+                        std::vector<float>{0x8000 / 65535.0F}));
+  renderer.HandleEvent({.type = EV_FF, .code = 3, .value = 0});
+  EXPECT_EQ(renderer.PlayingCount(), 0U);
+}
+
+TEST(EffectRendererTest, RejectsMismatchedChannels) {
+  EffectRenderer renderer(kOneSamplePerMs);
+  std::vector<float> x(4);
+  std::vector<float> y(5);
+  EXPECT_FALSE(renderer
+                   .Render({.force_x = absl::MakeSpan(x),
+                            .force_y = absl::MakeSpan(y)})
+                   .ok());
+}
+
+}  // namespace
+}  // namespace evdevpp
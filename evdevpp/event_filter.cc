@@ -0,0 +1,531 @@
+#include "evdevpp/event_filter.h"
+
+#include <cctype>
+#include <charconv>
+#include <cstdlib>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "evdevpp/ecodes.h"
+#include "fmt/format.h"
+
+namespace evdevpp {
+
+namespace {
+
+// Bounds on the expressions, to keep evaluation on a fixed stack and
+// parsing from recursing without end.
+constexpr std::size_t kMaxStackDepth = 64;
+constexpr int kMaxNesting = 128;
+
+template <typename EVCode>
+void AddCodeNames(absl::flat_hash_map<std::string, std::uint16_t>& names) {
+  for (const auto& [name, code] : EVCode::NameToCode()) {
+    names.emplace(name, code);
+  }
+}
+
+// All the names of `ecodes.h`, aliases included, e.g., "Key::kA".
+const absl::flat_hash_map<std::string, std::uint16_t>& CodeNames() {
+  static const auto* names =
+      new absl::flat_hash_map<std::string, std::uint16_t>{[]() {
+        absl::flat_hash_map<std::string, std::uint16_t> result;
+        AddCodeNames<Key>(result);
+        AddCodeNames<AbsoluteAxis>(result);
+        AddCodeNames<RelativeAxis>(result);
+        AddCodeNames<Switch>(result);
+        AddCodeNames<Misc>(result);
+        AddCodeNames<LED>(result);
+        AddCodeNames<Button>(result);
+        AddCodeNames<Autorepeat>(result);
+        AddCodeNames<Sound>(result);
+        AddCodeNames<EventType>(result);
+        AddCodeNames<Synch>(result);
+        AddCodeNames<ForceFeedback>(result);
+        AddCodeNames<UIForceFeedback>(result);
+        return result;
+      }()};
+  return *names;
+}
+
+// Map a kernel name (e.g., "KEY_LEFTCTRL") to its `ecodes.h` name (e.g.,
+// "Key::kLeftctrl"), the same way `genecodes.py` does.
+std::string KernelToCodeName(std::string_view name) {
+  static constexpr std::pair<std::string_view, std::string_view> kPrefixes[] =
+      {
+          // Prefixes with an underscore first.
+          {"UI_FF_", "UIForceFeedback"},
+          {"KEY_", "Key"},
+          {"ABS_", "AbsoluteAxis"},
+          {"REL_", "RelativeAxis"},
+          {"SW_", "Switch"},
+          {"MSC_", "Misc"},
+          {"LED_", "LED"},
+          {"BTN_", "Button"},
+          {"REP_", "Autorepeat"},
+          {"SND_", "Sound"},
+          {"EV_", "EventType"},
+          {"SYN_", "Synch"},
+          {"FF_", "ForceFeedback"},
+      };
+  for (const auto& [prefix, class_name] : kPrefixes) {
+    if (name.size() <= prefix.size() ||
+        name.substr(0, prefix.size()) != prefix) {
+      continue;
+    }
+    std::string result(class_name);
+    result += "::k";
+    bool word_start = true;
+    for (char c : name.substr(prefix.size())) {
+      if (c == '_') {
+        word_start = true;
+        continue;
+      }
+      result += (word_start ? c : static_cast<char>(std::tolower(c)));
+      word_start = false;
+    }
+    return result;
+  }
+  return std::string(name);
+}
+
+}  // namespace
+
+class EventFilter::Parser {
+ public:
+  Parser(std::string_view text, EventFilter* filter)
+      : text_(text), filter_(filter) {}
+
+  absl::Status Parse() {
+    Next();
+    if (auto st = ParseOr(0); !st.ok()) {
+      return st;
+    }
+    if (kind_ != Kind::kEnd) {
+      return Error("Expected end of expression");
+    }
+    return absl::OkStatus();
+  }
+
+ private:
+  enum class Kind { kEnd, kName, kNumber, kSymbol, kInvalid };
+
+  static bool IsNameChar(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) != 0 || c == '_' ||
+           c == ':';
+  }
+
+  // Read the next token into `kind_`, `token_` and `token_pos_`.
+  void Next() {
+    while (pos_ < text_.size() &&
+           std::isspace(static_cast<unsigned char>(text_[pos_])) != 0) {
+      ++pos_;
+    }
+    token_pos_ = pos_;
+    if (pos_ == text_.size()) {
+      kind_ = Kind::kEnd;
+      token_ = {};
+      return;
+    }
+    const char c = text_[pos_];
+    std::size_t end = pos_ + 1;
+    if (std::isdigit(static_cast<unsigned char>(c)) != 0) {
+      kind_ = Kind::kNumber;
+      while (end < text_.size() &&
+             std::isalnum(static_cast<unsigned char>(text_[end])) != 0) {
+        ++end;
+      }
+    } else if (IsNameChar(c)) {
+      kind_ = Kind::kName;
+      while (end < text_.size() && IsNameChar(text_[end])) {
+        ++end;
+      }
+    } else {
+      kind_ = Kind::kSymbol;
+      static constexpr std::string_view kTwoChars[] = {"==", "!=", "<=", ">=",
+                                                       "&&", "||", ".."};
+      static constexpr std::string_view kOneChar = "<>!(){},-";
+      const std::string_view two = text_.substr(pos_, 2);
+      bool found = false;
+      for (std::string_view symbol : kTwoChars) {
+        if (two == symbol) {
+          end = pos_ + 2;
+          found = true;
+          break;
+        }
+      }
+      if (!found && kOneChar.find(c) == std::string_view::npos) {
+        kind_ = Kind::kInvalid;
+      }
+    }
+    token_ = text_.substr(pos_, end - pos_);
+    pos_ = end;
+  }
+
+  [[nodiscard]] bool Is(std::string_view symbol) const {
+    return (kind_ == Kind::kSymbol || kind_ == Kind::kName) &&
+           token_ == symbol;
+  }
+
+  absl::Status Error(std::string_view what) const {
+    return absl::InvalidArgumentError(fmt::format(
+        "{} at offset {} of filter '{}'", what, token_pos_, text_));
+  }
+
+  void Emit(Op op) { filter_->program_.push_back({.op = op}); }
+
+  absl::Status ParseOr(int nesting) {
+    if (auto st = ParseAnd(nesting); !st.ok()) {
+      return st;
+    }
+    while (Is("||")) {
+      Next();
+      if (auto st = ParseAnd(nesting); !st.ok()) {
+        return st;
+      }
+      Emit(Op::kOr);
+    }
+    return absl::OkStatus();
+  }
+
+  absl::Status ParseAnd(int nesting) {
+    if (auto st = ParseUnary(nesting); !st.ok()) {
+      return st;
+    }
+    while (Is("&&")) {
+      Next();
+      if (auto st = ParseUnary(nesting); !st.ok()) {
+        return st;
+      }
+      Emit(Op::kAnd);
+    }
+    return absl::OkStatus();
+  }
+
+  absl::Status ParseUnary(int nesting) {
+    if (nesting > kMaxNesting) {
+      return Error("Expression nested too deeply");
+    }
+    if (Is("!")) {
+      Next();
+      if (auto st = ParseUnary(nesting + 1); !st.ok()) {
+        return st;
+      }
+      Emit(Op::kNot);
+      return absl::OkStatus();
+    }
+    if (Is("(")) {
+      Next();
+      if (auto st = ParseOr(nesting + 1); !st.ok()) {
+        return st;
+      }
+      if (!Is(")")) {
+        return Error("Expected ')'");
+      }
+      Next();
+      return absl::OkStatus();
+    }
+    return ParseComparison();
+  }
+
+  absl::Status ParseComparison() {
+    Instruction instruction;
+    if (Is("type")) {
+      instruction.field = Field::kType;
+    } else if (Is("code")) {
+      instruction.field = Field::kCode;
+    } else if (Is("value")) {
+      instruction.field = Field::kValue;
+    } else if (Is("abs")) {
+      Next();
+      if (!Is("(")) {
+        return Error("Expected '('");
+      }
+      Next();
+      if (!Is("value")) {
+        return Error("Expected 'value'");
+      }
+      Next();
+      if (!Is(")")) {
+        return Error("Expected ')'");
+      }
+      instruction.field = Field::kAbsValue;
+    } else {
+      return Error("Expected a field (type, code, value or abs(value))");
+    }
+    Next();
+
+    static constexpr std::pair<std::string_view, Op> kComparisons[] = {
+        {"==", Op::kEq}, {"!=", Op::kNe}, {"<", Op::kLt},
+        {"<=", Op::kLe}, {">", Op::kGt},  {">=", Op::kGe},
+    };
+    for (const auto& [symbol, op] : kComparisons) {
+      if (Is(symbol)) {
+        Next();
+        instruction.op = op;
+        if (auto st = ParseOperand(instruction.operand); !st.ok()) {
+          return st;
+        }
+        filter_->program_.push_back(instruction);
+        return absl::OkStatus();
+      }
+    }
+    if (!Is("in")) {
+      return Error("Expected a comparison or 'in'");
+    }
+    Next();
+    if (!Is("{")) {
+      return Error("Expected '{'");
+    }
+    Next();
+    instruction.op = Op::kIn;
+    instruction.begin = static_cast<std::uint32_t>(filter_->ranges_.size());
+    while (true) {
+      Range range;
+      if (auto st = ParseOperand(range.first); !st.ok()) {
+        return st;
+      }
+      range.last = range.first;
+      if (Is("..")) {
+        Next();
+        if (auto st = ParseOperand(range.last); !st.ok()) {
+          return st;
+        }
+        if (range.last < range.first) {
+          return Error("Empty range");
+        }
+      }
+      filter_->ranges_.push_back(range);
+      if (Is("}")) {
+        break;
+      }
+      if (!Is(",")) {
+        return Error("Expected ',' or '}'");
+      }
+      Next();
+    }
+    Next();
+    instruction.end = static_cast<std::uint32_t>(filter_->ranges_.size());
+    filter_->program_.push_back(instruction);
+    return absl::OkStatus();
+  }
+
+  absl::Status ParseOperand(std::int64_t& operand) {
+    bool negative = false;
+    if (Is("-")) {
+      negative = true;
+      Next();
+    }
+    if (kind_ == Kind::kNumber) {
+      std::string_view digits = token_;
+      int base = 10;
+      if (digits.size() > 2 && digits[0] == '0' &&
+          (digits[1] == 'x' || digits[1] == 'X')) {
+        digits.remove_prefix(2);
+        base = 16;
+      }
+      std::uint32_t number = 0;
+      auto [end, ec] = std::from_chars(
+          digits.data(), digits.data() + digits.size(), number, base);
+      if (ec != std::errc() || end != digits.data() + digits.size()) {
+        return Error("Invalid number");
+      }
+      operand = negative ? -std::int64_t{number} : std::int64_t{number};
+      Next();
+      return absl::OkStatus();
+    }
+    if (kind_ == Kind::kName && !negative) {
+      const auto& names = CodeNames();
+      auto it = names.find(KernelToCodeName(token_));
+      if (it == names.end()) {
+        return Error(fmt::format("Unknown code name '{}'", token_));
+      }
+      operand = it->second;
+      Next();
+      return absl::OkStatus();
+    }
+    return Error("Expected a number or a code name");
+  }
+
+  std::string_view text_;
+  EventFilter* filter_;
+  std::size_t pos_ = 0;
+  Kind kind_ = Kind::kEnd;
+  std::string_view token_;
+  std::size_t token_pos_ = 0;
+};
+
+absl::StatusOr<EventFilter> EventFilter::Parse(std::string_view expression) {
+  EventFilter result;
+  result.expression_ = std::string(expression);
+  if (auto st = Parser(result.expression_, &result).Parse(); !st.ok()) {
+    return st;
+  }
+  std::size_t depth = 0;
+  for (const auto& instruction : result.program_) {
+    switch (instruction.op) {
+      case Op::kAnd:
+      case Op::kOr:
+        --depth;
+        break;
+      case Op::kNot:
+        break;
+      default:
+        if (++depth > kMaxStackDepth) {
+          return absl::InvalidArgumentError(
+              fmt::format("Filter '{}' is too complex", expression));
+        }
+        if (instruction.field == Field::kValue ||
+            instruction.field == Field::kAbsValue) {
+          result.value_independent_ = false;
+        }
+        break;
+    }
+  }
+  result.Precompute();
+  return result;
+}
+
+std::int64_t EventFilter::FieldValue(Field field, std::uint16_t type,
+                                     std::uint16_t code, std::int32_t value) {
+  switch (field) {
+    case Field::kType:
+      return type;
+    case Field::kCode:
+      return code;
+    case Field::kValue:
+      return value;
+    case Field::kAbsValue:
+      return std::abs(std::int64_t{value});
+  }
+  return 0;
+}
+
+bool EventFilter::Test(const Instruction& instruction,
+                       std::int64_t field) const {
+  switch (instruction.op) {
+    case Op::kEq:
+      return field == instruction.operand;
+    case Op::kNe:
+      return field != instruction.operand;
+    case Op::kLt:
+      return field < instruction.operand;
+    case Op::kLe:
+      return field <= instruction.operand;
+    case Op::kGt:
+      return field > instruction.operand;
+    case Op::kGe:
+      return field >= instruction.operand;
+    case Op::kIn:
+      for (std::uint32_t i = instruction.begin; i < instruction.end; ++i) {
+        if (field >= ranges_[i].first && field <= ranges_[i].last) {
+          return true;
+        }
+      }
+      return false;
+    default:
+      return false;
+  }
+}
+
+bool EventFilter::Evaluate(std::uint16_t type, std::uint16_t code,
+                           std::int32_t value) const {
+  std::array<bool, kMaxStackDepth> stack{};
+  std::size_t top = 0;
+  for (const auto& instruction : program_) {
+    switch (instruction.op) {
+      case Op::kAnd:
+        --top;
+        stack[top - 1] = stack[top - 1] && stack[top];
+        break;
+      case Op::kOr:
+        --top;
+        stack[top - 1] = stack[top - 1] || stack[top];
+        break;
+      case Op::kNot:
+        stack[top - 1] = !stack[top - 1];
+        break;
+      default:
+        stack[top++] = Test(
+            instruction, FieldValue(instruction.field, type, code, value));
+        break;
+    }
+  }
+  return stack[0];
+}
+
+void EventFilter::Precompute() {
+  if (value_independent_) {
+    for (std::size_t type = 0; type < kTypeCount; ++type) {
+      for (std::size_t code = 0; code < kCodeCount; ++code) {
+        accept_[type][code] = Evaluate(type, code, 0);
+      }
+    }
+    return;
+  }
+  // Evaluate with unknown values: each stack entry is a known bit and a
+  // result bit, and the value comparisons are unknown.
+  std::array<bool, kMaxStackDepth> known{};
+  std::array<bool, kMaxStackDepth> result{};
+  for (std::size_t type = 0; type < kTypeCount; ++type) {
+    for (std::size_t code = 0; code < kCodeCount; ++code) {
+      std::size_t top = 0;
+      for (const auto& instruction : program_) {
+        switch (instruction.op) {
+          case Op::kAnd:
+          case Op::kOr: {
+            --top;
+            const bool lhs_known = known[top - 1];
+            const bool rhs_known = known[top];
+            const bool lhs = result[top - 1];
+            const bool rhs = result[top];
+            // A known false (and) or true (or) side decides the result.
+            const bool decisive = instruction.op == Op::kOr;
+            if ((lhs_known && lhs == decisive) ||
+                (rhs_known && rhs == decisive)) {
+              known[top - 1] = true;
+              result[top - 1] = decisive;
+            } else {
+              known[top - 1] = lhs_known && rhs_known;
+              result[top - 1] = !decisive;
+            }
+            break;
+          }
+          case Op::kNot:
+            result[top - 1] = !result[top - 1];
+            break;
+          default:
+            if (instruction.field == Field::kValue ||
+                instruction.field == Field::kAbsValue) {
+              known[top] = false;
+              result[top] = false;
+            } else {
+              known[top] = true;
+              result[top] = Test(instruction, FieldValue(instruction.field,
+                                                         type, code, 0));
+            }
+            ++top;
+            break;
+        }
+      }
+      check_[type][code] = !known[0];
+      accept_[type][code] = known[0] && result[0];
+    }
+  }
+}
+
+std::size_t EventFilter::Filter(absl::Span<const input_event> events,
+                                input_event* out) const {
+  std::size_t count = 0;
+  for (const input_event& event : events) {
+    // Copy unconditionally and advance on a match, without a branch.
+    const input_event copy = event;
+    const bool match = Matches(copy);
+    out[count] = copy;
+    count += match ? 1 : 0;
+  }
+  return count;
+}
+
+}  // namespace evdevpp
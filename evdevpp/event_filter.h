@@ -0,0 +1,119 @@
+#ifndef EVDEVPP_EVDEVPP_EVENT_FILTER_H_
+#define EVDEVPP_EVDEVPP_EVENT_FILTER_H_
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/base/optimization.h"
+#include "absl/status/statusor.h"
+#include "absl/types/span.h"
+#include "evdevpp/events.h"
+#include "linux/input.h"
+
+namespace evdevpp {
+
+// A predicate over input events, compiled from a small expression language:
+//
+//   type == EV_KEY && code in {KEY_A..KEY_Z}
+//   type == EV_ABS && abs(value) > 100
+//   !(type == EV_SYN || type == EV_MSC)
+//
+// The fields are `type`, `code`, `value` and `abs(value)`, compared with
+// `==`, `!=`, `<`, `<=`, `>`, `>=` or tested for membership in a set of
+// values and inclusive ranges with `in {...}`. Comparisons combine with
+// `&&`, `||`, `!` and parentheses. Operands are integers (decimal or `0x`
+// hexadecimal) or code names, either as in the kernel headers (`KEY_A`,
+// `BTN_LEFT`, `EV_KEY`) or as in `ecodes.h` (`Key::kA`). Ranges are numeric,
+// e.g., `KEY_A..KEY_Z` is every code from 30 to 44.
+//
+// The expression is evaluated once per (type, code) pair at compile time.
+// Pairs for which the result does not depend on the value are answered by a
+// lookup in per-type code bitsets; only the others run the expression,
+// which is compiled to a short postfix program.
+class EventFilter {
+ public:
+  static absl::StatusOr<EventFilter> Parse(std::string_view expression);
+
+  [[nodiscard]] bool Matches(std::uint16_t type, std::uint16_t code,
+                             std::int32_t value) const {
+    if (ABSL_PREDICT_TRUE(type < kTypeCount && code < kCodeCount &&
+                          !check_[type][code])) {
+      return accept_[type][code];
+    }
+    return Evaluate(type, code, value);
+  }
+  [[nodiscard]] bool Matches(const input_event& event) const {
+    return Matches(event.type, event.code, event.value);
+  }
+  [[nodiscard]] bool Matches(const InputEvent& event) const {
+    return Matches(event.type, event.code, event.value);
+  }
+
+  // Copy the matching events of `events` to `out`, in order, and return
+  // their count. `out` must have room for all the events, and may be
+  // `events.data()` to filter in place.
+  std::size_t Filter(absl::Span<const input_event> events,
+                     input_event* out) const;
+
+  // True if the filter never needs to look at event values.
+  [[nodiscard]] bool IsValueIndependent() const { return value_independent_; }
+  [[nodiscard]] const std::string& Expression() const { return expression_; }
+
+ private:
+  static constexpr std::size_t kTypeCount = EV_CNT;
+  static constexpr std::size_t kCodeCount = KEY_CNT;
+
+  enum class Field : std::uint8_t { kType, kCode, kValue, kAbsValue };
+  enum class Op : std::uint8_t {
+    kEq,
+    kNe,
+    kLt,
+    kLe,
+    kGt,
+    kGe,
+    // Membership in `ranges_[begin, end)`.
+    kIn,
+    kAnd,
+    kOr,
+    kNot,
+  };
+  struct Instruction {
+    Op op = Op::kEq;
+    Field field = Field::kType;
+    std::uint32_t begin = 0;
+    std::uint32_t end = 0;
+    std::int64_t operand = 0;
+  };
+  struct Range {
+    std::int64_t first = 0;
+    std::int64_t last = 0;
+  };
+  class Parser;
+
+  static std::int64_t FieldValue(Field field, std::uint16_t type,
+                                 std::uint16_t code, std::int32_t value);
+  // The result of a comparison instruction on `field`.
+  bool Test(const Instruction& instruction, std::int64_t field) const;
+  // Run the program.
+  bool Evaluate(std::uint16_t type, std::uint16_t code,
+                std::int32_t value) const;
+  // Fill `accept_` and `check_`.
+  void Precompute();
+
+  std::string expression_;
+  std::vector<Instruction> program_;
+  std::vector<Range> ranges_;
+  bool value_independent_ = true;
+  // For each (type, code): whether the value must be checked by running the
+  // program, and otherwise whether the event matches.
+  std::array<std::bitset<kCodeCount>, kTypeCount> check_{};
+  std::array<std::bitset<kCodeCount>, kTypeCount> accept_{};
+};
+
+}  // namespace evdevpp
+
+#endif  // EVDEVPP_EVDEVPP_EVENT_FILTER_H_
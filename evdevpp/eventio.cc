@@ -1,6 +1,11 @@
 #include "evdevpp/eventio.h"
 
 #include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <ctime>
 
 #include "evdevpp/events.h"
 #include "linux/input.h"
@@ -74,4 +79,59 @@ absl::Status EventIO::Write(std::uint16_t etype, std::uint16_t code,
   return absl::OkStatus();
 }
 
+absl::Status EventIO::Write(absl::Span<const InputEvent> events) const {
+  std::array<input_event, 64> raw_events{};
+  timeval tval = absl::ToTimeval(absl::Now());
+
+  while (!events.empty()) {
+    std::size_t count = std::min(events.size(), raw_events.size());
+    for (std::size_t i = 0; i < count; ++i) {
+      raw_events[i].input_event_usec = tval.tv_usec;
+      raw_events[i].input_event_sec = tval.tv_sec;
+      raw_events[i].type = events[i].type;
+      raw_events[i].code = events[i].code;
+      raw_events[i].value = events[i].value;
+    }
+    auto nbytes = static_cast<ssize_t>(count * sizeof(input_event));
+    if (::write(fd_.Fd(), raw_events.data(), nbytes) != nbytes) {
+      return absl::ErrnoToStatus(errno,
+                                 "error writing events to uinput device");
+    }
+    events.remove_prefix(count);
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<std::size_t> EventIO::ReadRaw(
+    absl::Span<input_event> buffer) const {
+  auto nread =
+      ::read(fd_.Fd(), buffer.data(), buffer.size() * sizeof(input_event));
+  if (nread < 0) {
+    if (errno == EAGAIN) {
+      return 0;
+    }
+    return absl::ErrnoToStatus(errno, "ReadRaw input events failed");
+  }
+  return static_cast<std::size_t>(nread) / sizeof(input_event);
+}
+
+absl::Status EventIO::WriteRaw(absl::Span<const input_event> events) const {
+  auto nbytes = static_cast<ssize_t>(events.size() * sizeof(input_event));
+  if (::write(fd_.Fd(), events.data(), nbytes) != nbytes) {
+    return absl::ErrnoToStatus(errno, "error writing events to uinput device");
+  }
+  return absl::OkStatus();
+}
+
+std::int64_t MonotonicNanos() {
+  timespec now{};
+  ::clock_gettime(CLOCK_MONOTONIC, &now);
+  return std::int64_t{now.tv_sec} * 1'000'000'000 + now.tv_nsec;
+}
+
+void ClearTimerFd(int fd) {
+  std::uint64_t expirations = 0;
+  (void)::read(fd, &expirations, sizeof(expirations));
+}
+
 }  // namespace evdevpp
@@ -6,8 +6,10 @@
 
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/types/span.h"
 #include "evdevpp/events.h"
 #include "evdevpp/info.h"
+#include "linux/input.h"
 #include "toolbelt/fd.h"
 
 namespace evdevpp {
@@ -60,10 +62,46 @@ class EventIO {
     return Write(event.type, event.code, event.value);
   }
 
+  // Inject a batch of input events with as few `write` calls as possible
+  // (one per 64 events). All events get the same timestamp.
+  absl::Status Write(absl::Span<const InputEvent> events) const;
+
+  // Read as many pending events as fit into `buffer`, as raw `input_event`s
+  // and without allocating. Returns the number of events read, zero if none
+  // are pending.
+  [[nodiscard]] absl::StatusOr<std::size_t> ReadRaw(
+      absl::Span<input_event> buffer) const;
+
+  // Write raw events with a single `write` call. The timestamps are passed
+  // along as is (uinput replaces them).
+  absl::Status WriteRaw(absl::Span<const input_event> events) const;
+
  protected:
   toolbelt::FileDescriptor fd_;
 };
 
+// Timestamp of `event`, in nanoseconds on the clock of its device.
+inline std::int64_t EventNanos(const input_event& event) {
+  return std::int64_t{event.input_event_sec} * 1'000'000'000 +
+         std::int64_t{event.input_event_usec} * 1'000;
+}
+
+// An event with timestamp `time_ns`, all its other fields zero.
+inline input_event EventAt(std::int64_t time_ns) {
+  input_event event{};
+  event.input_event_sec = time_ns / 1'000'000'000;
+  event.input_event_usec = (time_ns % 1'000'000'000) / 1'000;
+  return event;
+}
+
+// The current time on `CLOCK_MONOTONIC`, in nanoseconds. This is the clock
+// of timerfds, and of the event timestamps of devices set to it (see
+// `InputDevice::SetClockId`).
+std::int64_t MonotonicNanos();
+
+// Clear the readiness of timerfd `fd`, ignoring its expiration count.
+void ClearTimerFd(int fd);
+
 }  // namespace evdevpp
 
 #endif  // EVDEVPP_EVDEVPP_EVENTIO_H_
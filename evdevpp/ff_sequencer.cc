@@ -0,0 +1,218 @@
+#include "evdevpp/ff_sequencer.h"
+
+#include <sys/timerfd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <utility>
+
+namespace evdevpp {
+
+absl::StatusOr<FFSequencer> FFSequencer::Create(EffectCache* cache,
+                                                const Options& options) {
+  if (cache == nullptr) {
+    return absl::InvalidArgumentError("FFSequencer needs an effect cache");
+  }
+  FFSequencer result;
+  result.options_ = options;
+  result.cache_ = cache;
+  result.timer_fd_ = toolbelt::FileDescriptor(
+      ::timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK));
+  if (!result.timer_fd_.IsOpen()) {
+    return absl::ErrnoToStatus(errno, "Creating sequencer timer failed");
+  }
+  return result;
+}
+
+absl::Status FFSequencer::Start(std::vector<Entry> timeline) {
+  // Validate the whole timeline first, so that a rejected one leaves the
+  // sequencer as it was.
+  for (const Entry& entry : timeline) {
+    if (entry.start < absl::ZeroDuration() ||
+        (entry.effect.has_value() && entry.stop <= entry.start)) {
+      return absl::InvalidArgumentError(
+          "Sequencer entries must start at or after zero, and stop after "
+          "they start");
+    }
+  }
+  if (auto st = Stop(); !st.ok()) {
+    return st;
+  }
+  entries_ = std::move(timeline);
+  ids_.assign(entries_.size(), -1);
+  commands_.clear();
+  next_ = 0;
+  for (std::uint32_t i = 0; i < entries_.size(); ++i) {
+    const Entry& entry = entries_[i];
+    const std::int64_t start_ns = absl::ToInt64Nanoseconds(entry.start);
+    if (entry.gain.has_value()) {
+      commands_.push_back({.at_ns = start_ns, .op = Op::kGain, .entry = i});
+    }
+    if (entry.autocenter.has_value()) {
+      commands_.push_back(
+          {.at_ns = start_ns, .op = Op::kAutocenter, .entry = i});
+    }
+    if (entry.effect.has_value()) {
+      commands_.push_back({.at_ns = start_ns, .op = Op::kPlay, .entry = i});
+      if (entry.stop != absl::InfiniteDuration()) {
+        commands_.push_back({.at_ns = absl::ToInt64Nanoseconds(entry.stop),
+                             .op = Op::kStop,
+                             .entry = i});
+      }
+    }
+  }
+  std::stable_sort(commands_.begin(), commands_.end(),
+                   [](const Command& a, const Command& b) {
+                     return a.at_ns != b.at_ns ? a.at_ns < b.at_ns
+                                               : a.op < b.op;
+                   });
+
+  // Upload the effects ahead of time, the last ones first so that, when
+  // they do not all fit, the cache keeps the first ones (the most recently
+  // acquired).
+  for (auto it = commands_.rbegin(); it != commands_.rend(); ++it) {
+    if (it->op != Op::kPlay) {
+      continue;
+    }
+    if (auto id_or = cache_->Acquire(*entries_[it->entry].effect);
+        !id_or.ok()) {
+      entries_.clear();
+      ids_.clear();
+      commands_.clear();
+      next_ = 0;
+      return id_or.status();
+    }
+  }
+
+  start_ns_ = MonotonicNanos();
+  start_time_ = absl::Now();
+  return Rearm();
+}
+
+absl::Status FFSequencer::Stop() {
+  batch_.clear();
+  const input_event stop_event = {.type = EV_FF};
+  for (const auto& [id, count] : playing_) {
+    batch_.push_back(stop_event);
+    batch_.back().code = static_cast<std::uint16_t>(id);
+    cache_->Unpin(id);
+  }
+  playing_.clear();
+  std::fill(ids_.begin(), ids_.end(), -1);
+  next_ = commands_.size();
+  absl::Status result;
+  if (!batch_.empty()) {
+    result = cache_->Device().WriteRaw(batch_);
+  }
+  if (auto st = Rearm(); !st.ok() && result.ok()) {
+    result = st;
+  }
+  return result;
+}
+
+absl::StatusOr<std::size_t> FFSequencer::Dispatch() {
+  ClearTimerFd(timer_fd_.Fd());
+
+  const std::int64_t now_ns = MonotonicNanos() - start_ns_;
+  const std::int64_t due_ns =
+      now_ns + absl::ToInt64Nanoseconds(options_.slack);
+  batch_.clear();
+  absl::Status result;
+  std::size_t count = 0;
+  for (; next_ < commands_.size() && commands_[next_].at_ns <= due_ns;
+       ++next_) {
+    const Command& command = commands_[next_];
+    if (auto st = Append(command); !st.ok() && result.ok()) {
+      // Keep writing the other commands.
+      result = st;
+    }
+    lateness_.RecordNanos(std::max<std::int64_t>(now_ns - command.at_ns, 0));
+    ++count;
+  }
+  if (!batch_.empty()) {
+    if (auto st = cache_->Device().WriteRaw(batch_); !st.ok() && result.ok()) {
+      result = st;
+    }
+  }
+  if (auto st = Rearm(); !st.ok() && result.ok()) {
+    result = st;
+  }
+  if (!result.ok()) {
+    return result;
+  }
+  return count;
+}
+
+absl::Status FFSequencer::Append(const Command& command) {
+  const Entry& entry = entries_[command.entry];
+  input_event event{.type = EV_FF};
+  const timeval stamp =
+      absl::ToTimeval(start_time_ + absl::Nanoseconds(command.at_ns));
+  event.input_event_sec = stamp.tv_sec;
+  event.input_event_usec = stamp.tv_usec;
+  std::int16_t& id = ids_[command.entry];
+  switch (command.op) {
+    case Op::kGain:
+      event.code = FF_GAIN;
+      event.value = *entry.gain;
+      break;
+    case Op::kAutocenter:
+      event.code = FF_AUTOCENTER;
+      event.value = *entry.autocenter;
+      break;
+    case Op::kPlay: {
+      if (id >= 0) {
+        return absl::OkStatus();
+      }
+      // Normally a cache hit, uploads again if the effect was evicted.
+      auto id_or = cache_->Acquire(*entry.effect);
+      if (!id_or.ok()) {
+        return id_or.status();
+      }
+      id = *id_or;
+      // The plays are written directly, keep the cache from evicting the
+      // effect (and reusing its id) while it plays.
+      if (++playing_[id] == 1) {
+        (void)cache_->Pin(id);
+      }
+      event.code = static_cast<std::uint16_t>(id);
+      event.value = 1;
+      break;
+    }
+    case Op::kStop: {
+      if (id < 0) {
+        return absl::OkStatus();
+      }
+      auto it = playing_.find(id);
+      const std::int16_t stopped = id;
+      id = -1;
+      if (it == playing_.end() || --it->second > 0) {
+        // Still played by another entry.
+        return absl::OkStatus();
+      }
+      playing_.erase(it);
+      cache_->Unpin(stopped);
+      event.code = static_cast<std::uint16_t>(stopped);
+      event.value = 0;
+      break;
+    }
+  }
+  batch_.push_back(event);
+  return absl::OkStatus();
+}
+
+absl::Status FFSequencer::Rearm() {
+  itimerspec spec{};
+  if (next_ < commands_.size()) {
+    const std::int64_t at = start_ns_ + commands_[next_].at_ns;
+    spec.it_value.tv_sec = at / 1'000'000'000;
+    spec.it_value.tv_nsec = at % 1'000'000'000;
+  }
+  if (::timerfd_settime(timer_fd_.Fd(), TFD_TIMER_ABSTIME, &spec, nullptr) <
+      0) {
+    return absl::ErrnoToStatus(errno, "Arming sequencer timer failed");
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace evdevpp
@@ -0,0 +1,131 @@
+#ifndef EVDEVPP_EVDEVPP_FF_SEQUENCER_H_
+#define EVDEVPP_EVDEVPP_FF_SEQUENCER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/time/time.h"
+#include "evdevpp/effect_cache.h"
+#include "evdevpp/info.h"
+#include "evdevpp/latency_stats.h"
+#include "linux/input.h"
+#include "toolbelt/fd.h"
+
+namespace evdevpp {
+
+// Plays a timeline of force feedback effects on a device, driven by a
+// single timer.
+//
+// Each entry of the timeline plays an effect from `start` to `stop`
+// (relative to the start of the timeline), and may change the gain
+// (`FF_GAIN`) or autocenter (`FF_AUTOCENTER`) of the device at `start`. The
+// effects are uploaded through an `EffectCache` (when the timeline starts,
+// and again if they were evicted since).
+//
+// All times are relative to the start of the timeline, so the timeline does
+// not drift however late a command is written. The commands that are due
+// at once (at the same time, or late) are written with a single `write`,
+// gain and autocenter changes first, then stops, then plays, and with
+// their scheduled time as timestamp.
+//
+//   auto seq_or = FFSequencer::Create(&cache);
+//   (void)seq_or->Start({{.effect = AnyEffect{thud},
+//                         .stop = absl::Milliseconds(200),
+//                         .gain = 0xC000},
+//                        {.effect = AnyEffect{rumble},
+//                         .start = absl::Milliseconds(150),
+//                         .stop = absl::Milliseconds(900)}});
+//   ... when seq_or->Fd() is readable:
+//   (void)seq_or->Dispatch();
+//
+// Entries with the same effect share its slot: the effect is stopped when
+// the last of them stops. Playing effects are pinned in the cache, so that
+// uploads of other effects do not evict them. Not thread-safe.
+class FFSequencer {
+ public:
+  struct Options {
+    // Commands due within `slack` after the due ones are written with them.
+    absl::Duration slack = absl::ZeroDuration();
+  };
+  // Work-around for GCC/Clang bug.
+  static Options Defaults() { return Options{}; }
+
+  struct Entry {
+    // Unset for an entry that only changes the gain or autocenter.
+    std::optional<AnyEffect> effect;
+    absl::Duration start = absl::ZeroDuration();
+    // Infinite to play until the timeline is stopped (or the effect ends by
+    // itself, according to its replay length).
+    absl::Duration stop = absl::InfiniteDuration();
+    // Device gain and autocenter (0 to 0xFFFF) to set at `start`.
+    std::optional<std::uint16_t> gain;
+    std::optional<std::uint16_t> autocenter;
+  };
+
+  // `cache` must outlive the sequencer.
+  static absl::StatusOr<FFSequencer> Create(
+      EffectCache* cache, const Options& options = Defaults());
+
+  // A file descriptor (timerfd) that is readable when commands are due, at
+  // which point `Dispatch` must be called.
+  [[nodiscard]] const toolbelt::FileDescriptor& Fd() const { return timer_fd_; }
+
+  // Stop the current timeline and start `timeline` now. Fails if an entry
+  // is invalid, leaving the current timeline untouched, or if its effect
+  // cannot be uploaded, leaving no timeline.
+  absl::Status Start(std::vector<Entry> timeline);
+  // Stop the effects of the timeline that are playing, and drop the rest of
+  // the timeline.
+  absl::Status Stop();
+
+  // Write the commands that are due. Returns the number of commands
+  // written.
+  absl::StatusOr<std::size_t> Dispatch();
+
+  // Whether all the commands of the timeline were written.
+  [[nodiscard]] bool Done() const { return next_ == commands_.size(); }
+  // How late each command was written, relative to when it was due.
+  [[nodiscard]] const LatencyHistogram& Lateness() const { return lateness_; }
+
+ private:
+  // In the order they are written when due at once.
+  enum class Op : std::uint8_t { kGain, kAutocenter, kStop, kPlay };
+
+  struct Command {
+    // Since the start of the timeline.
+    std::int64_t at_ns = 0;
+    Op op = Op::kPlay;
+    std::uint32_t entry = 0;
+  };
+
+  // Append the event of `command` to `batch_`.
+  absl::Status Append(const Command& command);
+  absl::Status Rearm();
+
+  Options options_;
+  EffectCache* cache_ = nullptr;
+  toolbelt::FileDescriptor timer_fd_;
+
+  std::vector<Entry> entries_;
+  // Effect id of each entry while it plays, -1 otherwise.
+  std::vector<std::int16_t> ids_;
+  // Sorted by time, then op.
+  std::vector<Command> commands_;
+  std::size_t next_ = 0;
+  // Start of the timeline, on the monotonic clock and for the timestamps.
+  std::int64_t start_ns_ = 0;
+  absl::Time start_time_;
+  // Number of entries playing each effect id.
+  absl::flat_hash_map<std::int16_t, std::uint32_t> playing_;
+  std::vector<input_event> batch_;
+  LatencyHistogram lateness_;
+};
+
+}  // namespace evdevpp
+
+#endif  // EVDEVPP_EVDEVPP_FF_SEQUENCER_H_
@@ -0,0 +1,285 @@
+#include "evdevpp/ff_server.h"
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <utility>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "linux/uinput.h"
+
+namespace evdevpp {
+
+struct FFServer::Shared {
+  const UserInputDevice* device = nullptr;
+  Options options;
+  // Wakes up the dedicated thread to stop it.
+  toolbelt::FileDescriptor wake_fd;
+
+  mutable absl::Mutex mu;
+  // Live effects, indexed by id.
+  std::vector<ff_effect> effects ABSL_GUARDED_BY(mu);
+  std::vector<bool> live ABSL_GUARDED_BY(mu);
+  Stats stats ABSL_GUARDED_BY(mu);
+  LatencyHistogram latency ABSL_GUARDED_BY(mu);
+  absl::Status status ABSL_GUARDED_BY(mu);
+};
+
+absl::StatusOr<FFServer> FFServer::Create(const UserInputDevice& device,
+                                          Options options) {
+  if (device.MaxEffects() <= 0) {
+    return absl::InvalidArgumentError(
+        "Device has no force feedback effects to serve");
+  }
+  FFServer result;
+  result.shared_ = std::make_unique<Shared>();
+  Shared& shared = *result.shared_;
+  shared.device = &device;
+  shared.options = std::move(options);
+  {
+    absl::MutexLock lock(&shared.mu);
+    shared.effects.resize(device.MaxEffects());
+    shared.live.resize(device.MaxEffects());
+  }
+  if (shared.options.dedicated_thread) {
+    shared.wake_fd = toolbelt::FileDescriptor(
+        ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK));
+    if (!shared.wake_fd.IsOpen()) {
+      return absl::ErrnoToStatus(errno, "Creating wake-up eventfd failed");
+    }
+    result.thread_ = std::thread(&FFServer::ServeLoop, result.shared_.get());
+  }
+  return result;
+}
+
+FFServer& FFServer::operator=(FFServer&& rhs) noexcept {
+  if (this != &rhs) {
+    (void)Stop();
+    shared_ = std::move(rhs.shared_);
+    thread_ = std::move(rhs.thread_);
+  }
+  return *this;
+}
+
+FFServer::~FFServer() { (void)Stop(); }
+
+toolbelt::FileDescriptor FFServer::Fd() const {
+  if (shared_ == nullptr) {
+    return {};
+  }
+  return shared_->device->Fd();
+}
+
+absl::Status FFServer::ProcessEvents() {
+  if (shared_ == nullptr) {
+    return absl::FailedPreconditionError("FFServer is not initialized");
+  }
+  if (thread_.joinable()) {
+    return absl::FailedPreconditionError(
+        "FFServer events are processed by its dedicated thread");
+  }
+  return ProcessPending(shared_.get());
+}
+
+absl::Status FFServer::Stop() {
+  if (shared_ == nullptr) {
+    return absl::OkStatus();
+  }
+  if (thread_.joinable()) {
+    const std::uint64_t one = 1;
+    (void)::write(shared_->wake_fd.Fd(), &one, sizeof(one));
+    thread_.join();
+  }
+  absl::MutexLock lock(&shared_->mu);
+  return shared_->status;
+}
+
+absl::StatusOr<AnyEffect> FFServer::GetEffect(std::int16_t effect_id) const {
+  if (shared_ != nullptr) {
+    absl::MutexLock lock(&shared_->mu);
+    if (effect_id >= 0 &&
+        static_cast<std::size_t>(effect_id) < shared_->live.size() &&
+        shared_->live[effect_id]) {
+      return AnyEffect::FromUInputData(&shared_->effects[effect_id]);
+    }
+  }
+  return absl::NotFoundError("No live effect with this id");
+}
+
+std::vector<std::int16_t> FFServer::LiveEffects() const {
+  std::vector<std::int16_t> result;
+  if (shared_ != nullptr) {
+    absl::MutexLock lock(&shared_->mu);
+    for (std::size_t i = 0; i < shared_->live.size(); ++i) {
+      if (shared_->live[i]) {
+        result.push_back(static_cast<std::int16_t>(i));
+      }
+    }
+  }
+  return result;
+}
+
+FFServer::Stats FFServer::GetStats() const {
+  if (shared_ == nullptr) {
+    return {};
+  }
+  absl::MutexLock lock(&shared_->mu);
+  return shared_->stats;
+}
+
+LatencyHistogram FFServer::Latency() const {
+  if (shared_ == nullptr) {
+    return {};
+  }
+  absl::MutexLock lock(&shared_->mu);
+  return shared_->latency;
+}
+
+void FFServer::ServeLoop(Shared* shared) {
+  std::array<pollfd, 2> fds{};
+  fds[0].fd = shared->device->Fd().Fd();
+  fds[0].events = POLLIN;
+  fds[1].fd = shared->wake_fd.Fd();
+  fds[1].events = POLLIN;
+  absl::Status status;
+  while (status.ok()) {
+    if (::poll(fds.data(), fds.size(), -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      status = absl::ErrnoToStatus(errno, "Waiting on uinput device failed");
+      break;
+    }
+    if ((fds[1].revents & POLLIN) != 0) {
+      break;
+    }
+    if ((fds[0].revents & (POLLERR | POLLHUP)) != 0) {
+      status = absl::UnavailableError("The uinput device was closed");
+      break;
+    }
+    status = ProcessPending(shared);
+  }
+  absl::MutexLock lock(&shared->mu);
+  if (shared->status.ok()) {
+    shared->status = status;
+  }
+}
+
+absl::Status FFServer::ProcessPending(Shared* shared) {
+  std::array<input_event, 64> buffer{};
+  while (true) {
+    auto count_or = shared->device->ReadRaw(absl::MakeSpan(buffer));
+    if (!count_or.ok()) {
+      return count_or.status();
+    }
+    for (std::size_t i = 0; i < *count_or; ++i) {
+      const input_event& event = buffer[i];
+      if (event.type != EV_UINPUT) {
+        if (shared->options.on_event) {
+          shared->options.on_event(event);
+        }
+        absl::MutexLock lock(&shared->mu);
+        ++shared->stats.events;
+        continue;
+      }
+      absl::Status st;
+      if (event.code == UI_FF_UPLOAD) {
+        st = AnswerUpload(shared, static_cast<std::uint32_t>(event.value));
+      } else if (event.code == UI_FF_ERASE) {
+        st = AnswerErase(shared, static_cast<std::uint32_t>(event.value));
+      } else {
+        continue;
+      }
+      if (!st.ok()) {
+        return st;
+      }
+      // The uinput requests are stamped with the monotonic clock.
+      const std::int64_t sent_ns = EventNanos(event);
+      absl::MutexLock lock(&shared->mu);
+      shared->latency.RecordNanos(MonotonicNanos() - sent_ns);
+    }
+    if (*count_or < buffer.size()) {
+      return absl::OkStatus();
+    }
+  }
+}
+
+absl::Status FFServer::AnswerUpload(Shared* shared, std::uint32_t request_id) {
+  const int fd = shared->device->Fd().Fd();
+  uinput_ff_upload upload{};
+  upload.request_id = request_id;
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg) POSIX API
+  if (::ioctl(fd, UI_BEGIN_FF_UPLOAD, &upload) < 0) {
+    return absl::ErrnoToStatus(errno, "Failed to begin uinput upload.");
+  }
+  const std::int16_t id = upload.effect.id;
+  bool in_range = false;
+  bool update = false;
+  {
+    absl::MutexLock lock(&shared->mu);
+    in_range =
+        id >= 0 && static_cast<std::size_t>(id) < shared->effects.size();
+    update = in_range && shared->live[id];
+  }
+  int retval = in_range ? 0 : -EINVAL;
+  if (in_range && shared->options.on_upload) {
+    const FFEffectView effect(&upload.effect);
+    const FFEffectView old(&upload.old);
+    retval = shared->options.on_upload(effect, update ? &old : nullptr);
+  }
+  {
+    absl::MutexLock lock(&shared->mu);
+    ++shared->stats.uploads;
+    if (retval == 0) {
+      shared->effects[id] = upload.effect;
+      shared->live[id] = true;
+    } else {
+      ++shared->stats.rejected;
+    }
+  }
+  upload.retval = retval;
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg) POSIX API
+  if (::ioctl(fd, UI_END_FF_UPLOAD, &upload) < 0) {
+    return absl::ErrnoToStatus(errno, "Failed to end uinput upload.");
+  }
+  return absl::OkStatus();
+}
+
+absl::Status FFServer::AnswerErase(Shared* shared, std::uint32_t request_id) {
+  const int fd = shared->device->Fd().Fd();
+  uinput_ff_erase erase{};
+  erase.request_id = request_id;
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg) POSIX API
+  if (::ioctl(fd, UI_BEGIN_FF_ERASE, &erase) < 0) {
+    return absl::ErrnoToStatus(errno, "Failed to begin uinput erase.");
+  }
+  const auto id = static_cast<std::int16_t>(erase.effect_id);
+  int retval = 0;
+  if (shared->options.on_erase) {
+    retval = shared->options.on_erase(id);
+  }
+  {
+    absl::MutexLock lock(&shared->mu);
+    ++shared->stats.erases;
+    if (retval == 0) {
+      if (id >= 0 && static_cast<std::size_t>(id) < shared->live.size()) {
+        shared->live[id] = false;
+      }
+    } else {
+      ++shared->stats.rejected;
+    }
+  }
+  erase.retval = retval;
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg) POSIX API
+  if (::ioctl(fd, UI_END_FF_ERASE, &erase) < 0) {
+    return absl::ErrnoToStatus(errno, "Failed to end uinput erase.");
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace evdevpp
@@ -0,0 +1,148 @@
+#ifndef EVDEVPP_EVDEVPP_FF_SERVER_H_
+#define EVDEVPP_EVDEVPP_FF_SERVER_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/time/time.h"
+#include "evdevpp/ecodes.h"
+#include "evdevpp/info.h"
+#include "evdevpp/latency_stats.h"
+#include "evdevpp/user_device.h"
+#include "linux/input.h"
+#include "toolbelt/fd.h"
+
+namespace evdevpp {
+
+// A read-only view of a force feedback effect as passed by the kernel
+// (`struct ff_effect`), to inspect an effect without converting it.
+//
+// For `FF_CUSTOM` periodic effects, `custom_data` points into the memory of
+// the process that uploaded the effect and must not be dereferenced (the
+// conversions to `AnyEffect` leave the custom samples out).
+class FFEffectView {
+ public:
+  explicit FFEffectView(const ff_effect* effect) : effect_(effect) {}
+
+  [[nodiscard]] ForceFeedback Type() const { return effect_->type; }
+  [[nodiscard]] std::int16_t Id() const { return effect_->id; }
+  [[nodiscard]] std::uint16_t Direction() const { return effect_->direction; }
+  [[nodiscard]] absl::Duration Length() const {
+    return absl::Milliseconds(effect_->replay.length);
+  }
+  [[nodiscard]] absl::Duration Delay() const {
+    return absl::Milliseconds(effect_->replay.delay);
+  }
+  // The type-specific parameters are in `Raw().u`.
+  [[nodiscard]] const ff_effect& Raw() const { return *effect_; }
+
+  // Convert to an `AnyEffect` (a copy).
+  [[nodiscard]] AnyEffect ToAnyEffect() const {
+    return AnyEffect::FromUInputData(effect_);
+  }
+
+ private:
+  const ff_effect* effect_;
+};
+
+// Answers the force feedback upload and erase requests of a user input
+// device, keeping a table of the live effects.
+//
+// When a client uploads or erases an effect, it blocks in its `ioctl` until
+// the uinput side answers. The server reads the uinput device, answers each
+// request as soon as it is read (calling `on_upload` or `on_erase` with a
+// view of the effect, without converting it), and passes the other events
+// written by the client (`EV_FF` play/stop, `FF_GAIN`, `EV_LED`, ...) to
+// `on_event`.
+//
+// By default, the server runs on a dedicated thread, so that requests are
+// answered promptly regardless of what the rest of the program is doing,
+// and the callbacks are called on that thread. The server must then be the
+// only reader of the device.
+//
+//   auto server_or = FFServer::Create(
+//       pad, {.on_upload = [](const FFEffectView& effect,
+//                             const FFEffectView* old) { return 0; },
+//             .on_event = [](const input_event& event) { ... }});
+class FFServer {
+ public:
+  struct Options {
+    // Called for each upload, with the previous version of the effect if it
+    // is an update of a live effect. Returns 0 to accept the effect, or a
+    // negative errno (e.g., `-EINVAL`) to reject it. When unset, all
+    // uploads are accepted.
+    std::function<int(const FFEffectView& effect, const FFEffectView* old)>
+        on_upload;
+    // Called for each erase, returns 0 or a negative errno, like
+    // `on_upload`. When unset, all erases are accepted.
+    std::function<int(std::int16_t effect_id)> on_erase;
+    // Called for the events other than requests.
+    std::function<void(const input_event& event)> on_event;
+    // Answer requests on a dedicated thread. Otherwise, `ProcessEvents`
+    // must be called whenever `Fd()` is readable.
+    bool dedicated_thread = true;
+  };
+
+  struct Stats {
+    std::uint64_t uploads = 0;
+    std::uint64_t erases = 0;
+    // Requests answered with an error.
+    std::uint64_t rejected = 0;
+    std::uint64_t events = 0;
+  };
+
+  // Serve the requests of `device`, which must outlive the server and have
+  // force feedback enabled (`MaxEffects() > 0`).
+  static absl::StatusOr<FFServer> Create(const UserInputDevice& device,
+                                         Options options);
+
+  FFServer() = default;
+  FFServer(const FFServer&) = delete;
+  FFServer& operator=(const FFServer&) = delete;
+  FFServer(FFServer&& rhs) noexcept = default;
+  FFServer& operator=(FFServer&& rhs) noexcept;
+  ~FFServer();
+
+  // The file descriptor of the user input device, to register in an event
+  // loop when not using a dedicated thread.
+  [[nodiscard]] toolbelt::FileDescriptor Fd() const;
+
+  // Answer all pending requests and dispatch the pending events. Does not
+  // block. Only for servers without a dedicated thread.
+  absl::Status ProcessEvents();
+
+  // Stop the dedicated thread, if any. Returns the first error it hit.
+  absl::Status Stop();
+
+  // The live effect with id `effect_id`.
+  [[nodiscard]] absl::StatusOr<AnyEffect> GetEffect(
+      std::int16_t effect_id) const;
+  // The ids of the live effects.
+  [[nodiscard]] std::vector<std::int16_t> LiveEffects() const;
+
+  [[nodiscard]] Stats GetStats() const;
+  // Time from each request being sent by the kernel to its answer.
+  [[nodiscard]] LatencyHistogram Latency() const;
+
+ private:
+  struct Shared;
+
+  static void ServeLoop(Shared* shared);
+  static absl::Status ProcessPending(Shared* shared);
+  static absl::Status AnswerUpload(Shared* shared, std::uint32_t request_id);
+  static absl::Status AnswerErase(Shared* shared, std::uint32_t request_id);
+
+  // State shared with the dedicated thread. Heap allocated so that the
+  // server can be moved while the thread runs.
+  std::unique_ptr<Shared> shared_;
+  std::thread thread_;
+};
+
+}  // namespace evdevpp
+
+#endif  // EVDEVPP_EVDEVPP_FF_SERVER_H_
@@ -0,0 +1,222 @@
+#include "evdevpp/forwarder.h"
+
+#include <sys/epoll.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <utility>
+
+namespace evdevpp {
+
+namespace {
+
+bool IsSynReport(const input_event& event) {
+  return event.type == EV_SYN && event.code == SYN_REPORT;
+}
+
+}  // namespace
+
+absl::StatusOr<EventForwarder> EventForwarder::Create(
+    std::vector<InputDevice> sources, const Options& options) {
+  if (sources.empty()) {
+    return absl::InvalidArgumentError("No source devices to forward");
+  }
+  if (options.measure_latency) {
+    for (const auto& source : sources) {
+      if (auto st = source.SetClockId(CLOCK_MONOTONIC); !st.ok()) {
+        return st;
+      }
+    }
+  }
+
+  EventForwarder result;
+  result.options_ = options;
+  auto output_or = UserInputDevice::CreateFromDevices(
+      sources, {EventType::kSyn, EventType::kFf}, options.output);
+  if (!output_or.ok()) {
+    return output_or.status();
+  }
+  result.output_ = std::move(*output_or);
+  result.sources_ = std::move(sources);
+
+  // Grab once the merged device exists, so that no event goes unseen.
+  if (options.grab) {
+    for (const auto& source : result.sources_) {
+      auto grab_or = source.GrabInScope();
+      if (!grab_or.ok()) {
+        return grab_or.status();
+      }
+      result.grabs_.emplace_back(std::move(*grab_or));
+    }
+  }
+
+  result.epoll_fd_ = toolbelt::FileDescriptor(::epoll_create1(EPOLL_CLOEXEC));
+  if (!result.epoll_fd_.IsOpen()) {
+    return absl::ErrnoToStatus(errno, "Creating forwarder epoll failed");
+  }
+  for (std::size_t i = 0; i < result.sources_.size(); ++i) {
+    result.states_.push_back(std::make_unique<SourceState>());
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u32 = static_cast<std::uint32_t>(i);
+    if (::epoll_ctl(result.epoll_fd_.Fd(), EPOLL_CTL_ADD,
+                    result.sources_[i].Fd().Fd(), &ev) < 0) {
+      return absl::ErrnoToStatus(errno, "Watching source device failed");
+    }
+  }
+  return result;
+}
+
+absl::StatusOr<std::size_t> EventForwarder::Poll(absl::Duration timeout) {
+  std::array<epoll_event, 16> ready{};
+  int timeout_ms = (timeout == absl::InfiniteDuration()
+                        ? -1
+                        : static_cast<int>(absl::ToInt64Milliseconds(
+                              std::max(timeout, absl::ZeroDuration()))));
+  int count = ::epoll_wait(epoll_fd_.Fd(), ready.data(),
+                           static_cast<int>(ready.size()), timeout_ms);
+  if (count < 0) {
+    if (errno == EINTR) {
+      return 0;
+    }
+    return absl::ErrnoToStatus(errno, "Waiting on source devices failed");
+  }
+  std::size_t frames = 0;
+  for (int i = 0; i < count; ++i) {
+    auto frames_or = ForwardSource(ready[i].data.u32);
+    if (!frames_or.ok()) {
+      return frames_or.status();
+    }
+    frames += *frames_or;
+  }
+  return frames;
+}
+
+absl::StatusOr<std::size_t> EventForwarder::ForwardSource(std::size_t index) {
+  SourceState& state = *states_[index];
+  std::size_t frames = 0;
+  while (!state.lost) {
+    auto count_or = sources_[index].ReadRaw(absl::MakeSpan(state.buffer));
+    if (!count_or.ok()) {
+      // Typically ENODEV, the source was unplugged. Keep forwarding the
+      // other sources.
+      state.lost = true;
+      ++stats_.lost_sources;
+      (void)::epoll_ctl(epoll_fd_.Fd(), EPOLL_CTL_DEL,
+                        sources_[index].Fd().Fd(), nullptr);
+      break;
+    }
+    const std::size_t count = *count_or;
+    const input_event* events = state.buffer.data();
+
+    // Events in [run_begin, run_end) are whole frames that can be written
+    // straight from the read buffer.
+    std::size_t run_begin = 0;
+    std::size_t run_end = 0;
+    std::size_t run_frames = 0;
+    auto flush_run = [&]() -> absl::Status {
+      if (run_frames == 0) {
+        return absl::OkStatus();
+      }
+      frames += run_frames;
+      auto st = WriteFrames({events + run_begin, run_end - run_begin},
+                            run_frames);
+      run_frames = 0;
+      return st;
+    };
+
+    for (std::size_t k = 0; k < count; ++k) {
+      const input_event& event = events[k];
+      if (event.type == EV_SYN && event.code == SYN_DROPPED) {
+        ++stats_.syn_dropped;
+        if (auto st = flush_run(); !st.ok()) {
+          return st;
+        }
+        state.partial.clear();
+        state.dropping = true;
+        run_begin = run_end = k + 1;
+        continue;
+      }
+      if (state.dropping) {
+        state.dropping = !IsSynReport(event);
+        run_begin = run_end = k + 1;
+        continue;
+      }
+      if (!state.partial.empty()) {
+        state.partial.push_back(event);
+        if (IsSynReport(event)) {
+          ++frames;
+          if (auto st = WriteFrames(state.partial, 1); !st.ok()) {
+            return st;
+          }
+          state.partial.clear();
+        }
+        run_begin = run_end = k + 1;
+        continue;
+      }
+      if (IsSynReport(event)) {
+        run_end = k + 1;
+        ++run_frames;
+      }
+    }
+    if (auto st = flush_run(); !st.ok()) {
+      return st;
+    }
+    // Keep the start of a frame that continues in the next read.
+    if (state.partial.empty() && !state.dropping) {
+      state.partial.assign(events + std::max(run_begin, run_end),
+                           events + count);
+    }
+    if (count < state.buffer.size()) {
+      // Nothing more is pending, save the extra `read`.
+      break;
+    }
+  }
+  return frames;
+}
+
+absl::Status EventForwarder::WriteFrames(absl::Span<const input_event> events,
+                                         std::size_t frames) {
+  if (options_.filter.has_value()) {
+    filtered_.resize(events.size());
+    std::size_t count = 0;
+    std::size_t frame_begin = 0;
+    for (const auto& event : events) {
+      if (event.type != EV_SYN) {
+        filtered_[count] = event;
+        count += options_.filter->Matches(event) ? 1 : 0;
+        continue;
+      }
+      if (IsSynReport(event) && count == frame_begin) {
+        --frames;
+        continue;
+      }
+      filtered_[count++] = event;
+      if (IsSynReport(event)) {
+        frame_begin = count;
+      }
+    }
+    stats_.filtered += events.size() - count;
+    if (frames == 0) {
+      return absl::OkStatus();
+    }
+    events = absl::MakeConstSpan(filtered_.data(), count);
+  }
+  if (auto st = output_.WriteRaw(events); !st.ok()) {
+    return st;
+  }
+  ++stats_.writes;
+  stats_.frames += frames;
+  stats_.events += events.size();
+  if (options_.measure_latency) {
+    const std::int64_t now = MonotonicNanos();
+    for (const auto& event : events) {
+      if (IsSynReport(event)) {
+        latency_.RecordNanos(now - EventNanos(event));
+      }
+    }
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace evdevpp
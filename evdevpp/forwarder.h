@@ -0,0 +1,121 @@
+#ifndef EVDEVPP_EVDEVPP_FORWARDER_H_
+#define EVDEVPP_EVDEVPP_FORWARDER_H_
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/time/time.h"
+#include "evdevpp/device.h"
+#include "evdevpp/event_filter.h"
+#include "evdevpp/latency_stats.h"
+#include "evdevpp/user_device.h"
+#include "linux/input.h"
+#include "toolbelt/fd.h"
+
+namespace evdevpp {
+
+// Merges several input devices into a single virtual device.
+//
+// The forwarder (optionally) grabs the source devices, creates a user input
+// device with their merged capabilities and forwards their events to it.
+// Events are read into a fixed buffer per source and written back from that
+// buffer, one batched `write` per read, without conversion or allocation.
+// Only whole frames (up to a `SYN_REPORT`) are written, so the events of
+// different sources never interleave within a frame.
+//
+// After a `SYN_DROPPED`, the events of that source are discarded up to and
+// including its next `SYN_REPORT`, as the input core documents.
+//
+//   auto fwd_or = EventForwarder::Create({std::move(*kbd_or),
+//                                         std::move(*mouse_or)});
+//   while (true) {
+//     if (auto frames_or = fwd_or->Poll(absl::Seconds(1)); !frames_or.ok())
+//       ...
+//   }
+class EventForwarder {
+ public:
+  struct Options {
+    // Grab the sources, so that only the merged device is seen by others.
+    bool grab = true;
+    // Switch the sources to `CLOCK_MONOTONIC` timestamps and record the
+    // latency from each source event to its forwarding in `Latency`.
+    bool measure_latency = true;
+    // Only forward the events matching this filter. Sync events always
+    // pass, and frames left empty are not forwarded.
+    std::optional<EventFilter> filter;
+    // Options of the merged device (its capabilities are replaced).
+    UserInputDevice::CreateOptions output = UserInputDevice::Defaults();
+  };
+  // Work-around for GCC/Clang bug.
+  static Options Defaults() { return Options{}; }
+
+  struct Stats {
+    std::uint64_t frames = 0;
+    std::uint64_t events = 0;
+    std::uint64_t writes = 0;
+    std::uint64_t syn_dropped = 0;
+    // Events discarded by the filter.
+    std::uint64_t filtered = 0;
+    // Sources that failed (e.g., unplugged) and are no longer read.
+    std::uint64_t lost_sources = 0;
+  };
+
+  static absl::StatusOr<EventForwarder> Create(
+      std::vector<InputDevice> sources, const Options& options = Defaults());
+
+  // A file descriptor (epoll) that is readable when any source has events,
+  // to integrate the forwarder in an event loop.
+  [[nodiscard]] const toolbelt::FileDescriptor& Fd() const { return epoll_fd_; }
+
+  // Wait up to `timeout` for events, then forward everything available.
+  // Returns the number of frames forwarded.
+  absl::StatusOr<std::size_t> Poll(absl::Duration timeout);
+
+  [[nodiscard]] const UserInputDevice& Output() const { return output_; }
+  [[nodiscard]] const std::vector<InputDevice>& Sources() const {
+    return sources_;
+  }
+  [[nodiscard]] const Stats& GetStats() const { return stats_; }
+  // Time from each frame's `SYN_REPORT` on its source to its write on the
+  // merged device. Empty unless `measure_latency` is set.
+  [[nodiscard]] const LatencyHistogram& Latency() const { return latency_; }
+
+ private:
+  static constexpr std::size_t kReadBufferSize = 256;
+
+  struct SourceState {
+    std::array<input_event, kReadBufferSize> buffer{};
+    // The events of a frame that was split across reads.
+    std::vector<input_event> partial;
+    // Discarding events until the next `SYN_REPORT`.
+    bool dropping = false;
+    bool lost = false;
+  };
+
+  // Forward all available events of source `index`.
+  absl::StatusOr<std::size_t> ForwardSource(std::size_t index);
+  absl::Status WriteFrames(absl::Span<const input_event> events,
+                           std::size_t frames);
+
+  Options options_;
+  std::vector<InputDevice> sources_;
+  // Declared after `sources_`, to be released before them.
+  std::vector<InputDevice::ScopedGrab> grabs_;
+  // Heap allocated, the read buffers are large.
+  std::vector<std::unique_ptr<SourceState>> states_;
+  // The events that pass the filter, if any.
+  std::vector<input_event> filtered_;
+  UserInputDevice output_;
+  toolbelt::FileDescriptor epoll_fd_;
+  Stats stats_;
+  LatencyHistogram latency_;
+};
+
+}  // namespace evdevpp
+
+#endif  // EVDEVPP_EVDEVPP_FORWARDER_H_
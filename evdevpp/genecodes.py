@@ -29,6 +29,9 @@ struct %s {
   constexpr operator std::uint16_t() const { return code; }
 %s
   static const absl::flat_hash_map<std::uint16_t, const char*>& CodeToString();
+  // All the names of the class (including aliases, and names sharing a
+  // value with another), e.g., "Button::kA".
+  static const absl::flat_hash_map<std::string_view, std::uint16_t>& NameToCode();
   [[nodiscard]] const char* ToString() const {
     const auto& m = CodeToString();
     auto it = m.find(code);
@@ -42,7 +45,7 @@ struct %s {
   return hdr_template % (classname, classname, code_lines, classname)
 
 
-def make_source_for_class(classname, val_lines, str_lines):
+def make_source_for_class(classname, val_lines, str_lines, name_lines):
   src_template = r"""
 %s
 
@@ -53,27 +56,36 @@ const absl::flat_hash_map<std::uint16_t, const char*>& %s::CodeToString() {
     return result;
   }()};
   return *code_to_str;
+}
+
+const absl::flat_hash_map<std::string_view, std::uint16_t>& %s::NameToCode() {
+  static const auto* name_to_code = new absl::flat_hash_map<std::string_view, std::uint16_t>{[]() {
+    absl::flat_hash_map<std::string_view, std::uint16_t> result;
+%s
+    return result;
+  }()};
+  return *name_to_code;
 }"""
-  return src_template % (val_lines, classname, str_lines)
+  return src_template % (val_lines, classname, str_lines, classname, name_lines)
 
 # -----------------------------------------------------------------------------
 all_classes = {
-  "KEY": ("Key", [], [], []),
-  "ABS": ("AbsoluteAxis", [], [], []),
-  "REL": ("RelativeAxis", [], [], []),
-  "SW": ("Switch", [], [], []),
-  "MSC": ("Misc", [], [], []),
-  "LED": ("LED", [], [], []),
-  "BTN": ("Button", [], [], []),
-  "REP": ("Autorepeat", [], [], []),
-  "SND": ("Sound", [], [], []),
-  "ID": ("ID", [], [], []),
-  "EV": ("EventType", [], [], []),
-  "BUS": ("BusType", [], [], []),
-  "SYN": ("Synch", [], [], []),
-  "FF": ("ForceFeedback", [], [], []),
-  "UI_FF": ("UIForceFeedback", [], [], []),
-  "INPUT_PROP": ("Property", [], [], []),
+  "KEY": ("Key", [], [], [], []),
+  "ABS": ("AbsoluteAxis", [], [], [], []),
+  "REL": ("RelativeAxis", [], [], [], []),
+  "SW": ("Switch", [], [], [], []),
+  "MSC": ("Misc", [], [], [], []),
+  "LED": ("LED", [], [], [], []),
+  "BTN": ("Button", [], [], [], []),
+  "REP": ("Autorepeat", [], [], [], []),
+  "SND": ("Sound", [], [], [], []),
+  "ID": ("ID", [], [], [], []),
+  "EV": ("EventType", [], [], [], []),
+  "BUS": ("BusType", [], [], [], []),
+  "SYN": ("Synch", [], [], [], []),
+  "FF": ("ForceFeedback", [], [], [], []),
+  "UI_FF": ("UIForceFeedback", [], [], [], []),
+  "INPUT_PROP": ("Property", [], [], [], []),
 }
 all_classes_key_regex = "|".join(all_classes.keys())
 
@@ -141,6 +153,7 @@ def parse_header(header):
             all_classes[macro.group(1)][1].append("  static const %s %s;" % (cls_name, mem_name))
             all_classes[macro.group(1)][2].append("const %s %s::%s = %s;" % (cls_name, cls_name, mem_name, macro.group(3)))
             all_classes[macro.group(1)][3].append(r"""    result[%s] = "%s::%s";""" % (mem_name, cls_name, mem_name))
+            all_classes[macro.group(1)][4].append(r"""    result.emplace("%s::%s", %s);""" % (cls_name, mem_name, mem_name))
             seen_cls_mem_pairs[(cls_name, mem_name)] = True
             continue
         macro_alias = macro_alias_regex.search(line)
@@ -152,6 +165,7 @@ def parse_header(header):
                 continue
             all_classes[macro_alias.group(1)][1].append("  static const %s %s;" % (cls_name, mem_name))
             all_classes[macro_alias.group(1)][2].append("const %s %s::%s = %s::%s;" % (cls_name, cls_name, mem_name, cls_name, val_name))
+            all_classes[macro_alias.group(1)][4].append(r"""    result.emplace("%s::%s", %s);""" % (cls_name, mem_name, mem_name))
             seen_cls_mem_pairs[(cls_name, mem_name)] = True
 
 
@@ -166,7 +180,7 @@ all_hdr_lines = []
 all_src_lines = []
 for k in all_classes.keys():
     all_hdr_lines.append(make_header_for_class(all_classes[k][0], os.linesep.join(all_classes[k][1])))
-    all_src_lines.append(make_source_for_class(all_classes[k][0], os.linesep.join(all_classes[k][2]), os.linesep.join(all_classes[k][3])))
+    all_src_lines.append(make_source_for_class(all_classes[k][0], os.linesep.join(all_classes[k][2]), os.linesep.join(all_classes[k][3]), os.linesep.join(all_classes[k][4])))
 
 hdr_bname = os.path.basename(hdr_fname)
 hdr_guard_name = hdr_bname.upper().replace(".", "_")
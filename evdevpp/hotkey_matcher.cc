@@ -0,0 +1,237 @@
+#include "evdevpp/hotkey_matcher.h"
+
+#include <algorithm>
+#include <deque>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "evdevpp/eventio.h"
+
+namespace evdevpp {
+
+namespace {
+
+constexpr std::int32_t kFree = -1;
+
+// Index of modifier key `code` (two per modifier, left and right, in the
+// order of the modifier bits), -1 for other keys.
+int ModifierKeyIndex(std::uint16_t code) {
+  switch (code) {
+    case KEY_LEFTCTRL:
+      return 0;
+    case KEY_RIGHTCTRL:
+      return 1;
+    case KEY_LEFTSHIFT:
+      return 2;
+    case KEY_RIGHTSHIFT:
+      return 3;
+    case KEY_LEFTALT:
+      return 4;
+    case KEY_RIGHTALT:
+      return 5;
+    case KEY_LEFTMETA:
+      return 6;
+    case KEY_RIGHTMETA:
+      return 7;
+    default:
+      return -1;
+  }
+}
+
+}  // namespace
+
+absl::StatusOr<HotkeyMatcher> HotkeyMatcher::Create(
+    const std::vector<HotkeyBinding>& bindings, const Options& options) {
+  HotkeyMatcher result;
+  result.timeout_ns_ = absl::ToInt64Nanoseconds(options.sequence_timeout);
+  result.chords_.assign(kModifierMasks * kKeyCount, 0);
+  std::int32_t chord_count = 0;
+
+  // Build the trie, with the edges in a hash map (node, chord) -> node.
+  struct Node {
+    std::vector<std::int32_t> chords;
+    std::vector<std::int32_t> children;
+    std::optional<std::uint32_t> match;
+  };
+  std::vector<Node> nodes(1);
+  absl::flat_hash_map<std::uint64_t, std::int32_t> edges;
+  for (const HotkeyBinding& binding : bindings) {
+    if (binding.sequence.empty()) {
+      return absl::InvalidArgumentError("Hotkey binding without chords");
+    }
+    std::int32_t node = 0;
+    for (const HotkeyChord& chord : binding.sequence) {
+      if (chord.modifiers >= kModifierMasks || chord.key >= kKeyCount ||
+          ModifierKeyIndex(chord.key) >= 0) {
+        return absl::InvalidArgumentError(
+            "Hotkey chords need a non-modifier key and known modifiers");
+      }
+      if (nodes[node].match.has_value()) {
+        return absl::InvalidArgumentError(
+            "Hotkey binding extends another binding");
+      }
+      std::int32_t& number =
+          result.chords_[chord.modifiers * kKeyCount + chord.key];
+      if (number == 0) {
+        number = ++chord_count;
+      }
+      auto [edge_it, inserted] = edges.try_emplace(
+          (std::uint64_t(node) << 32) | static_cast<std::uint32_t>(number),
+          static_cast<std::int32_t>(nodes.size()));
+      if (inserted) {
+        nodes[node].chords.push_back(number);
+        nodes[node].children.push_back(edge_it->second);
+        nodes.emplace_back();
+      }
+      node = edge_it->second;
+    }
+    if (nodes[node].match.has_value() || !nodes[node].children.empty()) {
+      return absl::InvalidArgumentError(
+          "Hotkey binding is the same as, or a prefix of, another binding");
+    }
+    nodes[node].match = binding.id;
+  }
+
+  // Place the trie in the double array, breadth first. The root is slot 0,
+  // and chord numbers start from 1, so no child goes there.
+  std::vector<std::int32_t> slots(nodes.size(), 0);
+  result.check_.assign(1, kFree);
+  std::size_t first_free = 1;
+  const auto is_free = [&result](std::size_t slot) {
+    return slot >= result.check_.size() || result.check_[slot] == kFree;
+  };
+  std::deque<std::int32_t> queue = {0};
+  while (!queue.empty()) {
+    const std::int32_t node = queue.front();
+    queue.pop_front();
+    Node& trie_node = nodes[node];
+    if (trie_node.chords.empty()) {
+      continue;
+    }
+    // Sort the children by chord.
+    std::vector<std::size_t> order(trie_node.chords.size());
+    for (std::size_t i = 0; i < order.size(); ++i) {
+      order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+      return trie_node.chords[a] < trie_node.chords[b];
+    });
+    const std::size_t lowest = trie_node.chords[order.front()];
+    // The first base at which all the children fall on free slots.
+    while (!is_free(first_free)) {
+      ++first_free;
+    }
+    std::size_t slot = std::max(first_free, lowest);
+    for (;; ++slot) {
+      if (!is_free(slot)) {
+        continue;
+      }
+      const std::size_t base = slot - lowest;
+      if (std::all_of(trie_node.chords.begin(), trie_node.chords.end(),
+                      [&](std::int32_t chord) {
+                        return is_free(base + chord);
+                      })) {
+        break;
+      }
+    }
+    const std::size_t base = slot - lowest;
+    const std::size_t end = base + trie_node.chords[order.back()] + 1;
+    if (end > result.check_.size()) {
+      result.check_.resize(end, kFree);
+    }
+    const std::int32_t parent = slots[node];
+    for (const std::size_t i : order) {
+      const std::size_t child_slot = base + trie_node.chords[i];
+      result.check_[child_slot] = parent;
+      slots[trie_node.children[i]] = static_cast<std::int32_t>(child_slot);
+      queue.push_back(trie_node.children[i]);
+    }
+    if (result.base_.size() <= static_cast<std::size_t>(parent)) {
+      result.base_.resize(parent + 1, 0);
+    }
+    result.base_[parent] = static_cast<std::int32_t>(base);
+  }
+  result.base_.resize(result.check_.size(), 0);
+  result.match_.resize(result.check_.size());
+  for (std::size_t node = 1; node < nodes.size(); ++node) {
+    result.match_[slots[node]] = nodes[node].match;
+  }
+  result.state_count_ = nodes.size();
+  return result;
+}
+
+std::optional<std::uint32_t> HotkeyMatcher::Process(const input_event& event) {
+  if (event.type != EV_KEY || event.code >= kKeyCount) {
+    return std::nullopt;
+  }
+  if (const int index = ModifierKeyIndex(event.code); index >= 0) {
+    if (event.value == 0) {
+      held_keys_ &= ~(1U << index);
+    } else {
+      held_keys_ |= 1U << index;
+    }
+    modifiers_ = 0;
+    for (int modifier = 0; modifier < 4; ++modifier) {
+      if ((held_keys_ >> (2 * modifier) & 3U) != 0) {
+        modifiers_ |= 1U << modifier;
+      }
+    }
+    return std::nullopt;
+  }
+  if (event.value != 1) {
+    return std::nullopt;
+  }
+
+  const std::int64_t time_ns = EventNanos(event);
+  if (state_ != 0 && time_ns > deadline_ns_) {
+    state_ = 0;
+  }
+  const std::int32_t chord = chords_[modifiers_ * kKeyCount + event.code];
+  std::int32_t next = chord != 0 ? Next(state_, chord) : -1;
+  if (next < 0 && state_ != 0) {
+    // Not a continuation of the sequence, which may start another one.
+    state_ = 0;
+    next = chord != 0 ? Next(0, chord) : -1;
+  }
+  if (next < 0) {
+    return std::nullopt;
+  }
+  if (match_[next].has_value()) {
+    state_ = 0;
+    return match_[next];
+  }
+  state_ = next;
+  deadline_ns_ = time_ns + timeout_ns_;
+  return std::nullopt;
+}
+
+std::optional<std::uint32_t> HotkeyMatcher::Process(const InputEvent& event) {
+  input_event raw{};
+  const timeval tval = absl::ToTimeval(event.timestamp);
+  raw.input_event_sec = tval.tv_sec;
+  raw.input_event_usec = tval.tv_usec;
+  raw.type = event.type;
+  raw.code = event.code;
+  raw.value = event.value;
+  return Process(raw);
+}
+
+absl::Time HotkeyMatcher::NextDeadline() const {
+  return state_ != 0 ? absl::FromUnixNanos(deadline_ns_)
+                     : absl::InfiniteFuture();
+}
+
+void HotkeyMatcher::Tick(absl::Time now) {
+  if (state_ != 0 && absl::ToUnixNanos(now) > deadline_ns_) {
+    state_ = 0;
+  }
+}
+
+void HotkeyMatcher::Reset() {
+  state_ = 0;
+  held_keys_ = 0;
+  modifiers_ = 0;
+}
+
+}  // namespace evdevpp
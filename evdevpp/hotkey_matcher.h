@@ -0,0 +1,124 @@
+#ifndef EVDEVPP_EVDEVPP_HOTKEY_MATCHER_H_
+#define EVDEVPP_EVDEVPP_HOTKEY_MATCHER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "absl/time/time.h"
+#include "evdevpp/events.h"
+#include "linux/input.h"
+
+namespace evdevpp {
+
+// A key pressed while holding modifiers, e.g., Ctrl+Shift+K.
+struct HotkeyChord {
+  // Bit mask of `HotkeyMatcher::kCtrl`, `kShift`, `kAlt` and `kMeta`.
+  std::uint8_t modifiers = 0;
+  std::uint16_t key = 0;
+};
+
+// A chord, or a sequence of chords (e.g., Ctrl+K then Ctrl+C), reported
+// with `id` when matched.
+struct HotkeyBinding {
+  std::vector<HotkeyChord> sequence;
+  std::uint32_t id = 0;
+};
+
+// Matches key events against many hotkey bindings at once.
+//
+// The bindings are compiled into a deterministic automaton over chords:
+// each (modifiers, key) pair used by a binding is numbered through a dense
+// table, and the trie of the binding sequences is stored as a double array
+// (`base` and `check` arrays, the transition of state `s` on chord `c`
+// being `base[s] + c` if `check[base[s] + c] == s`). Matching a key press
+// is a few array lookups, however many bindings there are.
+//
+// Modifiers are tracked from the events (left and right alike), and key
+// releases and repeats are ignored. A sequence is abandoned when its next
+// chord does not follow it (that chord then starts over), or when it comes
+// more than `sequence_timeout` (by event timestamps) after the previous
+// one.
+//
+//   auto matcher_or = HotkeyMatcher::Create(
+//       {{.sequence = {{HotkeyMatcher::kMeta, Key::kEnter}}, .id = 1},
+//        {.sequence = {{HotkeyMatcher::kCtrl, Key::kK},
+//                      {HotkeyMatcher::kCtrl, Key::kC}},
+//         .id = 2}});
+//   ... for each event of the keyboards:
+//   if (auto id = matcher_or->Process(event)) { ... }
+//
+// Not thread-safe.
+class HotkeyMatcher {
+ public:
+  static constexpr std::uint8_t kCtrl = 1;
+  static constexpr std::uint8_t kShift = 2;
+  static constexpr std::uint8_t kAlt = 4;
+  static constexpr std::uint8_t kMeta = 8;
+
+  struct Options {
+    absl::Duration sequence_timeout = absl::Seconds(1);
+  };
+  // Work-around for GCC/Clang bug.
+  static Options Defaults() { return Options{}; }
+
+  // Fails if a binding is empty, uses a modifier key as its key, or is the
+  // same as (or a prefix of) another.
+  static absl::StatusOr<HotkeyMatcher> Create(
+      const std::vector<HotkeyBinding>& bindings,
+      const Options& options = Defaults());
+
+  // Process a key event. Returns the id of the binding it completes, if
+  // any.
+  std::optional<std::uint32_t> Process(const input_event& event);
+  std::optional<std::uint32_t> Process(const InputEvent& event);
+
+  // Whether a sequence is partially matched.
+  [[nodiscard]] bool InSequence() const { return state_ != 0; }
+  // The time at which the partial sequence times out, or `InfiniteFuture`.
+  [[nodiscard]] absl::Time NextDeadline() const;
+  // Abandon the partial sequence if it timed out at `now`, on the clock of
+  // the event timestamps.
+  void Tick(absl::Time now);
+  // Abandon the partial sequence, and forget the held modifiers.
+  void Reset();
+
+  // Number of states of the automaton, and size of its arrays.
+  [[nodiscard]] std::size_t StateCount() const { return state_count_; }
+  [[nodiscard]] std::size_t ArraySize() const { return check_.size(); }
+
+ private:
+  static constexpr std::size_t kKeyCount = KEY_CNT;
+  static constexpr std::size_t kModifierMasks = 16;
+
+  // The transition of `state` on `chord`, -1 if none.
+  [[nodiscard]] std::int32_t Next(std::int32_t state,
+                                  std::int32_t chord) const {
+    const std::int64_t slot = std::int64_t{base_[state]} + chord;
+    return slot < static_cast<std::int64_t>(check_.size()) &&
+                   check_[slot] == state
+               ? static_cast<std::int32_t>(slot)
+               : -1;
+  }
+
+  // Chord numbers (from 1) by modifiers and key, 0 if unused.
+  std::vector<std::int32_t> chords_;
+  // The double array, and the id of the binding each state completes.
+  std::vector<std::int32_t> base_;
+  std::vector<std::int32_t> check_;
+  std::vector<std::optional<std::uint32_t>> match_;
+  std::size_t state_count_ = 0;
+  std::int64_t timeout_ns_ = 0;
+
+  // Held modifier keys (a bit per key), and their modifier mask.
+  std::uint8_t held_keys_ = 0;
+  std::uint8_t modifiers_ = 0;
+  std::int32_t state_ = 0;
+  std::int64_t deadline_ns_ = 0;
+};
+
+}  // namespace evdevpp
+
+#endif  // EVDEVPP_EVDEVPP_HOTKEY_MATCHER_H_
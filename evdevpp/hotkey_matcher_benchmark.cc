@@ -0,0 +1,155 @@
+// Cost of HotkeyMatcher with `range(0)` bindings (6% single chords, the
+// rest three-chord sequences starting with Ctrl+F1..F10): compiling the
+// bindings (items are bindings), and matching a stream of random typing
+// (items are events).
+//
+//   bazel run -c opt //evdevpp:hotkey_matcher_benchmark
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+#include "benchmark/benchmark.h"
+#include "evdevpp/hotkey_matcher.h"
+#include "linux/input.h"
+
+namespace evdevpp {
+namespace {
+
+constexpr std::array<std::uint16_t, 4> kModifierKeys = {
+    KEY_LEFTCTRL, KEY_LEFTSHIFT, KEY_LEFTALT, KEY_LEFTMETA};
+constexpr std::size_t kStreamSize = std::size_t{1} << 16;
+
+// A key from KEY_1 to KEY_F10, other than the modifiers.
+std::uint16_t RandomKey(std::mt19937& rng) {
+  for (;;) {
+    const auto key =
+        static_cast<std::uint16_t>(KEY_1 + rng() % (KEY_F10 + 1 - KEY_1));
+    if (key != KEY_LEFTCTRL && key != KEY_LEFTSHIFT && key != KEY_RIGHTSHIFT &&
+        key != KEY_LEFTALT) {
+      return key;
+    }
+  }
+}
+
+// Chords do not use the F keys, so that they are not prefixes of the
+// sequences.
+HotkeyChord RandomChord(std::mt19937& rng) {
+  for (;;) {
+    const HotkeyChord chord = {
+        .modifiers = static_cast<std::uint8_t>(rng() % 16),
+        .key = RandomKey(rng)};
+    if (chord.key < KEY_F1) {
+      return chord;
+    }
+  }
+}
+
+std::uint64_t ChordKey(const HotkeyChord& chord) {
+  return (std::uint64_t{chord.modifiers} << 16) | chord.key;
+}
+
+std::vector<HotkeyBinding> Bindings(std::size_t count) {
+  std::mt19937 rng(7);
+  std::vector<HotkeyBinding> bindings;
+  absl::flat_hash_set<std::uint64_t> used;
+  while (bindings.size() < count * 6 / 100) {
+    const HotkeyChord chord = RandomChord(rng);
+    if (used.insert(ChordKey(chord)).second) {
+      bindings.push_back({.sequence = {chord},
+                          .id = static_cast<std::uint32_t>(bindings.size())});
+    }
+  }
+  used.clear();
+  while (bindings.size() < count) {
+    const HotkeyChord first = {
+        .modifiers = HotkeyMatcher::kCtrl,
+        .key = static_cast<std::uint16_t>(KEY_F1 + rng() % 10)};
+    const HotkeyChord second = RandomChord(rng);
+    const HotkeyChord third = RandomChord(rng);
+    const std::uint64_t key = (std::uint64_t{first.key} << 48) |
+                              (ChordKey(second) << 24) | ChordKey(third);
+    if (used.insert(key).second) {
+      bindings.push_back({.sequence = {first, second, third},
+                          .id = static_cast<std::uint32_t>(bindings.size())});
+    }
+  }
+  return bindings;
+}
+
+// Random typing, one event per millisecond: 20% modifier presses and
+// releases, 70% key presses and 10% key releases.
+std::vector<input_event> Typing() {
+  std::mt19937 rng(11);
+  std::vector<input_event> events(kStreamSize);
+  std::uint8_t held = 0;
+  for (std::size_t i = 0; i < events.size(); ++i) {
+    input_event& event = events[i];
+    event.input_event_sec = static_cast<long>(i / 1000);
+    event.input_event_usec = static_cast<long>(i % 1000 * 1000);
+    event.type = EV_KEY;
+    const auto roll = rng() % 10;
+    if (roll < 2) {
+      const auto modifier = rng() % kModifierKeys.size();
+      event.code = kModifierKeys[modifier];
+      held ^= 1U << modifier;
+      event.value = (held >> modifier) & 1U;
+    } else {
+      event.code = RandomKey(rng);
+      event.value = roll < 9 ? 1 : 0;
+    }
+  }
+  // End with the modifiers released, so that the stream can loop.
+  for (std::size_t modifier = 0; modifier < kModifierKeys.size(); ++modifier) {
+    if ((held >> modifier) & 1U) {
+      input_event release = events.back();
+      release.code = kModifierKeys[modifier];
+      release.value = 0;
+      events.push_back(release);
+    }
+  }
+  return events;
+}
+
+void BM_Compile(benchmark::State& state) {
+  const std::vector<HotkeyBinding> bindings =
+      Bindings(static_cast<std::size_t>(state.range(0)));
+  std::size_t states = 0;
+  for (auto _ : state) {
+    auto matcher_or = HotkeyMatcher::Create(bindings);
+    if (!matcher_or.ok()) {
+      state.SkipWithError(matcher_or.status().ToString().c_str());
+      break;
+    }
+    states = matcher_or->StateCount();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.counters["states"] = static_cast<double>(states);
+}
+BENCHMARK(BM_Compile)->Arg(100)->Arg(10000)->Unit(benchmark::kMillisecond);
+
+void BM_ProcessTyping(benchmark::State& state) {
+  HotkeyMatcher matcher = *HotkeyMatcher::Create(
+      Bindings(static_cast<std::size_t>(state.range(0))));
+  const std::vector<input_event> events = Typing();
+  std::size_t next = 0;
+  std::int64_t matches = 0;
+  for (auto _ : state) {
+    matches += matcher.Process(events[next]).has_value() ? 1 : 0;
+    if (++next == events.size()) {
+      // The timestamps go back to the start of the stream.
+      matcher.Reset();
+      next = 0;
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["matches"] = benchmark::Counter(
+      static_cast<double>(matches), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_ProcessTyping)->Arg(100)->Arg(10000);
+
+}  // namespace
+}  // namespace evdevpp
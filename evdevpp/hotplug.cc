@@ -0,0 +1,188 @@
+#include "evdevpp/hotplug.h"
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <filesystem>
+#include <string_view>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+#include "fmt/format.h"
+
+namespace evdevpp {
+
+namespace {
+
+constexpr std::uint32_t kDevWatchMask = IN_CREATE | IN_ATTRIB | IN_DELETE |
+                                        IN_MOVED_FROM | IN_MOVED_TO |
+                                        IN_DELETE_SELF | IN_MOVE_SELF;
+constexpr std::uint32_t kSysfsWatchMask = IN_CREATE | IN_DELETE;
+
+bool IsEventNodeName(std::string_view basename) {
+  return basename.substr(0, 5) == "event";
+}
+
+}  // namespace
+
+absl::StatusOr<HotplugMonitor> HotplugMonitor::Create(Options options) {
+  int fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd < 0) {
+    return absl::ErrnoToStatus(errno, "Creating inotify instance failed");
+  }
+  HotplugMonitor result;
+  result.inotify_fd_ = toolbelt::FileDescriptor(fd);
+  result.options_ = std::move(options);
+
+  // Watch before scanning so that no device can slip in between the two.
+  result.dev_watch_ = ::inotify_add_watch(
+      fd, result.options_.input_device_dir.c_str(), kDevWatchMask);
+  if (result.dev_watch_ < 0) {
+    return absl::ErrnoToStatus(
+        errno, fmt::format("Watching input device directory '{}' failed",
+                           result.options_.input_device_dir));
+  }
+  if (!result.options_.sysfs_class_dir.empty()) {
+    result.sysfs_watch_ = ::inotify_add_watch(
+        fd, result.options_.sysfs_class_dir.c_str(), kSysfsWatchMask);
+    if (result.sysfs_watch_ < 0) {
+      return absl::ErrnoToStatus(
+          errno, fmt::format("Watching sysfs class directory '{}' failed",
+                             result.options_.sysfs_class_dir));
+    }
+  }
+
+  if (auto st = result.Rescan(); !st.ok()) {
+    return st;
+  }
+  return result;
+}
+
+absl::StatusOr<bool> HotplugMonitor::Wait(absl::Duration timeout) const {
+  struct pollfd pfd = {.fd = inotify_fd_.Fd(), .events = POLLIN};
+  int poll_res =
+      ::poll(&pfd, 1,
+             std::max(1, static_cast<int>(absl::ToInt64Milliseconds(timeout))));
+  if (poll_res < 0) {
+    return absl::ErrnoToStatus(errno, "Wait on hotplug monitor failed");
+  }
+  return (poll_res != 0);
+}
+
+absl::Status HotplugMonitor::ProcessEvents() {
+  alignas(inotify_event) std::array<char, 4096> buffer{};
+  bool needs_rescan = false;
+  while (true) {
+    auto nread = ::read(inotify_fd_.Fd(), buffer.data(), buffer.size());
+    if (nread < 0) {
+      if (errno == EAGAIN) {
+        break;
+      }
+      return absl::ErrnoToStatus(errno, "Reading hotplug notifications failed");
+    }
+
+    for (std::size_t offset = 0; offset < static_cast<std::size_t>(nread);) {
+      const auto* event =
+          // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+          reinterpret_cast<const inotify_event*>(buffer.data() + offset);
+      offset += sizeof(inotify_event) + event->len;
+
+      if ((event->mask & IN_Q_OVERFLOW) != 0 || event->wd == sysfs_watch_) {
+        needs_rescan = true;
+        continue;
+      }
+      if (event->wd != dev_watch_) {
+        continue;
+      }
+      if ((event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) != 0) {
+        RemoveAll();
+        return absl::FailedPreconditionError(
+            fmt::format("Input device directory '{}' was removed",
+                        options_.input_device_dir));
+      }
+      if (event->len == 0 ||
+          !IsEventNodeName(static_cast<const char*>(event->name))) {
+        continue;
+      }
+      std::string dev_path =
+          (std::filesystem::path{options_.input_device_dir} / event->name)
+              .native();
+      if ((event->mask & (IN_DELETE | IN_MOVED_FROM)) != 0) {
+        Remove(dev_path);
+      } else if ((event->mask & (IN_CREATE | IN_ATTRIB | IN_MOVED_TO)) != 0) {
+        TryAdd(dev_path);
+      }
+    }
+  }
+  if (needs_rescan) {
+    return Rescan();
+  }
+  return absl::OkStatus();
+}
+
+absl::Status HotplugMonitor::Rescan() {
+  std::vector<std::string> present = ListDevices(options_.input_device_dir);
+  absl::flat_hash_set<std::string> present_set(present.begin(), present.end());
+
+  std::vector<std::string> vanished;
+  for (const auto& [dev_path, dev] : devices_) {
+    if (!present_set.contains(dev_path)) {
+      vanished.push_back(dev_path);
+    }
+  }
+  for (const auto& dev_path : vanished) {
+    Remove(dev_path);
+  }
+  for (const auto& dev_path : present) {
+    TryAdd(dev_path);
+  }
+  return absl::OkStatus();
+}
+
+const InputDevice* HotplugMonitor::Find(const std::string& dev_path) const {
+  auto it = devices_.find(dev_path);
+  if (it == devices_.end()) {
+    return nullptr;
+  }
+  return &it->second;
+}
+
+void HotplugMonitor::TryAdd(const std::string& dev_path) {
+  if (devices_.contains(dev_path) || !IsDevice(dev_path)) {
+    return;
+  }
+  // The node may exist before its permissions are set, in which case the
+  // open fails and is retried on the next `IN_ATTRIB`.
+  auto dev_or = InputDevice::Open(dev_path);
+  if (!dev_or.ok()) {
+    return;
+  }
+  auto [it, inserted] = devices_.emplace(dev_path, std::move(*dev_or));
+  if (options_.on_added) {
+    options_.on_added(it->second);
+  }
+}
+
+void HotplugMonitor::Remove(const std::string& dev_path) {
+  auto it = devices_.find(dev_path);
+  if (it == devices_.end()) {
+    return;
+  }
+  if (options_.on_removed) {
+    options_.on_removed(it->second);
+  }
+  devices_.erase(it);
+}
+
+void HotplugMonitor::RemoveAll() {
+  while (!devices_.empty()) {
+    std::string dev_path = devices_.begin()->first;
+    Remove(dev_path);
+  }
+}
+
+}  // namespace evdevpp
@@ -0,0 +1,97 @@
+#ifndef EVDEVPP_EVDEVPP_HOTPLUG_H_
+#define EVDEVPP_EVDEVPP_HOTPLUG_H_
+
+#include <functional>
+#include <string>
+
+#include "absl/container/node_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/time/time.h"
+#include "evdevpp/device.h"
+#include "toolbelt/fd.h"
+
+namespace evdevpp {
+
+// Watches an input device directory (normally `/dev/input`) with inotify
+// and keeps an open `InputDevice` for every event device node in it.
+//
+// The monitor does not own an event loop. Register `Fd()` for readability
+// in whatever loop is in use (poll, epoll, coroutines) and call
+// `ProcessEvents()` when it becomes readable, or use `Wait()` for a simple
+// blocking loop:
+//
+//   auto monitor_or = HotplugMonitor::Create({
+//       .on_added = [](const InputDevice& dev) { ... },
+//       .on_removed = [](const InputDevice& dev) { ... }});
+//   while (true) {
+//     if (auto ready_or = monitor_or->Wait(absl::Seconds(1));
+//         ready_or.ok() && *ready_or) {
+//       (void)monitor_or->ProcessEvents();
+//     }
+//   }
+//
+// Device nodes that show up before udev has fixed their permissions are
+// retried when their attributes change (`IN_ATTRIB`).
+class HotplugMonitor {
+ public:
+  struct Options {
+    // The directory in which event device nodes appear.
+    std::string input_device_dir = "/dev/input";
+    // Optional sysfs class directory (e.g. "/sys/class/input"). When set,
+    // any change reported there triggers a full `Rescan()`. Note that many
+    // kernels do not report inotify events on sysfs at all.
+    std::string sysfs_class_dir;
+    // Called after a device has been opened and added to the registry.
+    std::function<void(const InputDevice&)> on_added;
+    // Called when a device node has disappeared, just before the device is
+    // removed from the registry.
+    std::function<void(const InputDevice&)> on_removed;
+  };
+
+  // Start watching and populate the registry with the devices already
+  // present, calling `on_added` for each of them.
+  static absl::StatusOr<HotplugMonitor> Create(Options options);
+
+  // Return the inotify file descriptor to register in an event loop.
+  [[nodiscard]] toolbelt::FileDescriptor Fd() const { return inotify_fd_; }
+
+  // Wait for hotplug notifications to be ready to process.
+  // Returns true if notifications are available.
+  // Returns false if the wait timed out.
+  // Returns a status for a system error (errno).
+  [[nodiscard]] absl::StatusOr<bool> Wait(absl::Duration timeout) const;
+
+  // Process all pending notifications, updating the registry and invoking
+  // the callbacks. Does not block.
+  absl::Status ProcessEvents();
+
+  // Reconcile the registry with the current content of the device directory.
+  absl::Status Rescan();
+
+  // The currently open devices, keyed by device path. References to the
+  // devices stay valid until they are removed.
+  [[nodiscard]] const absl::node_hash_map<std::string, InputDevice>& Devices()
+      const {
+    return devices_;
+  }
+
+  // Return the open device at `dev_path`, or nullptr. The pointer stays
+  // valid until the device is removed.
+  [[nodiscard]] const InputDevice* Find(const std::string& dev_path) const;
+
+ private:
+  void TryAdd(const std::string& dev_path);
+  void Remove(const std::string& dev_path);
+  void RemoveAll();
+
+  Options options_;
+  toolbelt::FileDescriptor inotify_fd_;
+  int dev_watch_ = -1;
+  int sysfs_watch_ = -1;
+  absl::node_hash_map<std::string, InputDevice> devices_;
+};
+
+}  // namespace evdevpp
+
+#endif  // EVDEVPP_EVDEVPP_HOTPLUG_H_
@@ -156,6 +156,13 @@ void ConditionEffect::FromData(const void* data_ptr) {
   }
 }
 
+CustomWaveform::CustomWaveform(absl::Span<const std::int16_t> samples) {
+  if (!samples.empty()) {
+    samples_ = std::make_shared<const std::vector<std::int16_t>>(
+        samples.begin(), samples.end());
+  }
+}
+
 void PeriodicEffect::ToData(void* data_ptr) const {
   Effect::ToData(data_ptr);
   // NOLINTNEXTLINE(cppcoreguidelines-pro-type-union-access)
@@ -166,8 +173,11 @@ void PeriodicEffect::ToData(void* data_ptr) const {
   periodic.offset = offset;
   periodic.phase = phase;
   periodic.envelope = ToEnvelope(envelope);
-  periodic.custom_len = custom_len;
-  periodic.custom_data = custom_data;
+  if (!custom.Empty()) {
+    periodic.custom_len = custom.Size();
+    // The kernel only reads the samples.
+    periodic.custom_data = const_cast<std::int16_t*>(custom.Samples().data());
+  }
 }
 
 void PeriodicEffect::FromData(const void* data_ptr) {
@@ -180,8 +190,13 @@ void PeriodicEffect::FromData(const void* data_ptr) {
   offset = periodic.offset;
   phase = periodic.phase;
   envelope = FromEnvelope(periodic.envelope);
-  custom_len = periodic.custom_len;
-  custom_data = periodic.custom_data;
+  custom = CustomWaveform{};
+  const bool is_custom = waveform == ForceFeedback::kCustom ||
+                         Type() == ForceFeedback::kCustom;
+  if (is_custom && periodic.custom_data != nullptr) {
+    custom = CustomWaveform(
+        absl::MakeConstSpan(periodic.custom_data, periodic.custom_len));
+  }
 }
 
 void RumbleEffect::ToData(void* data_ptr) const {
@@ -226,4 +241,14 @@ AnyEffect AnyEffect::FromData(const void* data_ptr) {
   return result;
 }
 
+AnyEffect AnyEffect::FromUInputData(const void* data_ptr) {
+  ff_effect effect = *static_cast<const ff_effect*>(data_ptr);
+  if (effect.type == ForceFeedback::kPeriodic ||
+      effect.type == ForceFeedback::kCustom) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-union-access)
+    effect.u.periodic.custom_data = nullptr;
+  }
+  return FromData(&effect);
+}
+
 }  // namespace evdevpp
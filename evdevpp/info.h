@@ -3,12 +3,16 @@
 
 #include <array>
 #include <cassert>
+#include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <new>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/time/time.h"
+#include "absl/types/span.h"
 #include "evdevpp/ecodes.h"
 #include "fmt/format.h"
 
@@ -276,6 +280,29 @@ struct FrictionEffect : ConditionEffect {
   }
 };
 
+// Samples of a custom periodic waveform.
+//
+// The samples are immutable and shared (reference counted) by the copies of
+// the waveform, so that effects own their samples and can be copied cheaply.
+class CustomWaveform {
+ public:
+  CustomWaveform() = default;
+  explicit CustomWaveform(absl::Span<const std::int16_t> samples);
+
+  [[nodiscard]] absl::Span<const std::int16_t> Samples() const {
+    if (samples_ == nullptr) {
+      return {};
+    }
+    return *samples_;
+  }
+  [[nodiscard]] std::size_t Size() const { return Samples().size(); }
+  [[nodiscard]] bool Empty() const { return samples_ == nullptr; }
+
+ private:
+  // Null when empty.
+  std::shared_ptr<const std::vector<std::int16_t>> samples_;
+};
+
 // Defines parameters of a periodic force-feedback effect
 // `waveform`: kind of the effect (wave)
 // `period`: period of the wave (ms)
@@ -283,8 +310,7 @@ struct FrictionEffect : ConditionEffect {
 // `offset`: mean value of the wave (roughly)
 // `phase`: 'horizontal' shift
 // `envelope`: envelope data
-// `custom_len`: number of samples (FF_CUSTOM only)
-// `custom_data`: buffer of samples (FF_CUSTOM only)
+// `custom`: samples of the wave (FF_CUSTOM only)
 struct PeriodicEffect : Effect {
   // kSquare, kTriangle, kSine, kSawUp, kSawDown, kCustom
   ForceFeedback waveform{};
@@ -293,8 +319,7 @@ struct PeriodicEffect : Effect {
   std::int16_t offset = 0;
   std::uint16_t phase = 0;
   Envelope envelope{};
-  std::uint32_t custom_len = 0;
-  std::int16_t* custom_data = nullptr;
+  CustomWaveform custom{};
 
   [[nodiscard]] static ForceFeedback StaticType() {
     return ForceFeedback::kPeriodic;
@@ -379,8 +404,13 @@ class AnyEffect {
     return static_cast<const ActualEffect&>(Base());
   }
 
+  // The `ff_effect` filled by `ToData` points to the custom samples of the
+  // effect, it is only valid as long as the effect.
   void ToData(void* data_ptr) const { Base().ToData(data_ptr); }
   static AnyEffect FromData(const void* data_ptr);
+  // Same as `FromData`, for effects read from a uinput device, whose custom
+  // samples are in the memory of the uploading process: they are left out.
+  static AnyEffect FromUInputData(const void* data_ptr);
 
  private:
   union EffectUnion {
@@ -399,7 +429,9 @@ class AnyEffect {
     EffectUnion& operator=(const EffectUnion&) = delete;
     EffectUnion& operator=(EffectUnion&&) = delete;
 
-    ~EffectUnion() { base.~Effect(); }
+    // Through a laundered pointer, for the call to be virtual: `base` holds
+    // the effect of any of the other members.
+    ~EffectUnion() { std::launder(&base)->~Effect(); }
   } data_;
 };
 
@@ -0,0 +1,103 @@
+#include "evdevpp/latency_stats.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "fmt/format.h"
+
+namespace evdevpp {
+
+std::size_t LatencyHistogram::BucketIndex(std::uint64_t nanos) {
+  constexpr std::uint64_t kLinearLimit = std::uint64_t{2} << kSubBucketBits;
+  if (nanos < kLinearLimit) {
+    return static_cast<std::size_t>(nanos);
+  }
+  int msb = 63 - __builtin_clzll(nanos);
+  if (msb >= kMaxBits) {
+    return kBucketCount - 1;
+  }
+  int shift = msb - kSubBucketBits;
+  return (static_cast<std::size_t>(shift + 1) << kSubBucketBits) +
+         static_cast<std::size_t>((nanos >> shift) -
+                                  (std::uint64_t{1} << kSubBucketBits));
+}
+
+std::uint64_t LatencyHistogram::BucketLowerBound(std::size_t index) {
+  constexpr std::size_t kLinearLimit = std::size_t{2} << kSubBucketBits;
+  if (index < kLinearLimit) {
+    return index;
+  }
+  int shift = static_cast<int>(index >> kSubBucketBits) - 1;
+  std::uint64_t sub = (index & ((std::size_t{1} << kSubBucketBits) - 1)) +
+                      (std::uint64_t{1} << kSubBucketBits);
+  return sub << shift;
+}
+
+void LatencyHistogram::RecordNanos(std::int64_t nanos) {
+  auto value = static_cast<std::uint64_t>(std::max<std::int64_t>(nanos, 0));
+  ++buckets_[BucketIndex(value)];
+  ++count_;
+  min_ = std::min(min_, value);
+  max_ = std::max(max_, value);
+  sum_ += static_cast<double>(value);
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& rhs) {
+  for (std::size_t i = 0; i < kBucketCount; ++i) {
+    buckets_[i] += rhs.buckets_[i];
+  }
+  count_ += rhs.count_;
+  min_ = std::min(min_, rhs.min_);
+  max_ = std::max(max_, rhs.max_);
+  sum_ += rhs.sum_;
+}
+
+absl::Duration LatencyHistogram::Min() const {
+  return (count_ == 0 ? absl::ZeroDuration()
+                      : absl::Nanoseconds(static_cast<std::int64_t>(min_)));
+}
+
+absl::Duration LatencyHistogram::Max() const {
+  return absl::Nanoseconds(static_cast<std::int64_t>(max_));
+}
+
+absl::Duration LatencyHistogram::Mean() const {
+  return (count_ == 0 ? absl::ZeroDuration()
+                      : absl::Nanoseconds(sum_ / static_cast<double>(count_)));
+}
+
+absl::Duration LatencyHistogram::Percentile(double percent) const {
+  if (count_ == 0) {
+    return absl::ZeroDuration();
+  }
+  auto rank = static_cast<std::uint64_t>(
+      std::ceil(std::clamp(percent, 0.0, 100.0) / 100.0 *
+                static_cast<double>(count_)));
+  rank = std::max<std::uint64_t>(rank, 1);
+  std::uint64_t seen = 0;
+  for (std::size_t i = 0; i < kBucketCount; ++i) {
+    seen += buckets_[i];
+    if (seen >= rank) {
+      // Report the middle of the bucket, within the observed range.
+      std::uint64_t lower = BucketLowerBound(i);
+      std::uint64_t upper =
+          (i + 1 < kBucketCount ? BucketLowerBound(i + 1) : max_ + 1);
+      std::uint64_t mid = lower + (upper - lower) / 2;
+      return absl::Nanoseconds(
+          static_cast<std::int64_t>(std::clamp(mid, min_, max_)));
+    }
+  }
+  return Max();
+}
+
+std::string LatencyHistogram::Summary() const {
+  return fmt::format("n={} min={} p50={} p90={} p99={} p99.9={} max={}",
+                     count_, absl::FormatDuration(Min()),
+                     absl::FormatDuration(Percentile(50.0)),
+                     absl::FormatDuration(Percentile(90.0)),
+                     absl::FormatDuration(Percentile(99.0)),
+                     absl::FormatDuration(Percentile(99.9)),
+                     absl::FormatDuration(Max()));
+}
+
+}  // namespace evdevpp
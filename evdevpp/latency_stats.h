@@ -0,0 +1,62 @@
+#ifndef EVDEVPP_EVDEVPP_LATENCY_STATS_H_
+#define EVDEVPP_EVDEVPP_LATENCY_STATS_H_
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <string>
+
+#include "absl/time/time.h"
+
+namespace evdevpp {
+
+// Histogram of durations (latencies, scheduling errors) with fixed,
+// log-linear buckets: exact below 64ns, then 32 buckets per power of two
+// (about 3% relative error), up to about 18 minutes.
+//
+// Recording is a few integer operations and never allocates, so it can be
+// done on every event in a hot loop.
+class LatencyHistogram {
+ public:
+  // Record a duration. Negative durations are recorded as zero.
+  void Record(absl::Duration duration) {
+    RecordNanos(absl::ToInt64Nanoseconds(duration));
+  }
+  void RecordNanos(std::int64_t nanos);
+
+  // Add all the samples of `rhs` to this histogram.
+  void Merge(const LatencyHistogram& rhs);
+  void Clear() { *this = LatencyHistogram{}; }
+
+  [[nodiscard]] std::uint64_t Count() const { return count_; }
+  [[nodiscard]] absl::Duration Min() const;
+  [[nodiscard]] absl::Duration Max() const;
+  [[nodiscard]] absl::Duration Mean() const;
+  // The duration below which `percent` % of the samples fall, e.g.,
+  // `Percentile(99.0)`. Zero if empty.
+  [[nodiscard]] absl::Duration Percentile(double percent) const;
+
+  // A one-line summary, e.g., "n=1000 min=2us p50=12us p90=20us p99=41us
+  // p99.9=80us max=95us".
+  [[nodiscard]] std::string Summary() const;
+
+ private:
+  static constexpr int kSubBucketBits = 5;
+  static constexpr int kMaxBits = 40;
+  static constexpr std::size_t kBucketCount =
+      (kMaxBits - kSubBucketBits + 1) << kSubBucketBits;
+
+  static std::size_t BucketIndex(std::uint64_t nanos);
+  static std::uint64_t BucketLowerBound(std::size_t index);
+
+  std::array<std::uint64_t, kBucketCount> buckets_{};
+  std::uint64_t count_ = 0;
+  std::uint64_t min_ = std::numeric_limits<std::uint64_t>::max();
+  std::uint64_t max_ = 0;
+  // Sum in nanoseconds, as a double so that it does not overflow.
+  double sum_ = 0.0;
+};
+
+}  // namespace evdevpp
+
+#endif  // EVDEVPP_EVDEVPP_LATENCY_STATS_H_
@@ -0,0 +1,185 @@
+#include "evdevpp/rel_coalescer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace evdevpp {
+
+namespace {
+
+// Bounds of the span over which the speed of merged motion is measured: the
+// report period of the fastest devices, and a pause after which motion
+// starts from rest.
+constexpr std::int64_t kMinSpanNs = 100'000;
+constexpr std::int64_t kMaxSpanNs = 100'000'000;
+
+std::int32_t ClampToInt32(std::int64_t value) {
+  return static_cast<std::int32_t>(
+      std::clamp<std::int64_t>(value, std::numeric_limits<std::int32_t>::min(),
+                               std::numeric_limits<std::int32_t>::max()));
+}
+
+}  // namespace
+
+absl::StatusOr<RelCoalescer> RelCoalescer::Create(const EventIO* output,
+                                                  const Options& options) {
+  if (output == nullptr) {
+    return absl::InvalidArgumentError("RelCoalescer needs an output");
+  }
+  return Create(
+      [output](absl::Span<const input_event> frame) {
+        return output->WriteRaw(frame);
+      },
+      options);
+}
+
+absl::StatusOr<RelCoalescer> RelCoalescer::Create(Sink sink,
+                                                  const Options& options) {
+  if (!sink) {
+    return absl::InvalidArgumentError("RelCoalescer needs an output");
+  }
+  if (options.interval < absl::ZeroDuration()) {
+    return absl::InvalidArgumentError("Coalescing interval is negative");
+  }
+  if (!options.gains.empty() &&
+      (!(options.speed_step > 0.0) ||
+       std::any_of(options.gains.begin(), options.gains.end(),
+                   [](float gain) { return !(gain >= 0.0F); }))) {
+    return absl::InvalidArgumentError(
+        "Acceleration gains must be non-negative, at a positive speed step");
+  }
+  RelCoalescer result;
+  result.sink_ = std::move(sink);
+  result.interval_ns_ = absl::ToInt64Nanoseconds(options.interval);
+  result.gains_ = options.gains;
+  result.speed_step_ = options.speed_step;
+  return result;
+}
+
+absl::Status RelCoalescer::Process(absl::Span<const input_event> events) {
+  for (const input_event& event : events) {
+    if (event.type == EV_REL && event.code < kRelCount) {
+      pending_[event.code] += event.value;
+      dirty_.set(event.code);
+      frame_has_motion_ = true;
+    } else if (event.type == EV_SYN && event.code == SYN_REPORT) {
+      if (auto st = EndFrame(event); !st.ok()) {
+        return st;
+      }
+    } else if (event.type == EV_MSC && event.code == MSC_TIMESTAMP) {
+      has_msc_timestamp_ = true;
+      msc_timestamp_ = event.value;
+    } else {
+      others_.push_back(event);
+    }
+  }
+  return absl::OkStatus();
+}
+
+absl::Time RelCoalescer::NextDeadline() const {
+  if (!motion_pending_) {
+    return absl::InfiniteFuture();
+  }
+  return absl::FromUnixNanos(last_write_ns_ + interval_ns_);
+}
+
+absl::Status RelCoalescer::Tick(absl::Time now) {
+  if (!motion_pending_ || now < NextDeadline()) {
+    return absl::OkStatus();
+  }
+  return Flush(now);
+}
+
+absl::Status RelCoalescer::Flush(absl::Time now) {
+  if (!motion_pending_ && others_.empty()) {
+    return absl::OkStatus();
+  }
+  return WriteFrame(absl::ToUnixNanos(now));
+}
+
+absl::Status RelCoalescer::EndFrame(const input_event& syn) {
+  const std::int64_t now_ns = EventNanos(syn);
+  ++frames_in_;
+  if (frame_has_motion_) {
+    frame_has_motion_ = false;
+    if (!motion_pending_) {
+      motion_pending_ = true;
+      first_pending_ns_ = now_ns;
+      span_start_ns_ = last_motion_ns_;
+    }
+    last_motion_ns_ = now_ns;
+  }
+  if (!others_.empty() ||
+      (motion_pending_ && now_ns - last_write_ns_ >= interval_ns_)) {
+    return WriteFrame(now_ns);
+  }
+  return absl::OkStatus();
+}
+
+absl::Status RelCoalescer::WriteFrame(std::int64_t time_ns) {
+  const input_event stamp = EventAt(time_ns);
+  out_.clear();
+
+  if (!gains_.empty() && (dirty_[REL_X] || dirty_[REL_Y])) {
+    const auto dx = static_cast<double>(pending_[REL_X]);
+    const auto dy = static_cast<double>(pending_[REL_Y]);
+    const std::int64_t span_ns =
+        std::clamp(time_ns - span_start_ns_, kMinSpanNs, kMaxSpanNs);
+    const double gain = Gain(std::hypot(dx, dy) * 1.0e6 / span_ns);
+    const double x = dx * gain + remainder_x_;
+    const double y = dy * gain + remainder_y_;
+    pending_[REL_X] = std::llround(x);
+    pending_[REL_Y] = std::llround(y);
+    remainder_x_ = x - static_cast<double>(pending_[REL_X]);
+    remainder_y_ = y - static_cast<double>(pending_[REL_Y]);
+  }
+  for (std::size_t code = 0; code < kRelCount; ++code) {
+    if (dirty_[code] && pending_[code] != 0) {
+      input_event& event = out_.emplace_back(stamp);
+      event.type = EV_REL;
+      event.code = static_cast<std::uint16_t>(code);
+      event.value = ClampToInt32(pending_[code]);
+    }
+  }
+  out_.insert(out_.end(), others_.begin(), others_.end());
+  if (has_msc_timestamp_) {
+    input_event& event = out_.emplace_back(stamp);
+    event.type = EV_MSC;
+    event.code = MSC_TIMESTAMP;
+    event.value = msc_timestamp_;
+  }
+
+  if (motion_pending_) {
+    delay_.RecordNanos(time_ns - first_pending_ns_);
+  }
+  pending_.fill(0);
+  dirty_.reset();
+  others_.clear();
+  has_msc_timestamp_ = false;
+  motion_pending_ = false;
+  last_write_ns_ = time_ns;
+  if (out_.empty()) {
+    // The motion was all carried over.
+    return absl::OkStatus();
+  }
+  input_event& syn = out_.emplace_back(stamp);
+  syn.type = EV_SYN;
+  syn.code = SYN_REPORT;
+  ++frames_out_;
+  return sink_(out_);
+}
+
+double RelCoalescer::Gain(double speed) const {
+  const double position = speed / speed_step_;
+  const std::size_t last = gains_.size() - 1;
+  if (!(position < static_cast<double>(last))) {
+    return gains_[last];
+  }
+  const auto below = static_cast<std::size_t>(position);
+  const double fraction = position - static_cast<double>(below);
+  return gains_[below] + (gains_[below + 1] - gains_[below]) * fraction;
+}
+
+}  // namespace evdevpp
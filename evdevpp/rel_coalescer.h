@@ -0,0 +1,135 @@
+#ifndef EVDEVPP_EVDEVPP_REL_COALESCER_H_
+#define EVDEVPP_EVDEVPP_REL_COALESCER_H_
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "evdevpp/eventio.h"
+#include "evdevpp/latency_stats.h"
+#include "linux/input.h"
+
+namespace evdevpp {
+
+// Merges the relative motion of high-rate devices (e.g., 8 kHz mice) into
+// fewer frames, with optional pointer acceleration.
+//
+// The `EV_REL` deltas (motion, and low and high resolution wheels) of
+// consecutive frames are summed, and written as a single frame at most once
+// per `interval`. Frames with any other event (e.g., a button) are written
+// at once, with the motion merged so far, so that the order of buttons and
+// motion is kept. `MSC_TIMESTAMP` events are merged too (the last one is
+// written).
+//
+// The acceleration multiplies `REL_X` and `REL_Y` by a gain looked up, with
+// linear interpolation, in a table indexed by the speed of the merged
+// motion. The fractions of counts that are not written are carried over to
+// the next frame.
+//
+// Frames are written to `output` (typically a `UserInputDevice` with the
+// capabilities of the input) or passed to a callback. When motion is
+// pending, `Tick` must be called at (or after) `NextDeadline`, e.g., by
+// using it as the timeout of the wait for input.
+//
+//   auto rel_or = RelCoalescer::Create(&virtual_mouse,
+//                                      {.interval = absl::Milliseconds(4)});
+//   ... for each batch of events of the mouse:
+//   (void)rel_or->Process(events);
+//   ... when waiting for events times out:
+//   (void)rel_or->Tick(absl::Now());
+//
+// Not thread-safe.
+class RelCoalescer {
+ public:
+  struct Options {
+    // Shortest time between frames of merged motion. Zero to only apply the
+    // acceleration.
+    absl::Duration interval = absl::Milliseconds(1);
+    // Gains at speeds of 0, `speed_step`, 2 * `speed_step`, ... counts per
+    // millisecond, the last one applying to all higher speeds. Empty for no
+    // acceleration.
+    std::vector<float> gains;
+    double speed_step = 1.0;
+  };
+  // Work-around for GCC/Clang bug.
+  static Options Defaults() { return Options{}; }
+
+  // Receives each frame, ending with its `SYN_REPORT`.
+  using Sink = std::function<absl::Status(absl::Span<const input_event>)>;
+
+  // `output` must outlive the coalescer.
+  static absl::StatusOr<RelCoalescer> Create(
+      const EventIO* output, const Options& options = Defaults());
+  static absl::StatusOr<RelCoalescer> Create(
+      Sink sink, const Options& options = Defaults());
+
+  // Process input events.
+  absl::Status Process(absl::Span<const input_event> events);
+
+  // The time at which `Tick` must be called, or `InfiniteFuture` if no
+  // motion is pending.
+  [[nodiscard]] absl::Time NextDeadline() const;
+  // Write the pending motion if it is due at `now`, on the clock of the
+  // event timestamps.
+  absl::Status Tick(absl::Time now);
+  // Write the pending motion now.
+  absl::Status Flush(absl::Time now);
+
+  // Number of frames processed and written.
+  [[nodiscard]] std::uint64_t FramesIn() const { return frames_in_; }
+  [[nodiscard]] std::uint64_t FramesOut() const { return frames_out_; }
+  // Time from the first frame of merged motion to its write.
+  [[nodiscard]] const LatencyHistogram& Delay() const { return delay_; }
+
+ private:
+  static constexpr std::size_t kRelCount = REL_CNT;
+
+  // End the frame of `syn`.
+  absl::Status EndFrame(const input_event& syn);
+  // Write the pending motion and events, with `time_ns` as timestamp.
+  absl::Status WriteFrame(std::int64_t time_ns);
+  // The gain at `speed`, in counts per millisecond.
+  [[nodiscard]] double Gain(double speed) const;
+
+  Sink sink_;
+  std::int64_t interval_ns_ = 0;
+  std::vector<float> gains_;
+  double speed_step_ = 1.0;
+
+  // Merged deltas, by `REL_*` code.
+  std::array<std::int64_t, kRelCount> pending_{};
+  std::bitset<kRelCount> dirty_;
+  // Fractions of the accelerated motion not written yet.
+  double remainder_x_ = 0.0;
+  double remainder_y_ = 0.0;
+  // Other events of the current frame.
+  std::vector<input_event> others_;
+  bool has_msc_timestamp_ = false;
+  std::int32_t msc_timestamp_ = 0;
+
+  // Times of the last write, of the last frame with motion, of the frame
+  // before the pending motion (the start of the span over which its speed
+  // is measured), and of the first frame of the pending motion.
+  std::int64_t last_write_ns_ = 0;
+  std::int64_t last_motion_ns_ = 0;
+  std::int64_t span_start_ns_ = 0;
+  std::int64_t first_pending_ns_ = 0;
+  bool motion_pending_ = false;
+  bool frame_has_motion_ = false;
+
+  std::vector<input_event> out_;
+  std::uint64_t frames_in_ = 0;
+  std::uint64_t frames_out_ = 0;
+  LatencyHistogram delay_;
+};
+
+}  // namespace evdevpp
+
+#endif  // EVDEVPP_EVDEVPP_REL_COALESCER_H_
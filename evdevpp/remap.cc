@@ -0,0 +1,490 @@
+#include "evdevpp/remap.h"
+
+#include <algorithm>
+
+#include "fmt/format.h"
+
+namespace evdevpp {
+
+namespace {
+
+using Kind = RemapAction::Kind;
+
+template <typename Array>
+bool Contains(const Array& array, std::size_t count, std::uint16_t value) {
+  return std::find(array.begin(), array.begin() + count, value) !=
+         array.begin() + count;
+}
+
+}  // namespace
+
+absl::StatusOr<RemapEngine::CompiledAction> RemapEngine::Compile(
+    const RemapAction& action, std::size_t layer_count) {
+  CompiledAction result;
+  result.kind = action.kind;
+  if (action.codes.size() > kMaxActionCodes) {
+    return absl::InvalidArgumentError(fmt::format(
+        "Remap action has {} codes, at most {} are supported",
+        action.codes.size(), kMaxActionCodes));
+  }
+  for (auto code : action.codes) {
+    if (code >= kKeyCount) {
+      return absl::InvalidArgumentError(
+          fmt::format("Invalid key code 0x{:X} in remap action", code));
+    }
+    result.codes[result.count++] = code;
+  }
+  switch (action.kind) {
+    case Kind::kTransparent:
+    case Kind::kNone:
+      break;
+    case Kind::kKeys:
+      if (result.count == 0) {
+        return absl::InvalidArgumentError("Remap action has no keys");
+      }
+      break;
+    case Kind::kTapHold:
+      if (action.tap >= kKeyCount) {
+        return absl::InvalidArgumentError(
+            fmt::format("Invalid tap key code 0x{:X}", action.tap));
+      }
+      result.tap = action.tap;
+      if (result.count > 0) {
+        break;
+      }
+      [[fallthrough]];
+    case Kind::kLayer:
+    case Kind::kToggleLayer:
+      if (action.layer <= 0 ||
+          static_cast<std::size_t>(action.layer) >= layer_count) {
+        return absl::InvalidArgumentError(
+            fmt::format("Invalid layer {} in remap action", action.layer));
+      }
+      result.layer = static_cast<std::uint8_t>(action.layer);
+      break;
+  }
+  return result;
+}
+
+absl::StatusOr<RemapEngine> RemapEngine::Create(const RemapConfig& config,
+                                                const EventIO* output) {
+  if (config.layers.size() > kMaxLayers) {
+    return absl::InvalidArgumentError(
+        fmt::format("At most {} remap layers are supported", kMaxLayers));
+  }
+  RemapEngine result;
+  result.output_ = output;
+  result.tapping_term_us_ = absl::ToInt64Microseconds(config.tapping_term);
+  result.chord_term_us_ = absl::ToInt64Microseconds(config.chord_term);
+  result.layer_count_ = std::max<std::size_t>(config.layers.size(), 1);
+  result.actions_.resize(result.layer_count_ * kKeyCount);
+  result.pressed_.resize(kKeyCount);
+
+  for (std::size_t layer = 0; layer < config.layers.size(); ++layer) {
+    for (const auto& [code, action] : config.layers[layer].keys) {
+      if (code >= kKeyCount) {
+        return absl::InvalidArgumentError(fmt::format(
+            "Invalid key code 0x{:X} in layer '{}'", code,
+            config.layers[layer].name));
+      }
+      auto compiled_or = Compile(action, result.layer_count_);
+      if (!compiled_or.ok()) {
+        return compiled_or.status();
+      }
+      result.actions_[layer * kKeyCount + code] = *compiled_or;
+    }
+  }
+
+  for (const auto& chord : config.chords) {
+    if (chord.keys.size() < 2 || chord.keys.size() > kMaxChordKeys) {
+      return absl::InvalidArgumentError(fmt::format(
+          "Chords must have 2 to {} keys", kMaxChordKeys));
+    }
+    if (chord.action.kind == Kind::kTransparent ||
+        chord.action.kind == Kind::kTapHold) {
+      return absl::InvalidArgumentError(
+          "Chord actions cannot be transparent or tap-hold");
+    }
+    CompiledChord compiled;
+    for (auto code : chord.keys) {
+      if (code >= kKeyCount || Contains(compiled.keys, compiled.count, code)) {
+        return absl::InvalidArgumentError(
+            fmt::format("Invalid or repeated chord key 0x{:X}", code));
+      }
+      compiled.keys[compiled.count++] = code;
+      result.chord_members_.set(code);
+    }
+    auto action_or = Compile(chord.action, result.layer_count_);
+    if (!action_or.ok()) {
+      return action_or.status();
+    }
+    compiled.action = *action_or;
+    result.chords_.push_back(compiled);
+  }
+  return result;
+}
+
+absl::Status RemapEngine::Process(const input_event& event) {
+  switch (event.type) {
+    case EV_KEY:
+      if (event.code >= kKeyCount) {
+        Emit(event.type, event.code, event.value);
+      } else if (event.value == 1) {
+        OnPress(event.code, EventNanos(event) / 1'000);
+      } else if (event.value == 0) {
+        OnRelease(event.code, EventNanos(event) / 1'000);
+      } else {
+        OnRepeat(event.code);
+      }
+      break;
+    case EV_SYN:
+      if (event.code == SYN_REPORT) {
+        return Sync();
+      }
+      // Other synchronization events are generated by the output device.
+      break;
+    case EV_MSC:
+      // Scan codes would not match remapped keys.
+      if (event.code != MSC_SCAN) {
+        Emit(event.type, event.code, event.value);
+      }
+      break;
+    default:
+      Emit(event.type, event.code, event.value);
+      break;
+  }
+  return std::exchange(write_status_, absl::OkStatus());
+}
+
+absl::Status RemapEngine::Process(absl::Span<const input_event> events) {
+  for (const auto& event : events) {
+    if (auto st = Process(event); !st.ok()) {
+      return st;
+    }
+  }
+  return absl::OkStatus();
+}
+
+absl::Status RemapEngine::Process(const InputEvent& event) {
+  input_event raw{};
+  timeval tval = absl::ToTimeval(event.timestamp);
+  raw.input_event_sec = tval.tv_sec;
+  raw.input_event_usec = tval.tv_usec;
+  raw.type = event.type;
+  raw.code = event.code;
+  raw.value = event.value;
+  return Process(raw);
+}
+
+absl::Time RemapEngine::NextDeadline() const {
+  absl::Time result = absl::InfiniteFuture();
+  if (chord_count_ > 0) {
+    result = std::min(result, absl::FromUnixMicros(chord_deadline_us_));
+  }
+  if (tap_pending_) {
+    result = std::min(result, absl::FromUnixMicros(tap_deadline_us_));
+  }
+  return result;
+}
+
+absl::Status RemapEngine::Tick(absl::Time now) {
+  const std::int64_t now_us = absl::ToUnixMicros(now);
+  if (chord_count_ > 0 && now_us >= chord_deadline_us_) {
+    FlushChord(now_us);
+  }
+  if (tap_pending_ && now_us >= tap_deadline_us_) {
+    ResolveTapHold(/*hold=*/true);
+  }
+  if (auto st = std::exchange(write_status_, absl::OkStatus()); !st.ok()) {
+    return st;
+  }
+  return Sync();
+}
+
+absl::Status RemapEngine::Reset() {
+  for (std::size_t code = 0; code < kKeyCount; ++code) {
+    if (output_holds_[code] != 0) {
+      output_holds_[code] = 0;
+      Emit(EV_KEY, static_cast<std::uint16_t>(code), 0);
+    }
+  }
+  toggled_layers_ = 0;
+  held_layers_ = 0;
+  layer_holds_ = {};
+  down_.reset();
+  tap_pending_ = false;
+  chord_count_ = 0;
+  chord_active_ = false;
+  if (auto st = std::exchange(write_status_, absl::OkStatus()); !st.ok()) {
+    return st;
+  }
+  return Sync();
+}
+
+CapabilitiesInfo RemapEngine::OutputCapabilities(
+    const CapabilitiesInfo& input) const {
+  CapabilitiesInfo result = input;
+  auto add_action = [&result](const CompiledAction& action) {
+    for (std::size_t i = 0; i < action.count; ++i) {
+      result.keys.insert(action.codes[i]);
+    }
+    if (action.kind == Kind::kTapHold) {
+      result.keys.insert(action.tap);
+    }
+  };
+  for (const auto& action : actions_) {
+    add_action(action);
+  }
+  for (const auto& chord : chords_) {
+    add_action(chord.action);
+  }
+  return result;
+}
+
+const RemapEngine::CompiledAction& RemapEngine::Lookup(
+    std::uint16_t code) const {
+  static const CompiledAction kPassThrough;
+  std::uint32_t active = ActiveLayers();
+  while (active != 0) {
+    int layer = 31 - __builtin_clz(active);
+    const CompiledAction& action = actions_[layer * kKeyCount + code];
+    if (action.kind != Kind::kTransparent) {
+      return action;
+    }
+    active &= ~(1U << layer);
+  }
+  return kPassThrough;
+}
+
+void RemapEngine::OnPress(std::uint16_t code, std::int64_t time_us) {
+  if (down_[code]) {
+    return;
+  }
+  if (chord_count_ > 0) {
+    if (TryExtendChord(code)) {
+      return;
+    }
+    FlushChord(time_us);
+  }
+  if (chord_members_[code]) {
+    chord_keys_[0] = code;
+    chord_count_ = 1;
+    chord_deadline_us_ = time_us + chord_term_us_;
+    return;
+  }
+  PressKey(code, time_us);
+}
+
+void RemapEngine::OnRelease(std::uint16_t code, std::int64_t time_us) {
+  if (chord_count_ > 0 && Contains(chord_keys_, chord_count_, code)) {
+    FlushChord(time_us);
+  }
+  if (!down_[code]) {
+    return;
+  }
+  if (tap_pending_ && code == tap_code_) {
+    // Resolve by the release time, in case `Tick` was not called in time.
+    const bool hold = time_us >= tap_deadline_us_;
+    ResolveTapHold(hold);
+    if (!hold) {
+      return;
+    }
+  }
+  down_.reset(code);
+  if (chord_active_ &&
+      Contains(active_chord_.keys, active_chord_.count, code)) {
+    ReleaseChord();
+  }
+  ReleaseAction(pressed_[code], code);
+}
+
+void RemapEngine::OnRepeat(std::uint16_t code) {
+  if (!down_[code] || (tap_pending_ && code == tap_code_)) {
+    return;
+  }
+  const CompiledAction& action = pressed_[code];
+  if (action.kind == Kind::kTransparent) {
+    Emit(EV_KEY, code, 2);
+  } else if (action.kind == Kind::kKeys) {
+    Emit(EV_KEY, action.codes[action.count - 1], 2);
+  }
+}
+
+void RemapEngine::PressKey(std::uint16_t code, std::int64_t time_us) {
+  if (tap_pending_) {
+    // Another key pressed while a tap-hold key is held: it is a hold.
+    ResolveTapHold(/*hold=*/true);
+  }
+  const CompiledAction& action = Lookup(code);
+  down_.set(code);
+  pressed_[code] = action;
+  if (action.kind == Kind::kTapHold) {
+    tap_pending_ = true;
+    tap_code_ = code;
+    tap_deadline_us_ = time_us + tapping_term_us_;
+    return;
+  }
+  PressAction(action, code);
+}
+
+void RemapEngine::PressAction(const CompiledAction& action,
+                              std::uint16_t code) {
+  switch (action.kind) {
+    case Kind::kTransparent:
+      EmitKey(code, 1);
+      break;
+    case Kind::kKeys:
+      for (std::size_t i = 0; i < action.count; ++i) {
+        EmitKey(action.codes[i], 1);
+      }
+      break;
+    case Kind::kLayer:
+      ++layer_holds_[action.layer];
+      held_layers_ |= (1U << action.layer);
+      break;
+    case Kind::kToggleLayer:
+      toggled_layers_ ^= (1U << action.layer);
+      break;
+    case Kind::kNone:
+    case Kind::kTapHold:
+      break;
+  }
+}
+
+void RemapEngine::ReleaseAction(const CompiledAction& action,
+                                std::uint16_t code) {
+  switch (action.kind) {
+    case Kind::kTransparent:
+      EmitKey(code, 0);
+      break;
+    case Kind::kKeys:
+      for (std::size_t i = action.count; i > 0; --i) {
+        EmitKey(action.codes[i - 1], 0);
+      }
+      break;
+    case Kind::kLayer:
+      if (layer_holds_[action.layer] > 0 &&
+          --layer_holds_[action.layer] == 0) {
+        held_layers_ &= ~(1U << action.layer);
+      }
+      break;
+    case Kind::kToggleLayer:
+    case Kind::kNone:
+    case Kind::kTapHold:
+      break;
+  }
+}
+
+void RemapEngine::ResolveTapHold(bool hold) {
+  tap_pending_ = false;
+  CompiledAction& action = pressed_[tap_code_];
+  if (!hold) {
+    down_.reset(tap_code_);
+    EmitKey(action.tap, 1);
+    EmitKey(action.tap, 0);
+    return;
+  }
+  // From now on, the key acts as its hold action.
+  action.kind = (action.count > 0 ? Kind::kKeys : Kind::kLayer);
+  PressAction(action, tap_code_);
+}
+
+bool RemapEngine::TryExtendChord(std::uint16_t code) {
+  if (chord_count_ >= kMaxChordKeys ||
+      Contains(chord_keys_, chord_count_, code)) {
+    return false;
+  }
+  chord_keys_[chord_count_] = code;
+  const std::size_t count = chord_count_ + 1;
+  bool is_prefix = false;
+  for (const auto& chord : chords_) {
+    if (chord.count < count ||
+        !std::all_of(chord_keys_.begin(), chord_keys_.begin() + count,
+                     [&chord](std::uint16_t key) {
+                       return Contains(chord.keys, chord.count, key);
+                     })) {
+      continue;
+    }
+    if (chord.count != count) {
+      is_prefix = true;
+      continue;
+    }
+    // The shortest chord matching the keys pressed so far wins.
+    chord_count_ = 0;
+    if (tap_pending_) {
+      ResolveTapHold(/*hold=*/true);
+    }
+    if (chord_active_) {
+      ReleaseChord();
+    }
+    for (std::size_t i = 0; i < chord.count; ++i) {
+      down_.set(chord.keys[i]);
+      pressed_[chord.keys[i]] = CompiledAction{.kind = Kind::kNone};
+    }
+    active_chord_ = chord;
+    chord_active_ = true;
+    PressAction(chord.action, chord.keys[0]);
+    return true;
+  }
+  if (is_prefix) {
+    chord_count_ = static_cast<std::uint8_t>(count);
+  }
+  return is_prefix;
+}
+
+void RemapEngine::FlushChord(std::int64_t time_us) {
+  const std::array<std::uint16_t, kMaxChordKeys> keys = chord_keys_;
+  const std::size_t count = chord_count_;
+  chord_count_ = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    PressKey(keys[i], time_us);
+  }
+}
+
+void RemapEngine::ReleaseChord() {
+  chord_active_ = false;
+  ReleaseAction(active_chord_.action, active_chord_.keys[0]);
+}
+
+void RemapEngine::EmitKey(std::uint16_t code, std::int32_t value) {
+  if (value != 0) {
+    if (output_holds_[code]++ == 0) {
+      Emit(EV_KEY, code, 1);
+    }
+  } else if (output_holds_[code] > 0 && --output_holds_[code] == 0) {
+    Emit(EV_KEY, code, 0);
+  }
+}
+
+void RemapEngine::Emit(std::uint16_t etype, std::uint16_t code,
+                       std::int32_t value) {
+  if (out_count_ == out_buffer_.size()) {
+    // Events are only delivered on `SYN_REPORT`, so a frame can be written
+    // in several parts.
+    if (auto st = FlushOutput(); !st.ok() && write_status_.ok()) {
+      write_status_ = st;
+    }
+  }
+  input_event& event = out_buffer_[out_count_++];
+  event.type = etype;
+  event.code = code;
+  event.value = value;
+}
+
+absl::Status RemapEngine::Sync() {
+  if (out_count_ == 0) {
+    return absl::OkStatus();
+  }
+  Emit(EV_SYN, SYN_REPORT, 0);
+  return FlushOutput();
+}
+
+absl::Status RemapEngine::FlushOutput() {
+  const std::size_t count = std::exchange(out_count_, 0);
+  if (count == 0 || output_ == nullptr) {
+    return absl::OkStatus();
+  }
+  return output_->WriteRaw({out_buffer_.data(), count});
+}
+
+}  // namespace evdevpp
@@ -0,0 +1,220 @@
+#ifndef EVDEVPP_EVDEVPP_REMAP_H_
+#define EVDEVPP_EVDEVPP_REMAP_H_
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "evdevpp/eventio.h"
+#include "evdevpp/events.h"
+#include "evdevpp/info.h"
+#include "linux/input.h"
+
+namespace evdevpp {
+
+// What a key does on a layer of a `RemapConfig`.
+struct RemapAction {
+  enum class Kind : std::uint8_t {
+    // Use the action of the next active layer below. On the base layer,
+    // the key is passed through unchanged.
+    kTransparent,
+    // Swallow the key.
+    kNone,
+    // Press `codes` in order (e.g., a modifier and a key), release them in
+    // reverse order.
+    kKeys,
+    // Activate `layer` while the key is held.
+    kLayer,
+    // Toggle `layer` on each press.
+    kToggleLayer,
+    // Tap-hold: a press and release within the tapping term, without any
+    // other key pressed in between, is a tap of `tap`. Otherwise, the key
+    // acts as `codes` (if not empty) or as `layer` (momentary) while held.
+    kTapHold,
+  };
+
+  Kind kind = Kind::kTransparent;
+  std::vector<std::uint16_t> codes;
+  std::uint16_t tap = 0;
+  int layer = 0;
+
+  static RemapAction None() { return {.kind = Kind::kNone}; }
+  static RemapAction Keys(std::vector<std::uint16_t> codes) {
+    return {.kind = Kind::kKeys, .codes = std::move(codes)};
+  }
+  static RemapAction Layer(int layer) {
+    return {.kind = Kind::kLayer, .layer = layer};
+  }
+  static RemapAction ToggleLayer(int layer) {
+    return {.kind = Kind::kToggleLayer, .layer = layer};
+  }
+  static RemapAction TapHold(std::uint16_t tap,
+                             std::vector<std::uint16_t> hold) {
+    return {.kind = Kind::kTapHold, .codes = std::move(hold), .tap = tap};
+  }
+  static RemapAction TapHoldLayer(std::uint16_t tap, int layer) {
+    return {.kind = Kind::kTapHold, .tap = tap, .layer = layer};
+  }
+};
+
+struct RemapLayer {
+  std::string name;
+  // Keys not listed are transparent.
+  absl::flat_hash_map<std::uint16_t, RemapAction> keys;
+};
+
+// Keys pressed together (within the chord term) that trigger an action of
+// their own, instead of their individual actions.
+struct RemapChord {
+  std::vector<std::uint16_t> keys;
+  RemapAction action;
+};
+
+// A declarative key remapping, e.g., caps-lock to control:
+//
+//   RemapConfig config;
+//   config.layers.push_back(
+//       {.name = "base",
+//        .keys = {{Key::kCapslock, RemapAction::Keys({Key::kLeftctrl})}}});
+struct RemapConfig {
+  // Layer 0 is the base layer, which is always active. Higher layers take
+  // precedence over lower ones.
+  std::vector<RemapLayer> layers;
+  std::vector<RemapChord> chords;
+  absl::Duration tapping_term = absl::Milliseconds(200);
+  absl::Duration chord_term = absl::Milliseconds(50);
+};
+
+// Key remapping engine.
+//
+// The config is compiled into a dense `code -> action` array per layer, so
+// that resolving a key is an array lookup per active layer. The engine has
+// fixed-size state (held keys, output buffer, at most one pending tap-hold
+// and one pending chord), and does not allocate while processing events.
+//
+// Events are written to `output` (typically a `UserInputDevice` with the
+// capabilities returned by `OutputCapabilities`), batched per frame.
+// Non-key events are passed through.
+//
+// When a tap-hold or chord is pending, `Tick` must be called at (or after)
+// `NextDeadline`, e.g., by using it as the timeout of the wait for input.
+class RemapEngine {
+ public:
+  static constexpr std::size_t kMaxLayers = 32;
+  static constexpr std::size_t kMaxActionCodes = 4;
+  static constexpr std::size_t kMaxChordKeys = 4;
+
+  static absl::StatusOr<RemapEngine> Create(const RemapConfig& config,
+                                            const EventIO* output);
+
+  // Process an input event.
+  absl::Status Process(const input_event& event);
+  absl::Status Process(absl::Span<const input_event> events);
+  absl::Status Process(const InputEvent& event);
+
+  // The time at which `Tick` must be called, or `InfiniteFuture` if nothing
+  // is pending.
+  [[nodiscard]] absl::Time NextDeadline() const;
+  // Resolve the tap-holds and chords that timed out at `now`, on the clock
+  // of the event timestamps.
+  absl::Status Tick(absl::Time now);
+
+  // Release all keys held on the output, and clear all state.
+  absl::Status Reset();
+
+  // Bit mask of the active layers.
+  [[nodiscard]] std::uint32_t ActiveLayers() const {
+    return 1U | toggled_layers_ | held_layers_;
+  }
+
+  // Capabilities needed on the output device, given those of the input.
+  [[nodiscard]] CapabilitiesInfo OutputCapabilities(
+      const CapabilitiesInfo& input) const;
+
+ private:
+  static constexpr std::size_t kKeyCount = KEY_CNT;
+
+  struct CompiledAction {
+    RemapAction::Kind kind = RemapAction::Kind::kTransparent;
+    std::uint8_t layer = 0;
+    std::uint8_t count = 0;
+    std::uint16_t tap = 0;
+    std::array<std::uint16_t, kMaxActionCodes> codes{};
+  };
+  struct CompiledChord {
+    std::uint8_t count = 0;
+    std::array<std::uint16_t, kMaxChordKeys> keys{};
+    CompiledAction action;
+  };
+  static absl::StatusOr<CompiledAction> Compile(const RemapAction& action,
+                                                std::size_t layer_count);
+
+  const CompiledAction& Lookup(std::uint16_t code) const;
+  void OnPress(std::uint16_t code, std::int64_t time_us);
+  void OnRelease(std::uint16_t code, std::int64_t time_us);
+  void OnRepeat(std::uint16_t code);
+  // Press `code` past the chord stage.
+  void PressKey(std::uint16_t code, std::int64_t time_us);
+  void PressAction(const CompiledAction& action, std::uint16_t code);
+  void ReleaseAction(const CompiledAction& action, std::uint16_t code);
+  void ResolveTapHold(bool hold);
+  bool TryExtendChord(std::uint16_t code);
+  void FlushChord(std::int64_t time_us);
+  void ReleaseChord();
+
+  void EmitKey(std::uint16_t code, std::int32_t value);
+  void Emit(std::uint16_t etype, std::uint16_t code, std::int32_t value);
+  absl::Status Sync();
+  absl::Status FlushOutput();
+
+  const EventIO* output_ = nullptr;
+  std::int64_t tapping_term_us_ = 0;
+  std::int64_t chord_term_us_ = 0;
+  // Dense action tables, `layer * kKeyCount + code`.
+  std::vector<CompiledAction> actions_;
+  std::size_t layer_count_ = 0;
+  std::vector<CompiledChord> chords_;
+  std::bitset<kKeyCount> chord_members_;
+
+  // Layer state.
+  std::uint32_t toggled_layers_ = 0;
+  std::uint32_t held_layers_ = 0;
+  std::array<std::uint8_t, kMaxLayers> layer_holds_{};
+
+  // The action each held input key resolved to when pressed, so that it is
+  // released the same way even if layers changed in between.
+  std::bitset<kKeyCount> down_;
+  std::vector<CompiledAction> pressed_;
+  // Press count of each output key, from all the actions that hold it.
+  std::array<std::uint8_t, kKeyCount> output_holds_{};
+
+  // Pending tap-hold.
+  bool tap_pending_ = false;
+  std::uint16_t tap_code_ = 0;
+  std::int64_t tap_deadline_us_ = 0;
+
+  // Pending chord (keys pressed so far) and active chord.
+  std::uint8_t chord_count_ = 0;
+  std::array<std::uint16_t, kMaxChordKeys> chord_keys_{};
+  std::int64_t chord_deadline_us_ = 0;
+  bool chord_active_ = false;
+  CompiledChord active_chord_;
+
+  // Output events of the current frame.
+  std::array<input_event, 128> out_buffer_{};
+  std::size_t out_count_ = 0;
+  // Error of a write forced by a full buffer, returned by `Process`.
+  absl::Status write_status_;
+};
+
+}  // namespace evdevpp
+
+#endif  // EVDEVPP_EVDEVPP_REMAP_H_
@@ -0,0 +1,155 @@
+#include "evdevpp/replay.h"
+
+#include <sys/prctl.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+
+#include "linux/input.h"
+#include "toolbelt/fd.h"
+
+namespace evdevpp {
+
+namespace {
+
+// Longest single sleep, so that `Stop` is noticed during long pauses.
+constexpr std::int64_t kMaxSleepNanos = 100'000'000;
+
+// Sleep on `timer` until `wake_nanos` (CLOCK_MONOTONIC), at most
+// `kMaxSleepNanos`. Returns immediately if the time has passed.
+absl::Status SleepUntil(const toolbelt::FileDescriptor& timer,
+                        std::int64_t wake_nanos) {
+  const std::int64_t now = MonotonicNanos();
+  if (wake_nanos <= now) {
+    return absl::OkStatus();
+  }
+  wake_nanos = std::min(wake_nanos, now + kMaxSleepNanos);
+  itimerspec spec{};
+  spec.it_value.tv_sec = wake_nanos / 1'000'000'000;
+  spec.it_value.tv_nsec = wake_nanos % 1'000'000'000;
+  if (::timerfd_settime(timer.Fd(), TFD_TIMER_ABSTIME, &spec, nullptr) < 0) {
+    return absl::ErrnoToStatus(errno, "Arming replay timer failed");
+  }
+  std::uint64_t expirations = 0;
+  while (::read(timer.Fd(), &expirations, sizeof(expirations)) < 0) {
+    if (errno != EINTR) {
+      return absl::ErrnoToStatus(errno, "Waiting on replay timer failed");
+    }
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+absl::StatusOr<EventReplayer::Report> EventReplayer::Run() {
+  if (!(options_.speed > 0.0)) {
+    return absl::InvalidArgumentError("Replay speed must be positive");
+  }
+  toolbelt::FileDescriptor timer(
+      ::timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC));
+  if (!timer.IsOpen()) {
+    return absl::ErrnoToStatus(errno, "Creating replay timer failed");
+  }
+  // The default timer slack (50us) would eat most of the spin window.
+  // Tighten it for the duration of the replay.
+  struct TimerSlackGuard {
+    int previous = ::prctl(PR_GET_TIMERSLACK, 0, 0, 0, 0);
+    TimerSlackGuard() { (void)::prctl(PR_SET_TIMERSLACK, 1, 0, 0, 0); }
+    ~TimerSlackGuard() {
+      if (previous > 0) {
+        (void)::prctl(PR_SET_TIMERSLACK, previous, 0, 0, 0);
+      }
+    }
+  } timer_slack_guard;
+
+  const std::int64_t spin_nanos =
+      absl::ToInt64Nanoseconds(options_.spin_window);
+  const double nanos_per_capture_us = 1000.0 / options_.speed;
+
+  // Wait until `target_nanos`, sleeping as long as possible then spinning.
+  // Returns false if stopped.
+  auto wait_until = [&](std::int64_t target_nanos) -> absl::StatusOr<bool> {
+    while (MonotonicNanos() < target_nanos - spin_nanos) {
+      if (stop_) {
+        return false;
+      }
+      if (auto st = SleepUntil(timer, target_nanos - spin_nanos); !st.ok()) {
+        return st;
+      }
+    }
+    while (MonotonicNanos() < target_nanos) {
+    }
+    return !stop_;
+  };
+
+  Report report;
+  std::vector<std::vector<InputEvent>> frames(sinks_.size());
+  for (int loop = 0; options_.loops == 0 || loop < options_.loops; ++loop) {
+    if (loop > 0 && options_.loop_gap > absl::ZeroDuration()) {
+      auto waited_or = wait_until(
+          MonotonicNanos() + absl::ToInt64Nanoseconds(options_.loop_gap));
+      if (!waited_or.ok()) {
+        return waited_or.status();
+      }
+    }
+    if (stop_) {
+      break;
+    }
+    for (auto& frame : frames) {
+      frame.clear();
+    }
+
+    // The schedule is anchored on the first frame of each loop.
+    std::int64_t base_capture_us = 0;
+    std::int64_t base_nanos = -1;
+    auto cursor = reader_->Begin();
+    while (const CaptureRecord* record = cursor.Next()) {
+      if (record->device >= sinks_.size() ||
+          sinks_[record->device] == nullptr) {
+        continue;
+      }
+      if (record->type == EV_SYN && record->code == SYN_DROPPED) {
+        ++report.syn_dropped;
+        continue;
+      }
+      auto& frame = frames[record->device];
+      frame.push_back(record->ToInputEvent());
+      if (record->type != EV_SYN || record->code != SYN_REPORT) {
+        continue;
+      }
+
+      if (base_nanos < 0) {
+        base_capture_us = record->time_us;
+        base_nanos = MonotonicNanos();
+      }
+      const std::int64_t target_nanos =
+          base_nanos +
+          static_cast<std::int64_t>(
+              static_cast<double>(record->time_us - base_capture_us) *
+              nanos_per_capture_us);
+      auto waited_or = wait_until(target_nanos);
+      if (!waited_or.ok()) {
+        return waited_or.status();
+      }
+      if (!*waited_or) {
+        return report;
+      }
+      report.scheduling_error.RecordNanos(MonotonicNanos() - target_nanos);
+      if (auto st = sinks_[record->device]->Write(frame); !st.ok()) {
+        return st;
+      }
+      ++report.frames;
+      report.events += frame.size();
+      frame.clear();
+    }
+    if (!cursor.DecodeStatus().ok()) {
+      return cursor.DecodeStatus();
+    }
+    ++report.loops;
+  }
+  return report;
+}
+
+}  // namespace evdevpp
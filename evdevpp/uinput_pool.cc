@@ -0,0 +1,247 @@
+#include "evdevpp/uinput_pool.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "fmt/format.h"
+#include "linux/input.h"
+#include "linux/uinput.h"
+
+namespace evdevpp {
+
+namespace {
+
+template <typename CodeSet>
+void AppendSortedCodes(std::string& out, char tag, const CodeSet& codes) {
+  std::vector<std::uint16_t> sorted;
+  sorted.reserve(codes.size());
+  for (const auto& code : codes) {
+    if constexpr (std::is_convertible_v<decltype(code), std::uint16_t>) {
+      sorted.push_back(code);
+    } else {
+      sorted.push_back(code.first);
+    }
+  }
+  std::sort(sorted.begin(), sorted.end());
+  fmt::format_to(std::back_inserter(out), "{}{}:", tag, sorted.size());
+  for (auto code : sorted) {
+    fmt::format_to(std::back_inserter(out), "{:X},", code);
+  }
+}
+
+std::string MakeFingerprint(const std::string& devnode,
+                            const std::string& name, const std::string& phys,
+                            const DeviceInfo& info,
+                            const std::vector<Property>& input_props,
+                            int max_effects, const CapabilitiesInfo& caps) {
+  std::string result = fmt::format(
+      "{}|{}:{}|{}:{}|{:X}:{:X}:{:X}:{:X}|{}|", devnode, name.size(), name,
+      phys.size(), phys, info.bustype, info.vendor, info.product, info.version,
+      max_effects);
+  std::vector<std::uint16_t> props;
+  props.reserve(input_props.size());
+  for (const auto& prop : input_props) {
+    props.push_back(prop.code);
+  }
+  AppendSortedCodes(result, 'P', props);
+  AppendSortedCodes(result, 'K', caps.keys);
+  AppendSortedCodes(result, 'R', caps.relative_axes);
+  AppendSortedCodes(result, 'M', caps.miscs);
+  AppendSortedCodes(result, 'W', caps.switches);
+  AppendSortedCodes(result, 'L', caps.leds);
+  AppendSortedCodes(result, 'S', caps.sounds);
+  AppendSortedCodes(result, 'F', caps.force_feedbacks);
+  // Absolute axes are only equivalent if their ranges are equal too.
+  std::vector<std::pair<std::uint16_t, AbsInfo>> abs_axes(
+      caps.absolute_axes.begin(), caps.absolute_axes.end());
+  std::sort(abs_axes.begin(), abs_axes.end(),
+            [](const auto& lhs, const auto& rhs) {
+              return lhs.first < rhs.first;
+            });
+  fmt::format_to(std::back_inserter(result), "A{}:", abs_axes.size());
+  for (const auto& [code, absinfo] : abs_axes) {
+    fmt::format_to(std::back_inserter(result), "{:X}={},{},{},{},{},{};", code,
+                   absinfo.value, absinfo.minimum, absinfo.maximum,
+                   absinfo.fuzz, absinfo.flat, absinfo.resolution);
+  }
+  return result;
+}
+
+bool IsMultiTouchAxis(std::uint16_t code) {
+  return code >= ABS_MT_SLOT && code <= ABS_MT_TOOL_Y;
+}
+
+}  // namespace
+
+std::string UInputPool::Fingerprint(
+    const UserInputDevice::CreateOptions& options) {
+  return MakeFingerprint(options.devnode, options.name, options.phys,
+                         options.info, options.input_props,
+                         options.max_effects, options.capabilities);
+}
+
+std::string UInputPool::Fingerprint(const UserInputDevice& device) {
+  return MakeFingerprint(device.DevPath(), device.Name(), device.Phys(),
+                         device.Info(), device.Properties(),
+                         device.MaxEffects(), device.Capabilities());
+}
+
+absl::Status UInputPool::Prewarm(const UserInputDevice::CreateOptions& options,
+                                 std::size_t count) {
+  std::string fingerprint = Fingerprint(options);
+  for (std::size_t i = 0; i < count; ++i) {
+    // Create outside of the lock, creation is the slow part.
+    auto dev_or = UserInputDevice::Create(options);
+    if (!dev_or.ok()) {
+      return dev_or.status();
+    }
+    absl::MutexLock lock(&mu_);
+    idle_[fingerprint].emplace_back(std::move(*dev_or));
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<UserInputDevice> UInputPool::Acquire(
+    const UserInputDevice::CreateOptions& options) {
+  std::string fingerprint = Fingerprint(options);
+  {
+    absl::MutexLock lock(&mu_);
+    auto it = idle_.find(fingerprint);
+    if (it != idle_.end() && !it->second.empty()) {
+      UserInputDevice result = std::move(it->second.back());
+      it->second.pop_back();
+      return result;
+    }
+  }
+  return UserInputDevice::Create(options);
+}
+
+absl::Status UInputPool::Release(UserInputDevice device) {
+  if (!device.IsOpen()) {
+    return absl::InvalidArgumentError(
+        "Cannot release a closed user input device");
+  }
+  if (auto st = ResetState(device); !st.ok()) {
+    return st;
+  }
+  std::string fingerprint = Fingerprint(device);
+  absl::MutexLock lock(&mu_);
+  auto& idle = idle_[fingerprint];
+  if (idle.size() < options_.max_idle_per_fingerprint) {
+    idle.emplace_back(std::move(device));
+  }
+  return absl::OkStatus();
+}
+
+std::size_t UInputPool::IdleCount(
+    const UserInputDevice::CreateOptions& options) const {
+  std::string fingerprint = Fingerprint(options);
+  absl::MutexLock lock(&mu_);
+  auto it = idle_.find(fingerprint);
+  return (it == idle_.end() ? 0 : it->second.size());
+}
+
+void UInputPool::Clear() {
+  absl::flat_hash_map<std::string, std::deque<UserInputDevice>> to_destroy;
+  {
+    absl::MutexLock lock(&mu_);
+    to_destroy.swap(idle_);
+  }
+}
+
+absl::Status UInputPool::ResetState(const UserInputDevice& device) {
+  const CapabilitiesInfo& caps = device.Capabilities();
+  std::vector<InputEvent> events;
+  auto add_event = [&events](std::uint16_t etype, std::uint16_t code,
+                             std::int32_t value) {
+    events.emplace_back(absl::InfinitePast(), etype, code, value);
+  };
+
+  // Release held keys. Reading back the key state is a single ioctl, but it
+  // needs the companion input device (and we do not want to wait for it).
+  // Otherwise, release every key; the input core drops releases of keys that
+  // are not held.
+  absl::StatusOr<absl::flat_hash_set<std::uint16_t>> held_or =
+      absl::UnavailableError("No companion input device");
+  if (device.DeviceReady() && device.Device().IsOpen()) {
+    held_or = device.Device().GetActiveKeys();
+  }
+  const auto& held = (held_or.ok() ? *held_or : caps.keys);
+  events.reserve(held.size() + caps.switches.size() +
+                 caps.absolute_axes.size() + 2);
+  for (auto code : held) {
+    add_event(EV_KEY, code, 0);
+  }
+
+  for (auto code : caps.switches) {
+    add_event(EV_SW, code, 0);
+  }
+
+  // Lift all multi-touch contacts and go back to the first slot.
+  if (auto slot_it = caps.absolute_axes.find(ABS_MT_SLOT);
+      slot_it != caps.absolute_axes.end() &&
+      caps.absolute_axes.contains(ABS_MT_TRACKING_ID)) {
+    for (std::int32_t slot = slot_it->second.minimum;
+         slot <= slot_it->second.maximum; ++slot) {
+      add_event(EV_ABS, ABS_MT_SLOT, slot);
+      add_event(EV_ABS, ABS_MT_TRACKING_ID, -1);
+    }
+    add_event(EV_ABS, ABS_MT_SLOT, slot_it->second.minimum);
+  }
+
+  for (const auto& [code, absinfo] : caps.absolute_axes) {
+    if (IsMultiTouchAxis(code)) {
+      continue;
+    }
+    add_event(EV_ABS, code,
+              (absinfo.minimum <= absinfo.maximum
+                   ? std::clamp(0, absinfo.minimum, absinfo.maximum)
+                   : 0));
+  }
+
+  add_event(EV_SYN, SYN_REPORT, 0);
+  if (auto st = device.Write(events); !st.ok()) {
+    return st;
+  }
+
+  // Drop feedback events (LEDs, sounds) left over from the previous user.
+  // Effect requests block their sender until answered, so refuse them as
+  // if the device was gone.
+  auto drained_or = device.ReadAll();
+  if (!drained_or.ok()) {
+    return drained_or.status();
+  }
+  for (const InputEvent& event : *drained_or) {
+    if (event.type != EV_UINPUT) {
+      continue;
+    }
+    const auto request_id = static_cast<std::uint32_t>(event.value);
+    if (event.code == UI_FF_UPLOAD) {
+      auto upload_or = device.BeginUpload(request_id);
+      if (!upload_or.ok()) {
+        return upload_or.status();
+      }
+      upload_or->retval = -ENODEV;
+      if (auto st = device.EndUpload(*upload_or); !st.ok()) {
+        return st;
+      }
+    } else if (event.code == UI_FF_ERASE) {
+      auto erase_or = device.BeginErase(request_id);
+      if (!erase_or.ok()) {
+        return erase_or.status();
+      }
+      erase_or->retval = -ENODEV;
+      if (auto st = device.EndErase(*erase_or); !st.ok()) {
+        return st;
+      }
+    }
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace evdevpp
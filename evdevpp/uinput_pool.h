@@ -0,0 +1,99 @@
+#ifndef EVDEVPP_EVDEVPP_UINPUT_POOL_H_
+#define EVDEVPP_EVDEVPP_UINPUT_POOL_H_
+
+#include <cstddef>
+#include <deque>
+#include <string>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "evdevpp/user_device.h"
+
+namespace evdevpp {
+
+// A pool of already created ("warm") user input devices.
+//
+// Creating a user input device is expensive: one ioctl per enabled event
+// code, `UI_DEV_CREATE`, and then discovery of the new device node. When
+// devices with the same configuration are created and destroyed over and
+// over (e.g., one virtual keyboard per test case), the pool hands out
+// devices that were created earlier and reset on release instead.
+//
+// Devices are keyed by a fingerprint of their creation options (name,
+// identity, capabilities, properties, etc.), so a device is only ever reused
+// for an identical configuration.
+//
+//   UInputPool pool;
+//   (void)pool.Prewarm(keyboard_options, 4);
+//   auto kbd_or = pool.Acquire(keyboard_options);
+//   ... inject events ...
+//   (void)pool.Release(std::move(*kbd_or));
+//
+// All member functions are thread-safe.
+class UInputPool {
+ public:
+  struct Options {
+    // Maximum number of idle devices kept per fingerprint. Devices released
+    // beyond this are destroyed.
+    std::size_t max_idle_per_fingerprint = 8;
+  };
+  // Work-around for GCC/Clang bug.
+  static Options Defaults() { return Options{}; }
+
+  explicit UInputPool(const Options& options = Defaults())
+      : options_(options) {}
+
+  UInputPool(const UInputPool&) = delete;
+  UInputPool& operator=(const UInputPool&) = delete;
+  UInputPool(UInputPool&&) = delete;
+  UInputPool& operator=(UInputPool&&) = delete;
+  ~UInputPool() = default;
+
+  // Return a canonical fingerprint of the creation options. Two option sets
+  // with equal fingerprints create indistinguishable devices.
+  static std::string Fingerprint(
+      const UserInputDevice::CreateOptions& options);
+  static std::string Fingerprint(const UserInputDevice& device);
+
+  // Create `count` devices for `options` ahead of time.
+  absl::Status Prewarm(const UserInputDevice::CreateOptions& options,
+                       std::size_t count);
+
+  // Take an idle device matching `options`, or create one if there is none.
+  absl::StatusOr<UserInputDevice> Acquire(
+      const UserInputDevice::CreateOptions& options =
+          UserInputDevice::Defaults());
+
+  // Return a device to the pool. Its state is reset first: held keys are
+  // released, switches are turned off, absolute axes are zeroed (clamped to
+  // their range), multi-touch contacts are lifted and pending feedback
+  // events are drained, with pending effect uploads and erasures refused
+  // (`-ENODEV`). If the reset fails, the device is destroyed and the error
+  // is returned.
+  absl::Status Release(UserInputDevice device);
+
+  // Number of idle devices matching `options`.
+  [[nodiscard]] std::size_t IdleCount(
+      const UserInputDevice::CreateOptions& options) const;
+
+  // Destroy all idle devices.
+  void Clear();
+
+  // Reset the input state of `device` as described in `Release`.
+  static absl::Status ResetState(const UserInputDevice& device);
+
+ private:
+  Options options_;
+  mutable absl::Mutex mu_;
+  // A deque never relocates its elements, which matters because copying a
+  // `UserInputDevice` and destroying the original destroys the device.
+  absl::flat_hash_map<std::string, std::deque<UserInputDevice>> idle_
+      ABSL_GUARDED_BY(mu_);
+};
+
+}  // namespace evdevpp
+
+#endif  // EVDEVPP_EVDEVPP_UINPUT_POOL_H_
@@ -1,10 +1,21 @@
 #include "evdevpp/user_device.h"
 
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
 #include <cerrno>
 #include <cstdint>
 #include <filesystem>
+#include <fstream>
+#include <future>
+#include <string_view>
 #include <type_traits>
+#include <utility>
 
+#include "absl/synchronization/mutex.h"
 #include "evdevpp/info.h"
 #include "linux/uinput.h"
 
@@ -80,19 +91,30 @@ void MergeIfNotExcluded(std::uint16_t etype,
   }
 }
 
+// How long to wait for the device node of a newly created device to show up
+// with usable permissions.
+constexpr absl::Duration kDeviceNodeTimeout = absl::Seconds(2);
+
+// Checks that `basename` has the format "event[0-9]+".
+bool IsEventNodeName(std::string_view basename) {
+  return basename.size() > 5 && basename.substr(0, 5) == "event" &&
+         std::all_of(basename.begin() + 5, basename.end(),
+                     [](char c) { return std::isdigit(c) != 0; });
+}
+
 // Tries to find the device node when running on Linux.
-absl::StatusOr<InputDevice> FindDeviceLinux(const std::string& sysname) {
+absl::StatusOr<InputDevice> FindDeviceLinux(const std::string& sysname,
+                                            int cancel_fd) {
   // The sysfs entry for event devices should contain exactly one folder
   // whose name matches the format "event[0-9]+". It is then assumed that
   // the device node in /dev/input uses the same name.
   std::string syspath = fmt::format("/sys/devices/virtual/input/{}", sysname);
   std::string device_path;
+  std::error_code ec;
   for (const auto& dev_filename :
-       std::filesystem::directory_iterator(syspath)) {
+       std::filesystem::directory_iterator(syspath, ec)) {
     std::string_view dev_basename = dev_filename.path().filename().native();
-    if (dev_basename.substr(0, 5) == "event" &&
-        std::all_of(dev_basename.begin() + 5, dev_basename.end(),
-                    [](char c) { return std::isdigit(c) != 0; })) {
+    if (IsEventNodeName(dev_basename)) {
       device_path = fmt::format("/dev/input/{}", dev_basename);
       break;
     }
@@ -103,81 +125,85 @@ absl::StatusOr<InputDevice> FindDeviceLinux(const std::string& sysname) {
   }
 
   // It is possible that there is some delay before /dev/input/event* shows
-  // up on old systems that do not use devtmpfs, so if the device cannot be
-  // found, wait for a short amount and then try again once.
-  //
-  // Furthermore, even if devtmpfs is in use, it is possible that the device
-  // does show up immediately, but without the correct permissions that
-  // still need to be set by udev. Wait for up to two seconds for either the
-  // device to show up or the permissions to be set.
-  for (int attempt = 0; attempt < 19; ++attempt) {
-    if (auto dev_or = InputDevice::Open(device_path); dev_or.ok()) {
-      return std::move(*dev_or);
-    }
-    absl::SleepFor(absl::Milliseconds(100));
-  }
-
-  // Last attempt. If this fails, the status the last attempt is returned.
-  return InputDevice::Open(device_path);
+  // up on old systems that do not use devtmpfs. Furthermore, even if devtmpfs
+  // is in use, it is possible that the device does show up immediately, but
+  // without the correct permissions that still need to be set by udev. Wait
+  // for either the device to show up or the permissions to be set.
+  return InputDevice::OpenWhenReady(
+      device_path, absl::Now() + kDeviceNodeTimeout, cancel_fd);
 }
 
 // Tries to find the device node when UI_GET_SYSNAME is not available or
 // we're running on a system sufficiently exotic that we do not know how
 // to interpret its return value.
-absl::StatusOr<InputDevice> FindDeviceFallback(const std::string& ui_name) {
-  // bug: the device node might not be immediately available
-  absl::SleepFor(absl::Milliseconds(100));
-
+absl::StatusOr<InputDevice> FindDeviceFallback(const std::string& ui_name,
+                                               int cancel_fd) {
+  // Look up the event handler by name in sysfs instead of opening every
+  // device node. The sysfs entries are created synchronously with the
+  // device, so there is no need to wait for them.
+  //
   // There could also be another device with the same name already present,
-  // make sure to select the newest one.
-  // Strictly speaking, we cannot be certain that everything returned by
-  // ListDevices() ends at event[0-9]+: it might return something like
-  // "/dev/input/events_all". Find the devices that have the expected structure
-  // only.
-  std::vector<std::string> all_devices = ListDevices("/dev/input");
-  std::vector<std::string> candidate_devices;
-  candidate_devices.reserve(all_devices.size());
-  for (const auto& dev_path : all_devices) {
-    std::string_view dev_basename =
-        std::filesystem::path{dev_path}.filename().native();
-    if (dev_basename.substr(0, 5) == "event" &&
-        std::all_of(dev_basename.begin() + 5, dev_basename.end(),
-                    [](char c) { return std::isdigit(c) != 0; })) {
-      candidate_devices.emplace_back(
-          fmt::format("/dev/input/{}", dev_basename));
+  // make sure to select the newest one. The modification date of the entries
+  // is not reliable unfortunately, so we are picking the highest number.
+  constexpr std::string_view kSysClassInput = "/sys/class/input";
+  std::string best_basename;
+  std::uint64_t best_number = 0;
+  std::error_code ec;
+  for (const auto& dev_filename :
+       std::filesystem::directory_iterator(kSysClassInput, ec)) {
+    std::string dev_basename = dev_filename.path().filename().native();
+    if (!IsEventNodeName(dev_basename)) {
+      continue;
     }
-  }
-  // The modification date of the devnode is not reliable unfortunately, so we
-  // are sorting by the number in the name.
-  std::sort(candidate_devices.begin(), candidate_devices.end());
-
-  for (const auto& dev_path : candidate_devices) {
-    if (auto dev_or = InputDevice::Open(dev_path);
-        dev_or.ok() && dev_or->Name() == ui_name) {
-      return std::move(*dev_or);
+    std::ifstream name_file(dev_filename.path() / "device" / "name");
+    std::string dev_name;
+    if (!std::getline(name_file, dev_name) || dev_name != ui_name) {
+      continue;
+    }
+    std::uint64_t number = std::stoull(dev_basename.substr(5));
+    if (best_basename.empty() || number > best_number) {
+      best_basename = std::move(dev_basename);
+      best_number = number;
     }
   }
-  return absl::NotFoundError(
-      fmt::format("Could not find device matching name '{}'", ui_name));
+  if (best_basename.empty()) {
+    return absl::NotFoundError(
+        fmt::format("Could not find device matching name '{}'", ui_name));
+  }
+  return InputDevice::OpenWhenReady(
+      fmt::format("/dev/input/{}", best_basename),
+      absl::Now() + kDeviceNodeTimeout, cancel_fd);
 }
 
-// Tries to find the device node. Will delegate this task to one of
-// several platform-specific functions.
-absl::StatusOr<InputDevice> FindDevice(int fd, const std::string& ui_name) {
+// Returns the sysfs name of the uinput device, or an empty string if the
+// kernel cannot tell.
+std::string QuerySysname(int fd) {
 // If we have a recent Linux kernel, this should work.
 #if defined(__linux__) && defined(UI_GET_SYSNAME)
   std::array<char, 64> sysname{};
   if (VarTempIOCTL(fd, UI_GET_SYSNAME(sysname.size()), sysname.data()) >= 0) {
-    auto dev_or = FindDeviceLinux(sysname.data());
-    if (dev_or.ok()) {
-      return std::move(*dev_or);
-    }
+    return sysname.data();
   }
 #endif
+  return {};
+}
+
+// Tries to find the device node. Will delegate this task to one of
+// several platform-specific functions. Waiting for the device node stops
+// when `cancel_fd` is readable.
+absl::StatusOr<InputDevice> FindDevice(const std::string& sysname,
+                                       const std::string& ui_name,
+                                       int cancel_fd) {
+  if (!sysname.empty()) {
+    auto dev_or = FindDeviceLinux(sysname, cancel_fd);
+    if (dev_or.ok() || absl::IsCancelled(dev_or.status())) {
+      return dev_or;
+    }
+  }
 
   // If we're not running on Linux or the above method fails for any reason,
   // use the generic fallback method.
-  return FindDeviceFallback(ui_name);
+  return FindDeviceFallback(ui_name, cancel_fd);
 }
 
 }  // namespace
@@ -320,6 +346,7 @@ absl::StatusOr<UserInputDevice> UserInputDevice::Create(
   if (auto st = result.Setup(options.max_effects); !st.ok()) {
     return st;
   }
+  result.max_effects_ = options.max_effects;
 
   // Create the uinput device.
   if (VarTempIOCTL(fd, UI_DEV_CREATE) < 0) {
@@ -327,9 +354,37 @@ absl::StatusOr<UserInputDevice> UserInputDevice::Create(
   }
 
   // An `InputDevice` for the fake input device. It's OK if the device cannot be
-  // opened for reading and writing.
-  if (auto dev_or = FindDevice(fd, result.name_); dev_or.ok()) {
-    result.device_ = std::move(*dev_or);
+  // opened for reading and writing, `Device()` is then a closed device.
+  if (options.device_discovery == DeviceDiscovery::kSkip) {
+    return result;
+  }
+  if (options.device_discovery == DeviceDiscovery::kDeferred) {
+    // Signaled by `Close`, so that the device can be destroyed without
+    // waiting for the discovery to time out.
+    result.discovery_cancel_fd_ = toolbelt::FileDescriptor(
+        ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK));
+    if (!result.discovery_cancel_fd_.IsOpen()) {
+      return absl::ErrnoToStatus(errno, "Creating discovery eventfd failed");
+    }
+  }
+  // The discovery keeps its own reference to the eventfd, which outlives a
+  // `Close` of the device.
+  auto discover = [sysname = QuerySysname(fd), ui_name = result.name_,
+                   cancel_fd = result.discovery_cancel_fd_]() {
+    auto dev_or = FindDevice(sysname, ui_name, cancel_fd.Fd());
+    return (dev_or.ok() ? std::move(*dev_or) : InputDevice{});
+  };
+  result.discovery_ = std::make_shared<Discovery>();
+  {
+    absl::MutexLock lock(&result.discovery_->mu);
+    if (options.device_discovery == DeviceDiscovery::kDeferred) {
+      // Started by the first `Device()` or `DeviceReady()`.
+      result.discovery_->find = std::move(discover);
+    } else {
+      std::promise<InputDevice> found;
+      found.set_value(discover());
+      result.discovery_->device = found.get_future().share();
+    }
   }
 
   return result;
@@ -394,7 +449,41 @@ absl::StatusOr<UserInputDevice> UserInputDevice::CreateFromDevices(
   return CreateFromDevices(devices, excluded_event_types, options);
 }
 
+std::shared_future<InputDevice> UserInputDevice::StartDiscovery() const {
+  if (discovery_ == nullptr) {
+    return {};
+  }
+  absl::MutexLock lock(&discovery_->mu);
+  if (discovery_->find) {
+    discovery_->device =
+        std::async(std::launch::async, std::exchange(discovery_->find, {}))
+            .share();
+  }
+  return discovery_->device;
+}
+
+const InputDevice& UserInputDevice::Device() const {
+  std::shared_future<InputDevice> device = StartDiscovery();
+  if (!device.valid()) {
+    static const auto* const kNoDevice = new InputDevice();
+    return *kNoDevice;
+  }
+  // The result lives in the state shared with `discovery_`.
+  return device.get();
+}
+
+bool UserInputDevice::DeviceReady() const {
+  std::shared_future<InputDevice> device = StartDiscovery();
+  return !device.valid() || device.wait_for(std::chrono::seconds(0)) ==
+                                std::future_status::ready;
+}
+
 absl::Status UserInputDevice::Close() {
+  if (discovery_cancel_fd_.IsOpen()) {
+    const std::uint64_t one = 1;
+    (void)::write(discovery_cancel_fd_.Fd(), &one, sizeof(one));
+    discovery_cancel_fd_.Close();
+  }
   if (VarTempIOCTL(fd_.Fd(), UI_DEV_DESTROY) < 0) {
     int oerrno = errno;
     fd_.Close();
@@ -414,8 +503,9 @@ absl::StatusOr<UInputUpload> UserInputDevice::BeginUpload(
   UInputUpload result{};
   result.request_id = upload.request_id;
   result.retval = upload.retval;
-  result.effect = AnyEffect::FromData(&upload.effect);
-  result.old = AnyEffect::FromData(&upload.old);
+  // Custom samples are left in the memory of the uploading process.
+  result.effect = AnyEffect::FromUInputData(&upload.effect);
+  result.old = AnyEffect::FromUInputData(&upload.old);
   return result;
 }
 
@@ -432,9 +522,9 @@ absl::Status UserInputDevice::EndUpload(const UInputUpload& upload) const {
 }
 
 absl::StatusOr<UInputErase> UserInputDevice::BeginErase(
-    std::uint32_t effect_id) const {
+    std::uint32_t request_id) const {
   uinput_ff_erase erase{};
-  erase.effect_id = effect_id;
+  erase.request_id = request_id;
   if (VarTempIOCTL(fd_.Fd(), UI_BEGIN_FF_ERASE, &erase) < 0) {
     return absl::ErrnoToStatus(errno, "Failed to begin uinput erase.");
   }
@@ -450,7 +540,7 @@ absl::Status UserInputDevice::EndErase(const UInputErase& erase) const {
   to_erase.request_id = erase.request_id;
   to_erase.retval = erase.retval;
   to_erase.effect_id = erase.effect_id;
-  if (VarTempIOCTL(fd_.Fd(), UI_BEGIN_FF_ERASE, &to_erase) < 0) {
+  if (VarTempIOCTL(fd_.Fd(), UI_END_FF_ERASE, &to_erase) < 0) {
     return absl::ErrnoToStatus(errno, "Failed to end uinput erase.");
   }
   return absl::OkStatus();
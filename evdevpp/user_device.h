@@ -1,9 +1,13 @@
 #ifndef EVDEVPP_EVDEVPP_USER_DEVICE_H_
 #define EVDEVPP_EVDEVPP_USER_DEVICE_H_
 
+#include <functional>
+#include <future>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "absl/base/thread_annotations.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
@@ -11,6 +15,7 @@
 #include "evdevpp/ecodes.h"
 #include "evdevpp/eventio.h"
 #include "evdevpp/info.h"
+#include "toolbelt/fd.h"
 
 namespace evdevpp {
 
@@ -31,6 +36,18 @@ struct UInputErase {
 // linux input subsystem.
 class UserInputDevice : public EventIO {
  public:
+  // How the companion `InputDevice` (see `Device()`) is found after creation.
+  enum class DeviceDiscovery {
+    // Find and open it before `Create` returns.
+    kEager,
+    // Find and open it on a background thread, started by the first call
+    // to `Device()` or `DeviceReady()`. `Device()` then waits for it if it
+    // is not ready yet. Closing the device cancels it.
+    kDeferred,
+    // Do not look for it, `Device()` is always a closed device.
+    kSkip,
+  };
+
   struct CreateOptions {
     // The event types and codes that the uinput device will be able to
     // inject - defaults to all key codes.
@@ -52,6 +69,9 @@ class UserInputDevice : public EventIO {
     std::vector<Property> input_props;
     // Maximum simultaneous force-feedback effects.
     int max_effects = ForceFeedback::kMaxEffects;
+    // Discovering the device node is the slowest part of creating a device,
+    // and only needed to read back from it.
+    DeviceDiscovery device_discovery = DeviceDiscovery::kEager;
   };
   // Work-around for GCC/Clang bug.
   static CreateOptions Defaults() { return CreateOptions{}; }
@@ -87,13 +107,21 @@ class UserInputDevice : public EventIO {
   [[nodiscard]] const std::string& Name() const { return name_; }
   [[nodiscard]] const std::string& Phys() const { return phys_; }
   [[nodiscard]] const std::string& DevPath() const { return devnode_; }
-  [[nodiscard]] const InputDevice& Device() const { return device_; }
+  // The input device created for this user input device, for reading back
+  // the events and state. May block on first use with
+  // `DeviceDiscovery::kDeferred`. The device is closed if it could not be
+  // found or with `DeviceDiscovery::kSkip`.
+  [[nodiscard]] const InputDevice& Device() const;
+  // Check if `Device()` can be called without blocking. Starts a deferred
+  // discovery.
+  [[nodiscard]] bool DeviceReady() const;
   [[nodiscard]] const CapabilitiesInfo& Capabilities() const {
     return capabilities_;
   }
   [[nodiscard]] const std::vector<Property>& Properties() const {
     return input_props_;
   }
+  [[nodiscard]] int MaxEffects() const { return max_effects_; }
 
   // Inject a `SYN_REPORT` event into the input subsystem.
   absl::Status Synchronize() const {
@@ -101,7 +129,8 @@ class UserInputDevice : public EventIO {
   }
 
   // Wait for an EventType::kUinput event that will signal us that an
-  // effect upload/erase operation is in progress.
+  // effect upload/erase operation is in progress. See `FFServer` to answer
+  // these requests on a dedicated thread.
   //
   // if (event == UIForceFeedback::kUpload) {
   //   upload_or = device.BeginUpload(event.value);
@@ -118,10 +147,13 @@ class UserInputDevice : public EventIO {
   //     device.EndErase(*erase_or);
   //   }
   // }
+  //
+  // The custom samples of `FF_CUSTOM` effects are in the memory of the
+  // uploading process, the effects of `UInputUpload` have none.
   absl::StatusOr<UInputUpload> BeginUpload(std::uint32_t request_id) const;
   absl::Status EndUpload(const UInputUpload& upload) const;
 
-  absl::StatusOr<UInputErase> BeginErase(std::uint32_t effect_id) const;
+  absl::StatusOr<UInputErase> BeginErase(std::uint32_t request_id) const;
   absl::Status EndErase(const UInputErase& erase) const;
 
  private:
@@ -131,9 +163,25 @@ class UserInputDevice : public EventIO {
   std::string devnode_;
   CapabilitiesInfo capabilities_;
   std::vector<Property> input_props_;
-  InputDevice device_;
+  int max_effects_ = 0;
+
+  // The companion device, found once and shared between copies.
+  struct Discovery {
+    absl::Mutex mu;
+    // Finds the device, until the discovery is started.
+    std::function<InputDevice()> find ABSL_GUARDED_BY(mu);
+    std::shared_future<InputDevice> device ABSL_GUARDED_BY(mu);
+  };
+  // Null with `DeviceDiscovery::kSkip`. Destroying the last copy while a
+  // deferred discovery is running waits for it to finish, which `Close`
+  // cuts short through `discovery_cancel_fd_`.
+  std::shared_ptr<Discovery> discovery_;
+  // An eventfd cancelling the deferred discovery when readable.
+  toolbelt::FileDescriptor discovery_cancel_fd_;
 
   absl::Status Setup(std::uint32_t max_effects);
+  // The companion device, starting a deferred discovery if needed.
+  [[nodiscard]] std::shared_future<InputDevice> StartDiscovery() const;
 };
 
 }  // namespace evdevpp
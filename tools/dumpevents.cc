@@ -1,10 +1,13 @@
 
+#include <optional>
+
 #include "CLI/CLI.hpp"
 #include "absl/container/flat_hash_set.h"
 #include "absl/status/statusor.h"
 #include "absl/status/status.h"
 #include "evdevpp/device.h"
 #include "evdevpp/ecodes.h"
+#include "evdevpp/event_filter.h"
 #include "evdevpp/events.h"
 #include "evdevpp/info.h"
 #include "fmt/core.h"
@@ -35,12 +38,27 @@ int main(int argc, char** argv) {
   cli_de.add_flag("-r,--rumble", arg_rumble,
                   "Rumble device if read times out.");
 
+  std::string arg_filter;
+  cli_de.add_option("-f,--filter", arg_filter,
+                    "Only print the events matching this filter, e.g., "
+                    "'type == EV_KEY && code in {KEY_A..KEY_Z}'.");
+
   try {
     cli_de.parse(argc, argv);
   } catch (const CLI::ParseError& e) {
     return cli_de.exit(e);
   }
 
+  std::optional<EventFilter> filter;
+  if (!arg_filter.empty()) {
+    auto filter_or = EventFilter::Parse(arg_filter);
+    if (!filter_or.ok()) {
+      fmt::print(stderr, "Invalid filter: {}\n", filter_or.status().ToString());
+      return 1;
+    }
+    filter = std::move(*filter_or);
+  }
+
   absl::StatusOr<InputDevice> device_or = InputDevice::Open(arg_device_path);
   if (!device_or.ok()) {
     fmt::print(stderr, "Failed to open device: {}\n",
@@ -141,6 +159,9 @@ int main(int argc, char** argv) {
       return 3;
     }
     for (auto event : *events_or) {
+      if (filter.has_value() && !filter->Matches(event)) {
+        continue;
+      }
       const AnyInputEvent categorized_event = AnyInputEvent::Categorize(event);
       fmt::print("{}\n", categorized_event);
     }
@@ -0,0 +1,210 @@
+#include <sys/epoll.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <csignal>
+#include <deque>
+
+#include "CLI/CLI.hpp"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/time/clock.h"
+#include "evdevpp/capture.h"
+#include "evdevpp/device.h"
+#include "evdevpp/ecodes.h"
+#include "evdevpp/events.h"
+#include "fmt/core.h"
+#include "toolbelt/fd.h"
+
+using namespace evdevpp;
+
+namespace {
+
+volatile std::sig_atomic_t interrupted = 0;
+
+void OnInterrupt(int /*signum*/) { interrupted = 1; }
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  CLI::App cli_er{"Record events of evdev input devices to a capture file."};
+
+  std::vector<std::string> arg_device_paths;
+  cli_er.add_option("-d,--device_path", arg_device_paths, "Device path(s).")
+      ->required()
+      ->transform(CLI::EscapedString);
+
+  std::string arg_output = "capture.evcap";
+  cli_er.add_option("-o,--output", arg_output, "Capture file to write.");
+
+  bool arg_grab = false;
+  cli_er.add_flag("-g,--grab", arg_grab,
+                  "Grab the devices, so that other applications do not get "
+                  "their events while recording.");
+
+  double arg_duration = 0.0;
+  cli_er.add_option("-t,--duration", arg_duration,
+                    "Stop after this many seconds (0 to record until "
+                    "interrupted).");
+
+  bool arg_raw = false;
+  cli_er.add_flag("--raw", arg_raw, "Store records uncompressed.");
+
+  try {
+    cli_er.parse(argc, argv);
+  } catch (const CLI::ParseError& e) {
+    return cli_er.exit(e);
+  }
+
+  // Devices are never moved once opened, grabs refer to them.
+  std::deque<InputDevice> devices;
+  std::vector<CaptureDeviceInfo> device_infos;
+  for (const auto& dev_path : arg_device_paths) {
+    absl::StatusOr<InputDevice> device_or = InputDevice::Open(dev_path);
+    if (!device_or.ok()) {
+      fmt::print(stderr, "Failed to open device '{}': {}\n", dev_path,
+                 device_or.status().ToString());
+      return 1;
+    }
+    devices.emplace_back(std::move(*device_or));
+    auto info_or = CaptureDeviceInfo::FromDevice(devices.back());
+    if (!info_or.ok()) {
+      fmt::print(stderr, "Failed to read device '{}': {}\n", dev_path,
+                 info_or.status().ToString());
+      return 1;
+    }
+    device_infos.push_back(std::move(*info_or));
+  }
+
+  std::vector<InputDevice::ScopedGrab> grabs;
+  if (arg_grab) {
+    for (const auto& device : devices) {
+      auto grab_or = device.GrabInScope();
+      if (!grab_or.ok()) {
+        fmt::print(stderr, "Failed to grab device '{}': {}\n",
+                   device.DevPath(), grab_or.status().ToString());
+        return 1;
+      }
+      grabs.emplace_back(std::move(*grab_or));
+    }
+  }
+
+  CaptureWriter::Options writer_options;
+  if (arg_raw) {
+    writer_options.encoding = CaptureEncoding::kRaw;
+  }
+  absl::StatusOr<CaptureWriter> writer_or =
+      CaptureWriter::Create(arg_output, device_infos, writer_options);
+  if (!writer_or.ok()) {
+    fmt::print(stderr, "Failed to create capture file: {}\n",
+               writer_or.status().ToString());
+    return 2;
+  }
+  CaptureWriter writer = std::move(*writer_or);
+
+  toolbelt::FileDescriptor epoll_fd(::epoll_create1(EPOLL_CLOEXEC));
+  if (!epoll_fd.IsOpen()) {
+    fmt::print(stderr, "Failed to create epoll instance: {}\n",
+               absl::ErrnoToStatus(errno, "epoll_create1").ToString());
+    return 2;
+  }
+  for (std::size_t i = 0; i < devices.size(); ++i) {
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u32 = static_cast<std::uint32_t>(i);
+    if (::epoll_ctl(epoll_fd.Fd(), EPOLL_CTL_ADD, devices[i].Fd().Fd(), &ev) <
+        0) {
+      fmt::print(stderr, "Failed to watch device '{}': {}\n",
+                 devices[i].DevPath(),
+                 absl::ErrnoToStatus(errno, "epoll_ctl").ToString());
+      return 2;
+    }
+  }
+
+  std::signal(SIGINT, OnInterrupt);
+  std::signal(SIGTERM, OnInterrupt);
+
+  const absl::Time start = absl::Now();
+  const absl::Time deadline = (arg_duration > 0.0
+                                   ? start + absl::Seconds(arg_duration)
+                                   : absl::InfiniteFuture());
+  absl::Time last_report = start;
+  std::uint64_t last_records = 0;
+  std::uint64_t last_bytes = 0;
+  std::uint64_t syn_dropped = 0;
+  std::size_t open_devices = devices.size();
+  std::array<epoll_event, 16> ready{};
+
+  auto report = [&](absl::Time now) {
+    double secs = absl::ToDoubleSeconds(now - last_report);
+    if (secs <= 0.0) {
+      return;
+    }
+    fmt::print(stderr, "{:.0f} events/s, {:.0f} bytes/s, {} SYN_DROPPED\n",
+               static_cast<double>(writer.RecordCount() - last_records) / secs,
+               static_cast<double>(writer.BytesWritten() - last_bytes) / secs,
+               syn_dropped);
+    last_report = now;
+    last_records = writer.RecordCount();
+    last_bytes = writer.BytesWritten();
+  };
+
+  while (interrupted == 0 && open_devices > 0) {
+    absl::Time now = absl::Now();
+    if (now >= deadline) {
+      break;
+    }
+    if (now - last_report >= absl::Seconds(1)) {
+      report(now);
+    }
+    int timeout_ms = static_cast<int>(absl::ToInt64Milliseconds(
+        std::min(deadline - now, absl::Seconds(1) - (now - last_report))));
+    int count = ::epoll_wait(epoll_fd.Fd(), ready.data(),
+                             static_cast<int>(ready.size()),
+                             std::max(timeout_ms, 0));
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      fmt::print(stderr, "Failed to wait for events: {}\n",
+                 absl::ErrnoToStatus(errno, "epoll_wait").ToString());
+      return 3;
+    }
+    for (int i = 0; i < count; ++i) {
+      std::uint32_t index = ready[i].data.u32;
+      InputDevice& device = devices[index];
+      absl::StatusOr<std::vector<InputEvent>> events_or = device.ReadAll();
+      if (!events_or.ok()) {
+        // Typically ENODEV, the device was unplugged.
+        fmt::print(stderr, "Stopped reading device '{}': {}\n",
+                   device.DevPath(), events_or.status().ToString());
+        (void)::epoll_ctl(epoll_fd.Fd(), EPOLL_CTL_DEL, device.Fd().Fd(),
+                          nullptr);
+        --open_devices;
+        continue;
+      }
+      for (const auto& event : *events_or) {
+        if (event.type == EventType::kSyn && event.code == Synch::kDropped) {
+          ++syn_dropped;
+        }
+        writer.Append(static_cast<std::uint16_t>(index), event);
+      }
+    }
+  }
+
+  if (auto st = writer.Close(); !st.ok()) {
+    fmt::print(stderr, "Failed to write capture file: {}\n", st.ToString());
+    return 4;
+  }
+  const double total_secs = absl::ToDoubleSeconds(absl::Now() - start);
+  fmt::print(stderr,
+             "Recorded {} events from {} device(s) in {:.1f}s to '{}' "
+             "({} bytes, {:.0f} events/s, {:.0f} bytes/s, {} SYN_DROPPED)\n",
+             writer.RecordCount(), devices.size(), total_secs, arg_output,
+             writer.BytesWritten(),
+             static_cast<double>(writer.RecordCount()) / total_secs,
+             static_cast<double>(writer.BytesWritten()) / total_secs,
+             syn_dropped);
+  return 0;
+}
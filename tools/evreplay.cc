@@ -0,0 +1,137 @@
+#include <csignal>
+#include <deque>
+
+#include "CLI/CLI.hpp"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/time/clock.h"
+#include "evdevpp/capture.h"
+#include "evdevpp/replay.h"
+#include "evdevpp/user_device.h"
+#include "fmt/core.h"
+#include "linux/input.h"
+
+using namespace evdevpp;
+
+namespace {
+
+EventReplayer* active_replayer = nullptr;
+
+void OnInterrupt(int /*signum*/) {
+  if (active_replayer != nullptr) {
+    active_replayer->Stop();
+  }
+}
+
+UserInputDevice::CreateOptions OptionsFromCapture(
+    const CaptureDeviceInfo& dev) {
+  UserInputDevice::CreateOptions options;
+  options.capabilities = dev.capabilities;
+  // The input core handles these itself, and force-feedback requests
+  // would go back to this tool rather than to a driver.
+  options.capabilities.synchs.clear();
+  options.capabilities.force_feedbacks.clear();
+  options.capabilities.uinputs.clear();
+  options.name = dev.name;
+  options.info = dev.info;
+  options.phys = dev.phys;
+  options.input_props = dev.input_props;
+  // Nothing is read back from the devices.
+  options.device_discovery = UserInputDevice::DeviceDiscovery::kSkip;
+  return options;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  CLI::App cli_ep{
+      "Replay a capture file into recreated uinput devices, with the "
+      "recorded timing."};
+
+  std::string arg_input = "capture.evcap";
+  cli_ep.add_option("-i,--input", arg_input, "Capture file to replay.");
+
+  double arg_speed = 1.0;
+  cli_ep.add_option("-s,--speed", arg_speed,
+                    "Playback speed (2 replays twice as fast).");
+
+  int arg_loops = 1;
+  cli_ep.add_option("-l,--loops", arg_loops,
+                    "Number of times to replay (0 to loop until "
+                    "interrupted).");
+
+  double arg_settle = 1.0;
+  cli_ep.add_option("--settle", arg_settle,
+                    "Seconds to wait after creating the devices, to let "
+                    "other applications open them.");
+
+  int arg_spin_us = 200;
+  cli_ep.add_option("--spin_us", arg_spin_us,
+                    "Microseconds to busy-wait before each frame.");
+
+  try {
+    cli_ep.parse(argc, argv);
+  } catch (const CLI::ParseError& e) {
+    return cli_ep.exit(e);
+  }
+
+  absl::StatusOr<CaptureReader> reader_or = CaptureReader::Open(arg_input);
+  if (!reader_or.ok()) {
+    fmt::print(stderr, "Failed to open capture file: {}\n",
+               reader_or.status().ToString());
+    return 1;
+  }
+  const CaptureReader& reader = *reader_or;
+  fmt::print(stderr, "Capture '{}': {} events from {} device(s) over {}\n",
+             arg_input, reader.RecordCount(), reader.Devices().size(),
+             absl::FormatDuration(reader.EndTime() - reader.StartTime()));
+
+  // User input devices are destroyed when moved-from copies go away, keep
+  // them in place.
+  std::deque<UserInputDevice> devices;
+  std::vector<const EventIO*> sinks;
+  for (const auto& dev : reader.Devices()) {
+    absl::StatusOr<UserInputDevice> device_or =
+        UserInputDevice::Create(OptionsFromCapture(dev));
+    if (!device_or.ok()) {
+      fmt::print(stderr, "Failed to create device '{}': {}\n", dev.name,
+                 device_or.status().ToString());
+      return 2;
+    }
+    devices.emplace_back(std::move(*device_or));
+    sinks.push_back(&devices.back());
+    fmt::print(stderr, "Created device '{}'\n", dev.name);
+  }
+  absl::SleepFor(absl::Seconds(arg_settle));
+
+  EventReplayer::Options replay_options;
+  replay_options.speed = arg_speed;
+  replay_options.loops = arg_loops;
+  replay_options.spin_window = absl::Microseconds(arg_spin_us);
+  EventReplayer replayer(reader, std::move(sinks), replay_options);
+  active_replayer = &replayer;
+  std::signal(SIGINT, OnInterrupt);
+  std::signal(SIGTERM, OnInterrupt);
+
+  const absl::Time start = absl::Now();
+  absl::StatusOr<EventReplayer::Report> report_or = replayer.Run();
+  const double total_secs = absl::ToDoubleSeconds(absl::Now() - start);
+  active_replayer = nullptr;
+  if (!report_or.ok()) {
+    fmt::print(stderr, "Replay failed: {}\n", report_or.status().ToString());
+    return 3;
+  }
+
+  const EventReplayer::Report& report = *report_or;
+  const auto events = static_cast<double>(report.events);
+  fmt::print(stderr,
+             "Replayed {} loop(s), {} frames, {} events in {:.1f}s "
+             "({:.0f} events/s, {:.0f} bytes/s, {} SYN_DROPPED in "
+             "capture)\n",
+             report.loops, report.frames, report.events, total_secs,
+             events / total_secs,
+             events * sizeof(input_event) / total_secs, report.syn_dropped);
+  fmt::print(stderr, "Scheduling error: {}\n",
+             report.scheduling_error.Summary());
+  return 0;
+}